@@ -0,0 +1,1802 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "easy_uci.h"
+
+#define BENCH_PACKAGE "bench"
+#define BENCH_DEFAULT_SIZES "10,1000,100000"
+#define BENCH_DEFAULT_ITERATIONS 1000
+//A case stops early once it has run this long, writes of the largest packages would take minutes otherwise
+#define BENCH_TIME_LIMIT_NS 2000000000LL
+#define BENCH_MIN_ITERATIONS 3
+//Every 10th host has a long list
+#define BENCH_LONG_LIST 64
+#define BENCH_BATCH 8
+//Writes kept in flight by the async event loop case
+#define BENCH_ASYNC_INFLIGHT 4
+
+static char base_dir[256];
+static char conf_dir[300];
+static char save_dir[300];
+static char snap_dir[300];
+
+/*
+ * Counting hooks
+ * malloc() and friends, fsync() and rename() are interposed by defining them here, the library and libc resolve
+ * them to the executable first
+ * Reads and writes are done by stdio inside libc as well, so they're counted by the kernel in /proc/self/io instead
+ */
+
+static unsigned long long allocs=0;
+static unsigned long long fsyncs=0;
+static unsigned long long renames=0;
+
+static void* (*real_malloc)(size_t)=NULL;
+static void* (*real_calloc)(size_t,size_t)=NULL;
+static void* (*real_realloc)(void*,size_t)=NULL;
+static void (*real_free)(void*)=NULL;
+static int (*real_fsync)(int)=NULL;
+static int (*real_fdatasync)(int)=NULL;
+static int (*real_rename)(const char*,const char*)=NULL;
+
+//dlsym() may allocate before the real functions are known
+static char boot_buff[8192];
+static size_t boot_used=0;
+static bool hooks_initing=false;
+
+static void __hooks_init(void)
+{
+    if(hooks_initing)
+    {
+        return;
+    }
+
+    hooks_initing=true;
+    real_malloc=dlsym(RTLD_NEXT,"malloc");
+    real_calloc=dlsym(RTLD_NEXT,"calloc");
+    real_realloc=dlsym(RTLD_NEXT,"realloc");
+    real_free=dlsym(RTLD_NEXT,"free");
+    real_fsync=dlsym(RTLD_NEXT,"fsync");
+    real_fdatasync=dlsym(RTLD_NEXT,"fdatasync");
+    real_rename=dlsym(RTLD_NEXT,"rename");
+    hooks_initing=false;
+}
+
+static void* __boot_alloc(size_t size)
+{
+    void* ret;
+
+    size=(size+15)&~(size_t)15;
+    if(boot_used+size>sizeof(boot_buff))
+    {
+        return NULL;
+    }
+
+    ret=boot_buff+boot_used;
+    boot_used+=size;
+
+    return ret;
+}
+
+static bool __is_boot(void* ptr)
+{
+    return (char*)ptr>=boot_buff&&(char*)ptr<boot_buff+sizeof(boot_buff);
+}
+
+void* malloc(size_t size)
+{
+    if(real_malloc==NULL)
+    {
+        __hooks_init();
+        if(real_malloc==NULL)
+        {
+            return __boot_alloc(size);
+        }
+    }
+
+    __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+
+    return real_malloc(size);
+}
+
+void* calloc(size_t n,size_t size)
+{
+    if(real_calloc==NULL)
+    {
+        __hooks_init();
+        if(real_calloc==NULL)
+        {
+            //The boot buffer is static, so already zeroed
+            return n!=0&&size>SIZE_MAX/n?NULL:__boot_alloc(n*size);
+        }
+    }
+
+    __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+
+    return real_calloc(n,size);
+}
+
+void* realloc(void* ptr,size_t size)
+{
+    void* ret;
+
+    if(real_realloc==NULL)
+    {
+        __hooks_init();
+    }
+
+    if(__is_boot(ptr))
+    {
+        ret=malloc(size);
+        if(ret!=NULL)
+        {
+            memcpy(ret,ptr,size<(size_t)(boot_buff+sizeof(boot_buff)-(char*)ptr)?size:(size_t)(boot_buff+sizeof(boot_buff)-(char*)ptr));
+        }
+        return ret;
+    }
+
+    __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+
+    return real_realloc(ptr,size);
+}
+
+void free(void* ptr)
+{
+    if(ptr==NULL||__is_boot(ptr))
+    {
+        return;
+    }
+
+    if(real_free==NULL)
+    {
+        __hooks_init();
+    }
+
+    real_free(ptr);
+}
+
+int fsync(int fd)
+{
+    if(real_fsync==NULL)
+    {
+        __hooks_init();
+    }
+
+    __atomic_add_fetch(&fsyncs,1,__ATOMIC_RELAXED);
+
+    return real_fsync(fd);
+}
+
+int fdatasync(int fd)
+{
+    if(real_fdatasync==NULL)
+    {
+        __hooks_init();
+    }
+
+    __atomic_add_fetch(&fsyncs,1,__ATOMIC_RELAXED);
+
+    return real_fdatasync(fd);
+}
+
+int rename(const char* oldpath,const char* newpath)
+{
+    if(real_rename==NULL)
+    {
+        __hooks_init();
+    }
+
+    __atomic_add_fetch(&renames,1,__ATOMIC_RELAXED);
+
+    return real_rename(oldpath,newpath);
+}
+
+struct bench_counters
+{
+    unsigned long long allocs;
+    unsigned long long fsyncs;
+    unsigned long long renames;
+    //-1 if the kernel doesn't account I/O per task
+    long long reads;
+    long long writes;
+};
+
+static void __counters_get(struct bench_counters* c)
+{
+    int fd;
+    ssize_t n;
+    char buff[512];
+    char* line;
+
+    c->reads=-1;
+    c->writes=-1;
+
+    fd=open("/proc/self/io",O_RDONLY|O_CLOEXEC);
+    if(fd>=0)
+    {
+        n=read(fd,buff,sizeof(buff)-1);
+        close(fd);
+        if(n>0)
+        {
+            buff[n]='\0';
+            line=strstr(buff,"syscr:");
+            if(line!=NULL)
+            {
+                c->reads=strtoll(line+6,NULL,10);
+            }
+            line=strstr(buff,"syscw:");
+            if(line!=NULL)
+            {
+                c->writes=strtoll(line+6,NULL,10);
+            }
+        }
+    }
+
+    c->allocs=__atomic_load_n(&allocs,__ATOMIC_RELAXED);
+    c->fsyncs=__atomic_load_n(&fsyncs,__ATOMIC_RELAXED);
+    c->renames=__atomic_load_n(&renames,__ATOMIC_RELAXED);
+}
+
+/*
+ * Benchmark cases
+ */
+
+struct bench_env
+{
+    size_t n;
+    //A read-write session and a read-only one with the package loaded
+    easy_uci_session* s;
+    easy_uci_session* ro;
+    //A session with the mac of hosts indexed
+    easy_uci_session* idx;
+    easy_uci_snapshot* snap;
+    easy_uci_watch* watch;
+    easy_uci_async* async;
+    size_t inflight;
+    //Documents for the JSON cases
+    int json_fd[2];
+    //Paths for the batch cases
+    char paths[BENCH_BATCH][64];
+    const char* path_ptrs[BENCH_BATCH];
+};
+
+struct bench_case
+{
+    const char* name;
+    //Run untimed before the case with the number of iterations it may run, can be NULL
+    int (*setup)(struct bench_env* e,size_t iterations);
+    int (*run)(struct bench_env* e,size_t i);
+    //Run untimed after the case, can be NULL
+    void (*teardown)(struct bench_env* e);
+};
+
+static long long __now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+
+    return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+
+/*
+ * Spread the iterations over the package, so a case doesn't only read the first section
+ */
+static const char* __host(struct bench_env* e,size_t i,char* buff,size_t size)
+{
+    snprintf(buff,size,"h%zu",(i*7919)%e->n);
+
+    return buff;
+}
+
+/*
+ * A host with a long list, every 10th one
+ */
+static const char* __long_host(struct bench_env* e,size_t i,char* buff,size_t size)
+{
+    size_t n=(e->n+9)/10;
+
+    snprintf(buff,size,"h%zu",((i*7919)%n)*10);
+
+    return buff;
+}
+
+/*
+ * Write a package of n sections of type host with one section of type domain after every 10 of them
+ * Each host has a short list, every 10th host has a long list as well
+ */
+static int __gen_package(size_t n)
+{
+    size_t i,j;
+    FILE* f;
+    char path[512];
+
+    snprintf(path,sizeof(path),"%s/%s",conf_dir,BENCH_PACKAGE);
+    f=fopen(path,"w");
+    if(f==NULL)
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    for(i=0;i<n;++i)
+    {
+        fprintf(f,"\nconfig host 'h%zu'\n\toption mac '00:00:00:%02zx:%02zx:%02zx'\n\toption ip '10.%zu.%zu.%zu'\n",
+            i,(i>>16)&0xff,(i>>8)&0xff,i&0xff,(i>>16)&0xff,(i>>8)&0xff,i&0xff);
+        fprintf(f,"\toption port '%zu'\n\toption enabled '%d'\n\toption ratio '%zu.5'\n\tlist tag 'a'\n\tlist tag 'b'\n",
+            1024+i%60000,(int)(i&1),i%100);
+        if(i%10==0)
+        {
+            for(j=0;j<BENCH_LONG_LIST;++j)
+            {
+                fprintf(f,"\tlist member 'm%zu'\n",j);
+            }
+        }
+        if(i%10==9)
+        {
+            fprintf(f,"\nconfig domain\n\toption name 'd%zu'\n",i);
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+static int __session_open_close(struct bench_env* e,size_t i)
+{
+    (void)e;
+    (void)i;
+
+    easy_uci_session_close(easy_uci_session_open());
+
+    return 0;
+}
+
+static int __load(easy_uci_session* s)
+{
+    size_t count;
+    int ret;
+
+    if(s==NULL)
+    {
+        return -1;
+    }
+    ret=easy_uci_session_get_section_count_of_type(s,BENCH_PACKAGE,"host",&count);
+    easy_uci_session_close(s);
+
+    return ret;
+}
+
+static int __session_load(struct bench_env* e,size_t i)
+{
+    (void)e;
+    (void)i;
+
+    return __load(easy_uci_session_open());
+}
+
+static int __session_load_readonly(struct bench_env* e,size_t i)
+{
+    (void)e;
+    (void)i;
+
+    return __load(easy_uci_session_open_readonly());
+}
+
+static int __session_reload(struct bench_env* e,size_t i)
+{
+    size_t count;
+
+    (void)i;
+
+    easy_uci_session_unload(e->s,BENCH_PACKAGE);
+
+    return easy_uci_session_get_section_count_of_type(e->s,BENCH_PACKAGE,"host",&count);
+}
+
+static int __session_get_section_type(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[32];
+
+    return easy_uci_session_get_section_type(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),buff,sizeof(buff));
+}
+
+static int __session_get_section(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_section* sec;
+
+    if(easy_uci_session_get_section(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),&sec)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_section(sec);
+
+    return 0;
+}
+
+static int __session_get_all_section_of_type(struct bench_env* e,size_t i)
+{
+    easy_uci_list list;
+
+    (void)i;
+
+    if(easy_uci_session_get_all_section_of_type(e->s,BENCH_PACKAGE,"host",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __session_get_nth_section_of_type(struct bench_env* e,size_t i)
+{
+    char* name;
+
+    if(easy_uci_session_get_nth_section_of_type(e->s,BENCH_PACKAGE,"host",(int)((i*7919)%e->n),&name)!=0)
+    {
+        return -1;
+    }
+    free(name);
+
+    return 0;
+}
+
+static int __session_get_section_count_of_type(struct bench_env* e,size_t i)
+{
+    size_t count;
+
+    (void)i;
+
+    return easy_uci_session_get_section_count_of_type(e->s,BENCH_PACKAGE,"domain",&count);
+}
+
+static int __session_get_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[64];
+
+    return easy_uci_session_get_option_string(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",buff,sizeof(buff));
+}
+
+static int __session_get_option_list_short(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_list list;
+
+    if(easy_uci_session_get_option_list(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"tag",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __session_get_option_list_long(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_list list;
+
+    if(easy_uci_session_get_option_list(e->s,BENCH_PACKAGE,__long_host(e,i,name,sizeof(name)),"member",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __readonly_get_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[64];
+
+    return easy_uci_session_get_option_string(e->ro,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",buff,sizeof(buff));
+}
+
+/*
+ * Find the host with the mac of __host()
+ */
+static int __find_host(struct bench_env* e,easy_uci_session* s,size_t i)
+{
+    int ret;
+    size_t n=(i*7919)%e->n;
+    char mac[32];
+    easy_uci_list list;
+    easy_uci_predicate pred;
+
+    snprintf(mac,sizeof(mac),"00:00:00:%02zx:%02zx:%02zx",(n>>16)&0xff,(n>>8)&0xff,n&0xff);
+    pred.option="mac";
+    pred.match=EASY_UCI_MATCH_EQUAL;
+    pred.value=mac;
+
+    ret=s==NULL?easy_uci_find_sections(BENCH_PACKAGE,"host",&pred,1,&list):
+        easy_uci_session_find_sections(s,BENCH_PACKAGE,"host",&pred,1,&list);
+    if(ret!=0)
+    {
+        return -1;
+    }
+
+    ret=list.len==1?0:-1;
+    easy_uci_free_list(&list);
+
+    return ret;
+}
+
+static int __session_find_sections(struct bench_env* e,size_t i)
+{
+    return __find_host(e,e->s,i);
+}
+
+static int __index_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    e->idx=easy_uci_session_open();
+    if(e->idx==NULL)
+    {
+        return -1;
+    }
+
+    return easy_uci_session_index_option(e->idx,BENCH_PACKAGE,"host","mac");
+}
+
+static void __index_teardown(struct bench_env* e)
+{
+    easy_uci_session_close(e->idx);
+    e->idx=NULL;
+}
+
+static int __session_find_sections_indexed(struct bench_env* e,size_t i)
+{
+    return __find_host(e,e->idx,i);
+}
+
+static int __session_get_option_int(struct bench_env* e,size_t i)
+{
+    char name[32];
+    long value;
+
+    return easy_uci_session_get_option_int(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"port",0,&value)<0?-1:0;
+}
+
+static int __session_get_option_uint(struct bench_env* e,size_t i)
+{
+    char name[32];
+    unsigned long value;
+
+    return easy_uci_session_get_option_uint(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"port",0,&value)<0?-1:0;
+}
+
+static int __session_get_option_bool(struct bench_env* e,size_t i)
+{
+    char name[32];
+    bool value;
+
+    return easy_uci_session_get_option_bool(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"enabled",false,&value)<0?-1:0;
+}
+
+static int __session_get_option_double(struct bench_env* e,size_t i)
+{
+    char name[32];
+    double value;
+
+    return easy_uci_session_get_option_double(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ratio",0,&value)<0?-1:0;
+}
+
+static int __session_get_option_ipaddr(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_ipaddr value;
+
+    return easy_uci_session_get_option_ipaddr(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",NULL,&value)<0?-1:0;
+}
+
+static int __batch_setup(struct bench_env* e,size_t iterations)
+{
+    size_t i;
+
+    (void)iterations;
+
+    for(i=0;i<BENCH_BATCH;++i)
+    {
+        snprintf(e->paths[i],sizeof(e->paths[i]),BENCH_PACKAGE ".h%zu.%s",(i*7919)%e->n,i%2==0?"ip":"tag");
+        e->path_ptrs[i]=e->paths[i];
+    }
+
+    return 0;
+}
+
+static int __session_get_batch(struct bench_env* e,size_t i)
+{
+    easy_uci_result* results;
+
+    (void)i;
+
+    if(easy_uci_session_get_batch(e->s,e->path_ptrs,BENCH_BATCH,&results)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_results(results);
+
+    return 0;
+}
+
+static int __session_get_version(struct bench_env* e,size_t i)
+{
+    easy_uci_version version;
+
+    (void)i;
+
+    return easy_uci_session_get_version(e->s,BENCH_PACKAGE,&version);
+}
+
+static int __session_view_section_type(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_view view;
+
+    return easy_uci_session_view_section_type(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),&view);
+}
+
+static int __session_view_nth_section_of_type(struct bench_env* e,size_t i)
+{
+    easy_uci_view view;
+
+    return easy_uci_session_view_nth_section_of_type(e->s,BENCH_PACKAGE,"host",(int)((i*7919)%e->n),&view);
+}
+
+static int __session_view_all_section_of_type(struct bench_env* e,size_t i)
+{
+    size_t count;
+    easy_uci_view views[16];
+
+    (void)i;
+
+    return easy_uci_session_view_all_section_of_type(e->s,BENCH_PACKAGE,"domain",views,16,&count);
+}
+
+static int __session_view_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_view view;
+
+    return easy_uci_session_view_option_string(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",&view);
+}
+
+static int __session_view_option_list(struct bench_env* e,size_t i)
+{
+    char name[32];
+    size_t count;
+    easy_uci_view views[BENCH_LONG_LIST];
+
+    return easy_uci_session_view_option_list(e->s,BENCH_PACKAGE,__long_host(e,i,name,sizeof(name)),"member",views,BENCH_LONG_LIST,&count);
+}
+
+/*
+ * The functions not taking a session, with the cache enabled unless the case turns it off
+ */
+
+static int __get_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[64];
+
+    return easy_uci_get_option_string(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",buff,sizeof(buff));
+}
+
+static int __nocache_setup(struct bench_env* e,size_t iterations)
+{
+    (void)e;
+    (void)iterations;
+
+    return easy_uci_cache_enable(false);
+}
+
+static void __nocache_teardown(struct bench_env* e)
+{
+    (void)e;
+
+    easy_uci_cache_enable(true);
+}
+
+static int __cache_reload(struct bench_env* e,size_t i)
+{
+    easy_uci_cache_invalidate(BENCH_PACKAGE);
+
+    return __get_option_string(e,i);
+}
+
+static int __get_section_type(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[32];
+
+    return easy_uci_get_section_type(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),buff,sizeof(buff));
+}
+
+static int __get_section(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_section* sec;
+
+    if(easy_uci_get_section(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),&sec)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_section(sec);
+
+    return 0;
+}
+
+static int __get_all_section_of_type(struct bench_env* e,size_t i)
+{
+    easy_uci_list list;
+
+    (void)e;
+    (void)i;
+
+    if(easy_uci_get_all_section_of_type(BENCH_PACKAGE,"host",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __get_nth_section_of_type(struct bench_env* e,size_t i)
+{
+    char* name;
+
+    if(easy_uci_get_nth_section_of_type(BENCH_PACKAGE,"host",(int)((i*7919)%e->n),&name)!=0)
+    {
+        return -1;
+    }
+    free(name);
+
+    return 0;
+}
+
+static int __get_section_count_of_type(struct bench_env* e,size_t i)
+{
+    size_t count;
+
+    (void)e;
+    (void)i;
+
+    return easy_uci_get_section_count_of_type(BENCH_PACKAGE,"domain",&count);
+}
+
+static int __get_option_list(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_list list;
+
+    if(easy_uci_get_option_list(BENCH_PACKAGE,__long_host(e,i,name,sizeof(name)),"member",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __find_sections(struct bench_env* e,size_t i)
+{
+    return __find_host(e,NULL,i);
+}
+
+static int __get_option_int(struct bench_env* e,size_t i)
+{
+    char name[32];
+    long value;
+
+    return easy_uci_get_option_int(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"port",0,&value)<0?-1:0;
+}
+
+static int __get_option_uint(struct bench_env* e,size_t i)
+{
+    char name[32];
+    unsigned long value;
+
+    return easy_uci_get_option_uint(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"port",0,&value)<0?-1:0;
+}
+
+static int __get_option_bool(struct bench_env* e,size_t i)
+{
+    char name[32];
+    bool value;
+
+    return easy_uci_get_option_bool(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"enabled",false,&value)<0?-1:0;
+}
+
+static int __get_option_double(struct bench_env* e,size_t i)
+{
+    char name[32];
+    double value;
+
+    return easy_uci_get_option_double(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ratio",0,&value)<0?-1:0;
+}
+
+static int __get_option_ipaddr(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_ipaddr value;
+
+    return easy_uci_get_option_ipaddr(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"ip",NULL,&value)<0?-1:0;
+}
+
+static int __get_batch(struct bench_env* e,size_t i)
+{
+    easy_uci_result* results;
+
+    (void)i;
+
+    if(easy_uci_get_batch(e->path_ptrs,BENCH_BATCH,&results)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_results(results);
+
+    return 0;
+}
+
+static int __get_version(struct bench_env* e,size_t i)
+{
+    easy_uci_version version;
+
+    (void)e;
+    (void)i;
+
+    return easy_uci_get_version(BENCH_PACKAGE,&version);
+}
+
+/*
+ * Snapshots
+ */
+
+static int __snapshot_compile(struct bench_env* e,size_t i)
+{
+    (void)e;
+    (void)i;
+
+    return easy_uci_snapshot_compile(BENCH_PACKAGE);
+}
+
+static int __snapshot_open_close(struct bench_env* e,size_t i)
+{
+    easy_uci_snapshot* snap;
+
+    (void)e;
+    (void)i;
+
+    snap=easy_uci_snapshot_open(BENCH_PACKAGE);
+    if(snap==NULL)
+    {
+        return -1;
+    }
+    easy_uci_snapshot_close(snap);
+
+    return 0;
+}
+
+static int __snapshot_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    e->snap=easy_uci_snapshot_open(BENCH_PACKAGE);
+
+    return e->snap==NULL?-1:0;
+}
+
+static void __snapshot_teardown(struct bench_env* e)
+{
+    easy_uci_snapshot_close(e->snap);
+    e->snap=NULL;
+}
+
+static int __snapshot_get_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[64];
+
+    return easy_uci_snapshot_get_option_string(e->snap,__host(e,i,name,sizeof(name)),"ip",buff,sizeof(buff));
+}
+
+static int __snapshot_get_option_list(struct bench_env* e,size_t i)
+{
+    char name[32];
+    easy_uci_list list;
+
+    if(easy_uci_snapshot_get_option_list(e->snap,__long_host(e,i,name,sizeof(name)),"member",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __snapshot_get_section_type(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char buff[32];
+
+    return easy_uci_snapshot_get_section_type(e->snap,__host(e,i,name,sizeof(name)),buff,sizeof(buff));
+}
+
+static int __snapshot_get_all_section_of_type(struct bench_env* e,size_t i)
+{
+    easy_uci_list list;
+
+    (void)i;
+
+    if(easy_uci_snapshot_get_all_section_of_type(e->snap,"host",&list)!=0)
+    {
+        return -1;
+    }
+    easy_uci_free_list(&list);
+
+    return 0;
+}
+
+static int __snapshot_get_nth_section_of_type(struct bench_env* e,size_t i)
+{
+    char* name;
+
+    if(easy_uci_snapshot_get_nth_section_of_type(e->snap,"host",(int)((i*7919)%e->n),&name)!=0)
+    {
+        return -1;
+    }
+    free(name);
+
+    return 0;
+}
+
+static int __snapshot_get_section_count_of_type(struct bench_env* e,size_t i)
+{
+    size_t count;
+
+    (void)i;
+
+    return easy_uci_snapshot_get_section_count_of_type(e->snap,"domain",&count);
+}
+
+static void __snapshot_remove(struct bench_env* e)
+{
+    char path[512];
+
+    (void)e;
+
+    snprintf(path,sizeof(path),"%s/%s.snap",snap_dir,BENCH_PACKAGE);
+    unlink(path);
+}
+
+/*
+ * Watches
+ */
+
+static int __watch_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    e->watch=easy_uci_watch_open(NULL,NULL);
+
+    return e->watch==NULL?-1:0;
+}
+
+static void __watch_teardown(struct bench_env* e)
+{
+    easy_uci_watch_close(e->watch);
+    e->watch=NULL;
+}
+
+static int __watch_dispatch(struct bench_env* e,size_t i)
+{
+    (void)i;
+
+    return easy_uci_watch_dispatch(e->watch)<0?-1:0;
+}
+
+/*
+ * Writes, each one is committed to the config file unless the case says otherwise
+ */
+
+static int __session_set_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char value[32];
+
+    snprintf(value,sizeof(value),"%zu",i);
+
+    return easy_uci_session_set_option_string(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"note",value);
+}
+
+static int __session_set_option_string_if_version(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char value[32];
+    easy_uci_version version;
+
+    snprintf(value,sizeof(value),"%zu",i);
+    if(easy_uci_session_get_version(e->s,BENCH_PACKAGE,&version)!=0)
+    {
+        return -1;
+    }
+
+    return easy_uci_session_set_option_string_if_version(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"note",value,&version);
+}
+
+static int __session_set_option_list(struct bench_env* e,size_t i)
+{
+    char name[32];
+    const char* values[]={"x","y","z"};
+    easy_uci_list list={values,3};
+
+    return easy_uci_session_set_option_list(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"tag",&list);
+}
+
+static int __session_append_to_option_list(struct bench_env* e,size_t i)
+{
+    char name[32];
+
+    return easy_uci_session_append_to_option_list(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"extra","v");
+}
+
+static int __session_delete_option(struct bench_env* e,size_t i)
+{
+    char name[32];
+
+    return easy_uci_session_delete_option(e->s,BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"extra");
+}
+
+static int __session_add_section(struct bench_env* e,size_t i)
+{
+    char name[32];
+
+    snprintf(name,sizeof(name),"b%zu",i);
+
+    return easy_uci_session_add_section(e->s,BENCH_PACKAGE,"bench",name);
+}
+
+static int __session_delete_section(struct bench_env* e,size_t i)
+{
+    char name[32];
+
+    snprintf(name,sizeof(name),"b%zu",i);
+
+    return easy_uci_session_delete_section(e->s,BENCH_PACKAGE,name);
+}
+
+/*
+ * Sections b0..b(iterations-1) for __session_delete_section to delete, added in one commit
+ */
+static int __delete_section_setup(struct bench_env* e,size_t iterations)
+{
+    size_t i;
+    char name[32];
+
+    if(easy_uci_session_begin(e->s)!=0)
+    {
+        return -1;
+    }
+
+    for(i=0;i<iterations;++i)
+    {
+        snprintf(name,sizeof(name),"b%zu",i);
+        easy_uci_session_delete_section(e->s,BENCH_PACKAGE,name);
+        easy_uci_session_add_section(e->s,BENCH_PACKAGE,"bench",name);
+    }
+
+    return easy_uci_session_commit(e->s);
+}
+
+static int __session_commit_txn(struct bench_env* e,size_t i)
+{
+    size_t j;
+
+    if(easy_uci_session_begin(e->s)!=0)
+    {
+        return -1;
+    }
+
+    for(j=0;j<10;++j)
+    {
+        __session_set_option_string(e,i*10+j);
+    }
+
+    return easy_uci_session_commit(e->s);
+}
+
+/*
+ * A second package for the transactions spanning packages, which are written through the journal
+ */
+static int __journal_setup(struct bench_env* e,size_t iterations)
+{
+    FILE* f;
+    char path[512];
+
+    (void)e;
+    (void)iterations;
+
+    snprintf(path,sizeof(path),"%s/%s_other",conf_dir,BENCH_PACKAGE);
+    f=fopen(path,"w");
+    if(f==NULL)
+    {
+        perror("fopen");
+        return -1;
+    }
+    fprintf(f,"\nconfig main 'main'\n\toption note '0'\n");
+    fclose(f);
+
+    return 0;
+}
+
+static void __journal_teardown(struct bench_env* e)
+{
+    char path[512];
+
+    easy_uci_session_unload(e->s,BENCH_PACKAGE "_other");
+    snprintf(path,sizeof(path),"%s/%s_other",conf_dir,BENCH_PACKAGE);
+    unlink(path);
+}
+
+static int __session_commit_journal(struct bench_env* e,size_t i)
+{
+    char value[32];
+
+    if(easy_uci_session_begin(e->s)!=0)
+    {
+        return -1;
+    }
+
+    snprintf(value,sizeof(value),"%zu",i);
+    __session_set_option_string(e,i);
+    easy_uci_session_set_option_string(e->s,BENCH_PACKAGE "_other","main","note",value);
+
+    return easy_uci_session_commit(e->s);
+}
+
+static int __session_rollback(struct bench_env* e,size_t i)
+{
+    if(easy_uci_session_begin(e->s)!=0)
+    {
+        return -1;
+    }
+
+    __session_set_option_string(e,i);
+    easy_uci_session_rollback(e->s);
+
+    return 0;
+}
+
+static int __json_open(struct bench_env* e,int k)
+{
+    char path[512];
+
+    snprintf(path,sizeof(path),"%s/%s%d.json",base_dir,BENCH_PACKAGE,k);
+    e->json_fd[k]=open(path,O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC,0600);
+    if(e->json_fd[k]<0)
+    {
+        perror("open");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void __json_teardown(struct bench_env* e)
+{
+    int k;
+
+    for(k=0;k<2;++k)
+    {
+        if(e->json_fd[k]>=0)
+        {
+            close(e->json_fd[k]);
+            e->json_fd[k]=-1;
+        }
+    }
+}
+
+static int __json_export_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    e->json_fd[1]=-1;
+
+    return __json_open(e,0);
+}
+
+static int __export_json(struct bench_env* e,size_t i)
+{
+    (void)i;
+
+    if(lseek(e->json_fd[0],0,SEEK_SET)<0||ftruncate(e->json_fd[0],0)!=0)
+    {
+        return -1;
+    }
+
+    return easy_uci_export_json(BENCH_PACKAGE,e->json_fd[0]);
+}
+
+/*
+ * The package as exported, importing it in replace mode is a full sync that finds nothing to change
+ */
+static int __json_unchanged_setup(struct bench_env* e,size_t iterations)
+{
+    if(__json_export_setup(e,iterations)!=0)
+    {
+        return -1;
+    }
+
+    if(__export_json(e,0)!=0)
+    {
+        __json_teardown(e);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int __import_json_unchanged(struct bench_env* e,size_t i)
+{
+    (void)i;
+
+    if(lseek(e->json_fd[0],0,SEEK_SET)<0)
+    {
+        return -1;
+    }
+
+    return easy_uci_import_json(BENCH_PACKAGE,e->json_fd[0],EASY_UCI_IMPORT_REPLACE);
+}
+
+/*
+ * Two documents setting the note of every host to a different value, so each import changes every host
+ */
+static int __json_merge_setup(struct bench_env* e,size_t iterations)
+{
+    int k;
+    size_t j;
+    FILE* f;
+
+    (void)iterations;
+
+    e->json_fd[0]=-1;
+    e->json_fd[1]=-1;
+
+    for(k=0;k<2;++k)
+    {
+        if(__json_open(e,k)!=0)
+        {
+            __json_teardown(e);
+            return -1;
+        }
+
+        f=fdopen(dup(e->json_fd[k]),"w");
+        if(f==NULL)
+        {
+            __json_teardown(e);
+            return -1;
+        }
+
+        fputc('{',f);
+        for(j=0;j<e->n;++j)
+        {
+            fprintf(f,"%s\n\"h%zu\":{\"note\":\"%c\"}",j==0?"":",",j,'a'+k);
+        }
+        fputs("\n}\n",f);
+        fclose(f);
+    }
+
+    return 0;
+}
+
+static int __import_json_merge(struct bench_env* e,size_t i)
+{
+    if(lseek(e->json_fd[i&1],0,SEEK_SET)<0)
+    {
+        return -1;
+    }
+
+    return easy_uci_import_json(BENCH_PACKAGE,e->json_fd[i&1],EASY_UCI_IMPORT_MERGE);
+}
+
+static int __staged_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    easy_uci_session_stage_enable(e->s,true);
+
+    return 0;
+}
+
+static void __staged_teardown(struct bench_env* e)
+{
+    easy_uci_session_flush(e->s,BENCH_PACKAGE);
+    easy_uci_session_stage_enable(e->s,false);
+}
+
+static int __session_flush(struct bench_env* e,size_t i)
+{
+    if(__session_set_option_string(e,i)!=0)
+    {
+        return -1;
+    }
+
+    return easy_uci_session_flush(e->s,BENCH_PACKAGE);
+}
+
+static int __set_option_string(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char value[32];
+
+    snprintf(value,sizeof(value),"%zu",i);
+
+    return easy_uci_set_option_string(BENCH_PACKAGE,__host(e,i,name,sizeof(name)),"note",value);
+}
+
+static int __writer_setup(struct bench_env* e,size_t iterations)
+{
+    (void)e;
+    (void)iterations;
+
+    return easy_uci_writer_start(10);
+}
+
+static void __writer_teardown(struct bench_env* e)
+{
+    (void)e;
+
+    easy_uci_writer_stop();
+}
+
+static int __writer_sync(struct bench_env* e,size_t i)
+{
+    if(__set_option_string(e,i)!=0)
+    {
+        return -1;
+    }
+
+    return easy_uci_writer_sync();
+}
+
+static int __async_setup(struct bench_env* e,size_t iterations)
+{
+    (void)iterations;
+
+    e->async=easy_uci_async_open(0);
+    e->inflight=0;
+
+    return e->async==NULL?-1:0;
+}
+
+static void __async_teardown(struct bench_env* e)
+{
+    easy_uci_async_close(e->async);
+    e->async=NULL;
+}
+
+static int __async_submit(struct bench_env* e,size_t i)
+{
+    char name[32];
+    char value[32];
+    easy_uci_op op;
+
+    memset(&op,0,sizeof(op));
+    op.type=EASY_UCI_OP_SET_OPTION_STRING;
+    op.package=BENCH_PACKAGE;
+    op.section=__host(e,i,name,sizeof(name));
+    op.option="note";
+    op.value=value;
+    snprintf(value,sizeof(value),"%zu",i);
+
+    return easy_uci_async_submit(e->async,&op,1)>0?0:-1;
+}
+
+static int __async_reap(struct bench_env* e,int timeout_ms)
+{
+    size_t i,n;
+    struct pollfd pfd;
+    easy_uci_completion done[BENCH_ASYNC_INFLIGHT];
+
+    pfd.fd=easy_uci_async_fd(e->async);
+    pfd.events=POLLIN;
+    if(poll(&pfd,1,timeout_ms)<0)
+    {
+        return -1;
+    }
+
+    n=easy_uci_async_reap(e->async,done,BENCH_ASYNC_INFLIGHT);
+    for(i=0;i<n;++i)
+    {
+        if(done[i].result!=0)
+        {
+            return -1;
+        }
+    }
+    e->inflight-=n;
+
+    return 0;
+}
+
+/*
+ * One turn of an event loop writing through the async queue: poll, reap and keep the workers busy
+ * Compared to set_option_string, this is how long a daemon is blocked by a write while the writes are in flight
+ */
+static int __async_loop_tick(struct bench_env* e,size_t i)
+{
+    if(__async_reap(e,0)!=0)
+    {
+        return -1;
+    }
+
+    if(e->inflight<BENCH_ASYNC_INFLIGHT)
+    {
+        if(__async_submit(e,i)!=0)
+        {
+            return -1;
+        }
+        ++e->inflight;
+    }
+
+    return 0;
+}
+
+/*
+ * From submitting a write to reaping its completion
+ */
+static int __async_roundtrip(struct bench_env* e,size_t i)
+{
+    if(__async_submit(e,i)!=0)
+    {
+        return -1;
+    }
+
+    for(++e->inflight;e->inflight>0;)
+    {
+        if(__async_reap(e,-1)!=0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static const struct bench_case cases[]={
+    {"session_open_close",NULL,__session_open_close,NULL},
+    {"session_load",NULL,__session_load,NULL},
+    {"session_load_readonly",NULL,__session_load_readonly,NULL},
+    {"session_reload",NULL,__session_reload,NULL},
+    {"session_get_section_type",NULL,__session_get_section_type,NULL},
+    {"session_get_section",NULL,__session_get_section,NULL},
+    {"session_get_all_section_of_type",NULL,__session_get_all_section_of_type,NULL},
+    {"session_get_nth_section_of_type",NULL,__session_get_nth_section_of_type,NULL},
+    {"session_get_section_count_of_type",NULL,__session_get_section_count_of_type,NULL},
+    {"session_get_option_string",NULL,__session_get_option_string,NULL},
+    {"session_get_option_list_short",NULL,__session_get_option_list_short,NULL},
+    {"session_get_option_list_long",NULL,__session_get_option_list_long,NULL},
+    {"readonly_get_option_string",NULL,__readonly_get_option_string,NULL},
+    {"session_find_sections",NULL,__session_find_sections,NULL},
+    {"session_find_sections_indexed",__index_setup,__session_find_sections_indexed,__index_teardown},
+    {"session_get_option_int",NULL,__session_get_option_int,NULL},
+    {"session_get_option_uint",NULL,__session_get_option_uint,NULL},
+    {"session_get_option_bool",NULL,__session_get_option_bool,NULL},
+    {"session_get_option_double",NULL,__session_get_option_double,NULL},
+    {"session_get_option_ipaddr",NULL,__session_get_option_ipaddr,NULL},
+    {"session_get_batch",__batch_setup,__session_get_batch,NULL},
+    {"session_get_version",NULL,__session_get_version,NULL},
+    {"session_view_section_type",NULL,__session_view_section_type,NULL},
+    {"session_view_nth_section_of_type",NULL,__session_view_nth_section_of_type,NULL},
+    {"session_view_all_section_of_type",NULL,__session_view_all_section_of_type,NULL},
+    {"session_view_option_string",NULL,__session_view_option_string,NULL},
+    {"session_view_option_list",NULL,__session_view_option_list,NULL},
+    {"get_option_string",NULL,__get_option_string,NULL},
+    {"nocache_get_option_string",__nocache_setup,__get_option_string,__nocache_teardown},
+    {"cache_reload",NULL,__cache_reload,NULL},
+    {"get_section_type",NULL,__get_section_type,NULL},
+    {"get_section",NULL,__get_section,NULL},
+    {"get_all_section_of_type",NULL,__get_all_section_of_type,NULL},
+    {"get_nth_section_of_type",NULL,__get_nth_section_of_type,NULL},
+    {"get_section_count_of_type",NULL,__get_section_count_of_type,NULL},
+    {"get_option_list",NULL,__get_option_list,NULL},
+    {"find_sections",NULL,__find_sections,NULL},
+    {"get_option_int",NULL,__get_option_int,NULL},
+    {"get_option_uint",NULL,__get_option_uint,NULL},
+    {"get_option_bool",NULL,__get_option_bool,NULL},
+    {"get_option_double",NULL,__get_option_double,NULL},
+    {"get_option_ipaddr",NULL,__get_option_ipaddr,NULL},
+    {"get_batch",__batch_setup,__get_batch,NULL},
+    {"get_version",NULL,__get_version,NULL},
+    {"snapshot_compile",NULL,__snapshot_compile,NULL},
+    {"snapshot_open_close",NULL,__snapshot_open_close,NULL},
+    {"snapshot_get_option_string",__snapshot_setup,__snapshot_get_option_string,__snapshot_teardown},
+    {"snapshot_get_option_list",__snapshot_setup,__snapshot_get_option_list,__snapshot_teardown},
+    {"snapshot_get_section_type",__snapshot_setup,__snapshot_get_section_type,__snapshot_teardown},
+    {"snapshot_get_all_section_of_type",__snapshot_setup,__snapshot_get_all_section_of_type,__snapshot_teardown},
+    {"snapshot_get_nth_section_of_type",__snapshot_setup,__snapshot_get_nth_section_of_type,__snapshot_teardown},
+    {"snapshot_get_section_count_of_type",__snapshot_setup,__snapshot_get_section_count_of_type,__snapshot_teardown},
+    //The writes below would keep the snapshot up to date, which is measured by snapshot_compile
+    {"watch_dispatch",__watch_setup,__watch_dispatch,__watch_teardown},
+    {"session_set_option_string",NULL,__session_set_option_string,__snapshot_remove},
+    {"session_set_option_string_if_version",NULL,__session_set_option_string_if_version,NULL},
+    {"session_set_option_list",NULL,__session_set_option_list,NULL},
+    {"session_append_to_option_list",NULL,__session_append_to_option_list,NULL},
+    {"session_delete_option",NULL,__session_delete_option,NULL},
+    {"session_add_section",NULL,__session_add_section,NULL},
+    {"session_delete_section",__delete_section_setup,__session_delete_section,NULL},
+    {"session_commit_txn10",NULL,__session_commit_txn,NULL},
+    {"session_commit_journal",__journal_setup,__session_commit_journal,__journal_teardown},
+    {"session_rollback",NULL,__session_rollback,NULL},
+    {"export_json",__json_export_setup,__export_json,__json_teardown},
+    {"import_json_unchanged",__json_unchanged_setup,__import_json_unchanged,__json_teardown},
+    {"import_json_merge",__json_merge_setup,__import_json_merge,__json_teardown},
+    {"staged_set_option_string",__staged_setup,__session_set_option_string,__staged_teardown},
+    {"session_flush",__staged_setup,__session_flush,__staged_teardown},
+    {"set_option_string",NULL,__set_option_string,NULL},
+    {"writer_set_option_string",__writer_setup,__set_option_string,__writer_teardown},
+    {"writer_sync",__writer_setup,__writer_sync,__writer_teardown},
+    {"async_loop_tick",__async_setup,__async_loop_tick,__async_teardown},
+    {"async_roundtrip",__async_setup,__async_roundtrip,__async_teardown},
+};
+
+static int __cmp_ll(const void* a,const void* b)
+{
+    long long x=*(const long long*)a;
+    long long y=*(const long long*)b;
+
+    return x<y?-1:x>y;
+}
+
+static long long __percentile(const long long* sorted,size_t count,double p)
+{
+    size_t i=(size_t)(p*(count-1)+0.5);
+
+    return sorted[i<count?i:count-1];
+}
+
+static double __per_call(long long before,long long after,long long overhead,size_t count)
+{
+    double ret;
+
+    if(before<0||after<0)
+    {
+        return -1;
+    }
+
+    ret=(double)(after-before-overhead)/count;
+
+    return ret<0?0:ret;
+}
+
+/*
+ * Run a case and print one JSON object for it
+ * Return 0 for success, -1 if the case failed
+ */
+static int __run_case(const struct bench_case* c,struct bench_env* e,size_t iterations,long long* samples,
+    const struct bench_counters* overhead)
+{
+    size_t i;
+    long long t0,t1,start;
+    long long total=0;
+    struct bench_counters before,after;
+
+    if(c->setup!=NULL&&c->setup(e,iterations)!=0)
+    {
+        fprintf(stderr,"%s: setup failed with %zu sections\n",c->name,e->n);
+        return -1;
+    }
+
+    __counters_get(&before);
+    start=__now_ns();
+    for(i=0;i<iterations;++i)
+    {
+        t0=__now_ns();
+        if(c->run(e,i)!=0)
+        {
+            fprintf(stderr,"%s: failed at iteration %zu with %zu sections\n",c->name,i,e->n);
+            if(c->teardown!=NULL)
+            {
+                c->teardown(e);
+            }
+            return -1;
+        }
+        t1=__now_ns();
+        samples[i]=t1-t0;
+        total+=t1-t0;
+
+        if(i+1>=BENCH_MIN_ITERATIONS&&t1-start>BENCH_TIME_LIMIT_NS)
+        {
+            ++i;
+            break;
+        }
+    }
+    __counters_get(&after);
+
+    if(c->teardown!=NULL)
+    {
+        c->teardown(e);
+    }
+
+    qsort(samples,i,sizeof(long long),__cmp_ll);
+
+    printf("{\"bench\":\"%s\",\"sections\":%zu,\"iterations\":%zu,\"mean_ns\":%lld,"
+        "\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld,"
+        "\"allocs_per_call\":%.2f,\"reads_per_call\":%.2f,\"writes_per_call\":%.2f,"
+        "\"fsyncs_per_call\":%.2f,\"renames_per_call\":%.2f}\n",
+        c->name,e->n,i,total/(long long)i,
+        __percentile(samples,i,0.5),__percentile(samples,i,0.9),__percentile(samples,i,0.99),samples[i-1],
+        __per_call((long long)before.allocs,(long long)after.allocs,(long long)overhead->allocs,i),
+        __per_call(before.reads,after.reads,overhead->reads,i),
+        __per_call(before.writes,after.writes,overhead->writes,i),
+        (double)(after.fsyncs-before.fsyncs)/i,(double)(after.renames-before.renames)/i);
+    fflush(stdout);
+
+    return 0;
+}
+
+static int __rm(const char* path,const struct stat* st,int flag,struct FTW* ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+static void __usage(const char* name)
+{
+    fprintf(stderr,"Usage: %s [-d tmpdir] [-s sizes] [-i iterations] [-f filter]\n"
+        "  -d  where the temporary confdir is made, /tmp by default\n"
+        "  -s  comma separated numbers of sections, " BENCH_DEFAULT_SIZES " by default\n"
+        "  -i  the most calls per case, %d by default, a case also stops after 2s\n"
+        "  -f  only run the cases whose name contains filter\n"
+        "One JSON object per case and size is printed on stdout\n",
+        name,BENCH_DEFAULT_ITERATIONS);
+}
+
+int main(int argc,char** argv)
+{
+    int opt;
+    int ret=0;
+    size_t n;
+    size_t i;
+    size_t iterations=BENCH_DEFAULT_ITERATIONS;
+    const char* tmp="/tmp";
+    const char* sizes=BENCH_DEFAULT_SIZES;
+    const char* filter=NULL;
+    const char* cur;
+    char* end;
+    long long* samples;
+    struct bench_env env;
+    struct bench_counters before,after,overhead;
+
+    while((opt=getopt(argc,argv,"d:s:i:f:h"))!=-1)
+    {
+        switch(opt)
+        {
+        case 'd':
+            tmp=optarg;
+            break;
+        case 's':
+            sizes=optarg;
+            break;
+        case 'i':
+            iterations=strtoul(optarg,NULL,10);
+            break;
+        case 'f':
+            filter=optarg;
+            break;
+        default:
+            __usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(iterations<BENCH_MIN_ITERATIONS)
+    {
+        iterations=BENCH_MIN_ITERATIONS;
+    }
+
+    samples=malloc(sizeof(long long)*iterations);
+    if(samples==NULL)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    snprintf(base_dir,sizeof(base_dir),"%s/easy_uci_bench.XXXXXX",tmp);
+    if(mkdtemp(base_dir)==NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    snprintf(conf_dir,sizeof(conf_dir),"%s/config",base_dir);
+    snprintf(save_dir,sizeof(save_dir),"%s/save",base_dir);
+    snprintf(snap_dir,sizeof(snap_dir),"%s/snapshot",base_dir);
+    if(mkdir(conf_dir,0700)!=0||mkdir(save_dir,0700)!=0)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    easy_uci_snapshot_set_dir(snap_dir);
+    easy_uci_cache_enable(true);
+
+    //What reading the counters costs by itself
+    __counters_get(&before);
+    __counters_get(&after);
+    overhead.allocs=after.allocs-before.allocs;
+    overhead.reads=before.reads<0?0:after.reads-before.reads;
+    overhead.writes=before.writes<0?0:after.writes-before.writes;
+
+    for(cur=sizes;*cur!='\0'&&ret==0;cur=*end==','?end+1:end)
+    {
+        n=strtoul(cur,&end,10);
+        if(end==cur||n==0)
+        {
+            __usage(argv[0]);
+            ret=1;
+            break;
+        }
+
+        memset(&env,0,sizeof(env));
+        env.n=n;
+        __batch_setup(&env,0);
+
+        if(__gen_package(n)!=0)
+        {
+            ret=1;
+            break;
+        }
+
+        env.s=easy_uci_session_open();
+        env.ro=easy_uci_session_open_readonly();
+        if(env.s==NULL||env.ro==NULL||__session_get_option_string(&env,0)!=0||__readonly_get_option_string(&env,0)!=0)
+        {
+            fprintf(stderr,"Failed to load a package of %zu sections\n",n);
+            ret=1;
+        }
+
+        for(i=0;i<sizeof(cases)/sizeof(cases[0])&&ret==0;++i)
+        {
+            if(filter!=NULL&&strstr(cases[i].name,filter)==NULL)
+            {
+                continue;
+            }
+            if(__run_case(&cases[i],&env,iterations,samples,&overhead)!=0)
+            {
+                ret=1;
+            }
+        }
+
+        easy_uci_session_close(env.s);
+        easy_uci_session_close(env.ro);
+        __snapshot_remove(&env);
+    }
+
+    nftw(base_dir,__rm,16,FTW_DEPTH|FTW_PHYS);
+    free(samples);
+
+    return ret;
+}
@@ -7,28 +7,24 @@
 #include <uci.h>
 
 #include "easy_uci.h"
+#include "easy_uci_internal.h"
 
-#define ERR_MSG_BUFF_SIZE 256
-
-#define LogE(s) __logE(__func__,s)
-
-#define uci_foreach_element_reverse(_list, _ptr) \
-    for(_ptr = list_to_element((_list)->prev); \
-        &_ptr->list != (_list); \
-        _ptr = list_to_element(_ptr->list.prev))
-
+//Accessed atomically, a logger can be registered while other threads log
 static void (*ext_logger)(const char*)=NULL;
 
 void easy_uci_register_error_logger(void(*logger)(const char*))
 {
-    ext_logger=logger;
+    __atomic_store_n(&ext_logger,logger,__ATOMIC_RELEASE);
 }
 
-static void __logE(const char* func,const char* msg)
+void __logE(const char* func,const char* msg)
 {
-    if(ext_logger!=NULL)
+    void (*logger)(const char*);
+
+    logger=__atomic_load_n(&ext_logger,__ATOMIC_ACQUIRE);
+    if(logger!=NULL)
     {
-        ext_logger(msg);
+        logger(msg);
     }
     else
     {
@@ -36,92 +32,240 @@ static void __logE(const char* func,const char* msg)
     }
 }
 
+/*
+ * Mark a pointer filled from the index as looked up, so libuci doesn't walk the package again to find it
+ * It's complete when every element named in it was found
+ */
+static void __ptr_done(struct uci_ptr* ptr)
+{
+    ptr->flags=UCI_LOOKUP_DONE;
+    if((ptr->section==NULL||ptr->s!=NULL)&&(ptr->option==NULL||ptr->o!=NULL))
+    {
+        ptr->flags|=UCI_LOOKUP_COMPLETE;
+    }
+}
+
+/*
+ * Whether a list was filled by __eu_list_alloc(), see easy_uci_free_list()
+ */
+static bool __list_packed(const easy_uci_list* list_p)
+{
+    return list_p->len>0&&list_p->list[0]==(const char*)(list_p->list+list_p->len);
+}
+
 void easy_uci_free_list(easy_uci_list* list_p)
 {
     size_t i;
 
-    for(i=0;i<list_p->len;++i)
+    if(!__list_packed(list_p))
     {
-        free((char*)list_p->list[i]);
+        for(i=0;i<list_p->len;++i)
+        {
+            free((char*)list_p->list[i]);
+        }
     }
     free(list_p->list);
     list_p->list=NULL;
     list_p->len=0;
 }
 
-int easy_uci_get_section_type(const char* package,const char* section,char* buff,size_t size)
+void easy_uci_free_section(easy_uci_section* section)
 {
-    int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    free(section);
+}
+
+char* __eu_list_alloc(easy_uci_list* list_p,size_t count,size_t bytes)
+{
+    char* block;
+
+    block=malloc(sizeof(char*)*count+bytes);
+    if(block==NULL)
+    {
+        return NULL;
+    }
+
+    list_p->list=(const char**)block;
+    list_p->len=count;
+
+    return block+sizeof(char*)*count;
+}
+
+int easy_uci_session_get_section_type(easy_uci_session* s,const char* package,const char* section,char* buff,size_t size)
+{
+    size_t len;
+    struct eu_package* p;
     struct uci_section* sec;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
     }
 
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    sec=__eu_index_section(p,section);
+    if(sec==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    STATS_START(t);
+    if(size>0)
+    {
+        len=strlen(sec->type);
+        if(len>=size)
+        {
+            len=size-1;
+        }
+        memcpy(buff,sec->type,len);
+        buff[len]='\0';
+    }
+    STATS_END(t,EASY_UCI_STATS_COPY,true);
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_session_get_section(easy_uci_session* s,const char* package,const char* section,easy_uci_section** section_p)
+{
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
+    struct uci_element* oe;
+    struct uci_element* e;
+    size_t count=0;
+    size_t values=0;
+    size_t bytes;
+    size_t i;
+    easy_uci_section* ret;
+    easy_uci_option* o;
+    const char** list;
+    char* buff;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
         goto error_msg;
     }
 
-    strncpy(buff,sec->type,size);
+    //Size everything first: the section, the options, the pointer arrays of lists, then the strings
+    STATS_START(t);
+    bytes=strlen(sec->e.name)+1+strlen(sec->type)+1;
+    uci_foreach_element(&sec->options,oe)
+    {
+        opt=uci_to_option(oe);
+        ++count;
+        bytes+=strlen(oe->name)+1;
+        if(opt->type==UCI_TYPE_STRING)
+        {
+            bytes+=strlen(opt->v.string)+1;
+        }
+        else
+        {
+            uci_foreach_element(&opt->v.list,e)
+            {
+                ++values;
+                bytes+=strlen(e->name)+1;
+            }
+        }
+    }
+
+    ret=malloc(sizeof(easy_uci_section)+sizeof(easy_uci_option)*count+sizeof(char*)*values+bytes);
+    if(ret==NULL)
+    {
+        STATS_END(t,EASY_UCI_STATS_COPY,false);
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        goto error_msg;
+    }
+
+    o=(easy_uci_option*)(ret+1);
+    list=(const char**)(o+count);
+    buff=(char*)(list+values);
 
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    ret->options=count>0?o:NULL;
+    ret->len=count;
+    ret->name=buff;
+    buff=stpcpy(buff,sec->e.name)+1;
+    ret->type=buff;
+    buff=stpcpy(buff,sec->type)+1;
+
+    uci_foreach_element(&sec->options,oe)
+    {
+        opt=uci_to_option(oe);
+        o->name=buff;
+        buff=stpcpy(buff,oe->name)+1;
+        if(opt->type==UCI_TYPE_STRING)
+        {
+            o->value=buff;
+            o->list=NULL;
+            o->list_len=0;
+            buff=stpcpy(buff,opt->v.string)+1;
+        }
+        else
+        {
+            o->value=NULL;
+            o->list=list;
+            i=0;
+            uci_foreach_element(&opt->v.list,e)
+            {
+                list[i++]=buff;
+                buff=stpcpy(buff,e->name)+1;
+            }
+            o->list_len=i;
+            list+=i;
+        }
+        ++o;
+    }
+    STATS_END(t,EASY_UCI_STATS_COPY,true);
+
+    *section_p=ret;
 
     return 0;
 
-/*error_uci:
-    uci_unload(ctx,pkg);*/
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
-    uci_free_context(ctx);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_add_section(const char* package,const char* type,const char* name)
+int easy_uci_session_add_section(easy_uci_session* s,const char* package,const char* type,const char* name)
 {
     int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_ptr ptr;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
@@ -129,7 +273,7 @@ int easy_uci_add_section(const char* package,const char* type,const char* name)
 
     if(name!=NULL&&name[0]!='\0')
     {
-        sec=uci_lookup_section(ctx,pkg,name);
+        sec=__eu_index_section(p,name);
         if(sec!=NULL)
         {
             if(strcmp(type,sec->type)!=0)
@@ -140,8 +284,6 @@ int easy_uci_add_section(const char* package,const char* type,const char* name)
                 goto error_msg;
             }
 
-            uci_unload(ctx,pkg);
-
             return 0;
         }
 
@@ -150,19 +292,21 @@ int easy_uci_add_section(const char* package,const char* type,const char* name)
         ptr.package=package;
         ptr.section=name;
         ptr.value=type;
-        ptr.p=pkg;
+        ptr.p=p->pkg;
+        __ptr_done(&ptr);
 
-        ret=uci_set(ctx,&ptr);
+        ret=uci_set(s->ctx,&ptr);
         if(ret!=0)
         {
             snprintf(err_msg,sizeof(err_msg),"Failed to create section: '%s' of type: '%s' with error",name,type);
             goto error_uci;
         }
+        sec=ptr.s;
     }
     else
     {
         //Add anonymous section
-        ret=uci_add_section(ctx,pkg,type,&sec);
+        ret=uci_add_section(s->ctx,p->pkg,type,&sec);
         if(ret!=0)
         {
             snprintf(err_msg,sizeof(err_msg),"Failed to create anonymous section of type: '%s' with error",type);
@@ -170,257 +314,181 @@ int easy_uci_add_section(const char* package,const char* type,const char* name)
         }
     }
 
-    //uci_save(ctx,pkg);
-    uci_commit(ctx,&pkg,false);
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    if(__eu_index_add_section(p,sec)!=0)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        snprintf(err_msg,sizeof(err_msg),"Failed to index section of type: '%s' with error",type);
+        goto error_uci;
+    }
+
+    ret=__eu_session_commit(s,p);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+        goto error_pkg;
+    }
 
     return 0;
 
 error_uci:
-    uci_unload(ctx,pkg);
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_delete_section(const char* package,const char* section)
+int easy_uci_session_delete_section(easy_uci_session* s,const char* package,const char* section)
 {
     int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_ptr ptr;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec!=NULL)
     {
         memset(&ptr,0,sizeof(struct uci_ptr));
         ptr.package=package;
-        ptr.section=section;
-        ptr.p=pkg;
+        ptr.section=sec->e.name;
+        ptr.p=p->pkg;
         ptr.s=sec;
+        __ptr_done(&ptr);
 
-        ret=uci_delete(ctx,&ptr);
+        __eu_index_del_section(p,sec);
+        ret=uci_delete(s->ctx,&ptr);
         if(ret!=0)
         {
             snprintf(err_msg,sizeof(err_msg),"Failed to delete section: '%s' with error",section);
             goto error_uci;
         }
 
-        //uci_save(ctx,pkg);
-        uci_commit(ctx,&pkg,false);
+        ret=__eu_session_commit(s,p);
+        if(ret!=0)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+            goto error_pkg;
+        }
     }
 
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
-
     return 0;
 
 error_uci:
-    uci_unload(ctx,pkg);
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
-/*error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
-    LogE(err_msg);
-    return -1;*/
 }
 
-int easy_uci_get_all_section_of_type(const char* package,const char* type,easy_uci_list* list_p)
+int easy_uci_session_get_all_section_of_type(easy_uci_session* s,const char* package,const char* type,easy_uci_list* list_p)
 {
-    int ret,i;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
-    struct uci_section* sec;
-    struct uci_section* list[1024];
-    struct uci_element* e;
-    int sec_count=0;
-    char** ss=NULL;
+    size_t i,len;
+    size_t bytes=0;
+    struct eu_package* p;
+    struct eu_type_list* tl;
+    easy_uci_list list;
+    char* buff;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    uci_foreach_element(&pkg->sections,e)
+    tl=__eu_index_type(p,type);
+    STATS_START(t);
+    if(tl!=NULL&&tl->len>0)
     {
-        sec=uci_to_section(e);
-        if(strcmp(sec->type,type)==0)
+        for(i=0;i<tl->len;++i)
         {
-            list[sec_count++]=sec;
+            bytes+=strlen(tl->secs[i]->e.name)+1;
         }
-    }
 
-    if(sec_count>0)
-    {
-        ss=malloc(sizeof(char*)*sec_count);
-        if(ss==NULL)
+        buff=__eu_list_alloc(&list,tl->len,bytes);
+        if(buff==NULL)
         {
+            STATS_END(t,EASY_UCI_STATS_COPY,false);
             snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
             goto error_msg;
         }
 
-        for(i=0;i<sec_count;++i)
+        for(i=0;i<tl->len;++i)
         {
-            ss[i]=strdup(list[i]->e.name);
-            if(ss[i]==NULL)
-            {
-                for(--i;i>=0;--i)
-                {
-                    free(ss[i]);
-                }
-                free(ss);
-                snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
-                goto error_msg;
-            }
+            len=strlen(tl->secs[i]->e.name)+1;
+            memcpy(buff,tl->secs[i]->e.name,len);
+            list.list[i]=buff;
+            buff+=len;
         }
 
-        list_p->list=(const char**)ss;
-        list_p->len=sec_count;
+        *list_p=list;
     }
     else
     {
         list_p->list=NULL;
         list_p->len=0;
     }
-
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    STATS_END(t,EASY_UCI_STATS_COPY,true);
 
     return 0;
 
-/*error_uci:
-    uci_unload(ctx,pkg);*/
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_get_nth_section_of_type(const char* package,const char* type,int n,char** name_p)
+int easy_uci_session_get_nth_section_of_type(easy_uci_session* s,const char* package,const char* type,int n,char** name_p)
 {
-    int ret,i;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
-    struct uci_element* e;
-    bool found=false;
     char* name;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    i=n;
-    if(i>=0)
-    {
-        uci_foreach_element(&pkg->sections,e)
-        {
-            sec=uci_to_section(e);
-            if(strcmp(sec->type,type)==0)
-            {
-                if(i==0)
-                {
-                    found=true;
-                    break;
-                }
-                else
-                {
-                    --i;
-                }
-            }
-        }
-    }
-    else
-    {
-        uci_foreach_element_reverse(&pkg->sections,e)
-        {
-            sec=uci_to_section(e);
-            if(strcmp(sec->type,type)==0)
-            {
-                if(i==-1)
-                {
-                    found=true;
-                    break;
-                }
-                else
-                {
-                    ++i;
-                }
-            }
-        }
-    }
-
-    if(!found)
+    sec=__eu_index_nth_of_type(p,type,n);
+    if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Can't find section of type '%s' at index %d",type,n);
         goto error_msg;
     }
 
+    STATS_START(t);
     name=strdup(sec->e.name);
+    STATS_END(t,EASY_UCI_STATS_COPY,name!=NULL);
     if(name==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
@@ -429,96 +497,110 @@ int easy_uci_get_nth_section_of_type(const char* package,const char* type,int n,
 
     *name_p=name;
 
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
-
     return 0;
 
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_get_option_string(const char* package,const char* section,const char* option,char* buff,size_t size)
+int easy_uci_session_get_section_count_of_type(easy_uci_session* s,const char* package,const char* type,size_t* count_p)
 {
-    int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
-    struct uci_section* sec;
-    struct uci_option*  opt;
+    struct eu_package* p;
+    struct eu_type_list* tl;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
     }
 
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    tl=__eu_index_type(p,type);
+    *count_p=tl==NULL?0:tl->len;
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+}
+
+int easy_uci_session_get_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,char* buff,size_t size)
+{
+    size_t len;
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
         goto error_msg;
     }
 
-    opt=uci_lookup_option(ctx,sec,option);
+    opt=__eu_index_option(p,sec,option);
     if(opt==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
         goto error_msg;
     }
 
-    if(!opt||opt->type!=UCI_TYPE_STRING)
+    if(opt->type!=UCI_TYPE_STRING)
     {
         snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a string",option);
         goto error_msg;
     }
 
-    strncpy(buff,opt->v.string,size);
-
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    STATS_START(t);
+    if(size>0)
+    {
+        len=strlen(opt->v.string);
+        if(len>=size)
+        {
+            len=size-1;
+        }
+        memcpy(buff,opt->v.string,len);
+        buff[len]='\0';
+    }
+    STATS_END(t,EASY_UCI_STATS_COPY,true);
 
     return 0;
 
-/*error_uci:
-    uci_unload(ctx,pkg);*/
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_set_option_string(const char* package,const char* section,const char* option,const char* value)
+int easy_uci_session_set_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value)
 {
     int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_ptr ptr;
     char* err_str=NULL;
@@ -526,25 +608,18 @@ int easy_uci_set_option_string(const char* package,const char* section,const cha
 
     if(value==NULL||value[0]=='\0')
     {
+        __eu_session_fail(s);
         return -1;
     }
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
@@ -554,100 +629,109 @@ int easy_uci_set_option_string(const char* package,const char* section,const cha
     memset(&ptr,0,sizeof(struct uci_ptr));
 
     ptr.package=package;
-    ptr.section=section;
+    ptr.section=sec->e.name;
     ptr.option=option;
     ptr.value=value;
 
-    ptr.p=pkg;
+    ptr.p=p->pkg;
     ptr.s=sec;
+    ptr.o=__eu_index_option(p,sec,option);
+    __ptr_done(&ptr);
 
-    ret=uci_set(ctx,&ptr);
+    //uci_set() may free the option and put a new one in its place
+    __eu_index_del_option(p,sec,option);
+    ret=uci_set(s->ctx,&ptr);
     if(ret!=0)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to set option: '%s' with error",option);
         goto error_uci;
     }
 
-    //uci_save(ctx,pkg);
-    uci_commit(ctx,&pkg,false);
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    if(__eu_index_put_option(p,sec,ptr.o)!=0)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        snprintf(err_msg,sizeof(err_msg),"Failed to index option: '%s' with error",option);
+        goto error_uci;
+    }
+
+    ret=__eu_session_commit(s,p);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+        goto error_pkg;
+    }
 
     return 0;
 
 error_uci:
-    uci_unload(ctx,pkg);
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_get_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p)
+int easy_uci_session_get_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p)
 {
-    int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_option*  opt;
     struct uci_element* e;
-    char** ss;
-    int count=0;
+    size_t count=0;
+    size_t bytes=0;
+    size_t len;
+    easy_uci_list list;
+    char* buff;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
         goto error_msg;
     }
 
-    opt=uci_lookup_option(ctx,sec,option);
+    opt=__eu_index_option(p,sec,option);
     if(opt==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
         goto error_msg;
     }
 
-    if(!opt||opt->type!=UCI_TYPE_LIST)
+    if(opt->type!=UCI_TYPE_LIST)
     {
         snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a list",option);
         goto error_msg;
     }
 
+    STATS_START(t);
     uci_foreach_element(&opt->v.list,e)
     {
         ++count;
+        bytes+=strlen(e->name)+1;
     }
 
     if(count>0)
     {
-        ss=malloc(sizeof(char*)*count);
-        if(ss==NULL)
+        buff=__eu_list_alloc(&list,count,bytes);
+        if(buff==NULL)
         {
+            STATS_END(t,EASY_UCI_STATS_COPY,false);
             snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
             goto error_msg;
         }
@@ -655,55 +739,38 @@ int easy_uci_get_option_list(const char* package,const char* section,const char*
         count=0;
         uci_foreach_element(&opt->v.list,e)
         {
-            ss[count]=strdup(e->name);
-            if(ss[count]==NULL)
-            {
-                LogE(err_msg);
-                for(--count;count>=0;--count)
-                {
-                    free(ss[count]);
-                }
-                snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
-                goto error_msg;
-            }
-            ++count;
+            len=strlen(e->name)+1;
+            memcpy(buff,e->name,len);
+            list.list[count++]=buff;
+            buff+=len;
         }
 
-        list_p->list=(const char**)ss;
-        list_p->len=count;
+        *list_p=list;
     }
     else
     {
         list_p->list=NULL;
         list_p->len=0;
     }
-
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    STATS_END(t,EASY_UCI_STATS_COPY,true);
 
     return 0;
 
-/*error_uci:
-    uci_unload(ctx,pkg);*/
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_set_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p)
+int easy_uci_session_set_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p)
 {
     int ret;
     size_t i;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_option*  opt;
     struct uci_ptr ptr;
@@ -712,43 +779,38 @@ int easy_uci_set_option_list(const char* package,const char* section,const char*
 
     if(list_p==NULL||list_p->len==0||list_p->list==NULL)
     {
+        __eu_session_fail(s);
         return -1;
     }
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
         goto error_msg;
     }
 
-    opt=uci_lookup_option(ctx,sec,option);
+    opt=__eu_index_option(p,sec,option);
     if(opt!=NULL)
     {
         memset(&ptr,0,sizeof(struct uci_ptr));
         ptr.package=package;
-        ptr.section=section;
+        ptr.section=sec->e.name;
         ptr.option=option;
-        ptr.p=pkg;
+        ptr.p=p->pkg;
         ptr.s=sec;
         ptr.o=opt;
+        __ptr_done(&ptr);
 
-        ret=uci_delete(ctx,&ptr);
+        __eu_index_del_option(p,sec,option);
+        ret=uci_delete(s->ctx,&ptr);
         if(ret!=0)
         {
             snprintf(err_msg,sizeof(err_msg),"Failed to delete old option: '%s' with error",option);
@@ -758,15 +820,17 @@ int easy_uci_set_option_list(const char* package,const char* section,const char*
 
     memset(&ptr,0,sizeof(struct uci_ptr));
     ptr.package=package;
-    ptr.section=section;
+    ptr.section=sec->e.name;
     ptr.option=option;
-    ptr.p=pkg;
+    ptr.p=p->pkg;
     ptr.s=sec;
+    //uci_add_list() fills ptr.o with the new list, the later items are appended to it directly
+    __ptr_done(&ptr);
 
     for(i=0;i<list_p->len;++i)
     {
         ptr.value=list_p->list[i];
-        ret=uci_add_list(ctx,&ptr);
+        ret=uci_add_list(s->ctx,&ptr);
         if(ret!=0)
         {
             snprintf(err_msg,sizeof(err_msg),"Failed to append to option: '%s' with error",option);
@@ -774,33 +838,40 @@ int easy_uci_set_option_list(const char* package,const char* section,const char*
         }
     }
 
-    //uci_save(ctx,pkg);
-    uci_commit(ctx,&pkg,false);
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    if(__eu_index_put_option(p,sec,ptr.o)!=0)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        snprintf(err_msg,sizeof(err_msg),"Failed to index option: '%s' with error",option);
+        goto error_uci;
+    }
+
+    ret=__eu_session_commit(s,p);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+        goto error_pkg;
+    }
 
     return 0;
 
 error_uci:
-    uci_unload(ctx,pkg);
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_append_to_option_list(const char* package,const char* section,const char* option,const char* value)
+int easy_uci_session_append_to_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value)
 {
     int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
     struct uci_section* sec;
     struct uci_ptr ptr;
     char* err_str=NULL;
@@ -808,25 +879,18 @@ int easy_uci_append_to_option_list(const char* package,const char* section,const
 
     if(value==NULL)
     {
+        __eu_session_fail(s);
         return -1;
     }
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    sec=uci_lookup_section(ctx,pkg,section);
+    sec=__eu_index_section(p,section);
     if(sec==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
@@ -835,92 +899,349 @@ int easy_uci_append_to_option_list(const char* package,const char* section,const
 
     memset(&ptr,0,sizeof(struct uci_ptr));
     ptr.package=package;
-    ptr.section=section;
+    ptr.section=sec->e.name;
     ptr.option=option;
-    ptr.p=pkg;
+    ptr.p=p->pkg;
     ptr.s=sec;
+    ptr.o=__eu_index_option(p,sec,option);
     ptr.value=value;
-    ret=uci_add_list(ctx,&ptr);
+    __ptr_done(&ptr);
+
+    //A string option is freed and replaced by a list
+    __eu_index_del_option(p,sec,option);
+    ret=uci_add_list(s->ctx,&ptr);
     if(ret!=0)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to append to option: '%s' with error",option);
         goto error_uci;
     }
 
-    //uci_save(ctx,pkg);
-    uci_commit(ctx,&pkg,false);
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    if(__eu_index_put_option(p,sec,ptr.o)!=0)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        snprintf(err_msg,sizeof(err_msg),"Failed to index option: '%s' with error",option);
+        goto error_uci;
+    }
+
+    ret=__eu_session_commit(s,p);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+        goto error_pkg;
+    }
 
     return 0;
 
 error_uci:
-    uci_unload(ctx,pkg);
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
 error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
     LogE(err_msg);
     return -1;
 }
 
-int easy_uci_delete_option(const char* package,const char* section,const char* option)
+int easy_uci_session_delete_option(easy_uci_session* s,const char* package,const char* section,const char* option)
 {
     int ret;
-    struct uci_context* ctx=NULL;
-    struct uci_package* pkg;
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
     struct uci_ptr ptr;
     char* err_str=NULL;
     char err_msg[ERR_MSG_BUFF_SIZE];
 
-    ctx=uci_alloc_context();
-    if(ctx==NULL)
-    {
-        snprintf(err_msg,sizeof(err_msg),"Failed to alloc uci context");
-        LogE(err_msg);
-        return -1;
-    }
-
-    ret=uci_load(ctx,package,&pkg);
-    if(ret!=0||pkg==NULL)
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
     {
         snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
         goto error_pkg;
     }
 
-    memset(&ptr,0,sizeof(struct uci_ptr));
+    sec=__eu_index_section(p,section);
+    opt=sec==NULL?NULL:__eu_index_option(p,sec,option);
+    if(opt!=NULL)
+    {
+        memset(&ptr,0,sizeof(struct uci_ptr));
 
-    ptr.package=package;
-    ptr.section=section;
-    ptr.option=option;
+        ptr.package=package;
+        ptr.section=sec->e.name;
+        ptr.option=option;
 
-    ptr.p=pkg;
+        ptr.p=p->pkg;
+        ptr.s=sec;
+        ptr.o=opt;
+        __ptr_done(&ptr);
 
-    ret=uci_delete(ctx,&ptr);
+        __eu_index_del_option(p,sec,option);
+        ret=uci_delete(s->ctx,&ptr);
+        if(ret!=0)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to delete option: '%s' with error",option);
+            goto error_uci;
+        }
 
-    //uci_save(ctx,pkg);
-    uci_commit(ctx,&pkg,false);
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
+        ret=__eu_session_commit(s,p);
+        if(ret!=0)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+            goto error_pkg;
+        }
+    }
 
     return 0;
 
-/*error_uci:
-    uci_unload(ctx,pkg);*/
+error_uci:
+    __eu_session_drop(s,p);
 error_pkg:
-    uci_get_errorstr(ctx,&err_str,err_msg);
-    uci_free_context(ctx);
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
     LogE(err_str);
     free(err_str);
     return -1;
-/*error_msg:
-    uci_unload(ctx,pkg);
-    uci_free_context(ctx);
-    LogE(err_msg);
-    return -1;*/
+}
+
+/*
+ * The functions below each run in a session of their own
+ * Getters use the process-wide cache instead when it's enabled
+ * While the background writer runs, all of them use its session instead
+ */
+
+int easy_uci_get_section_type(const char* package,const char* section,char* buff,size_t size)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_section_type(s,package,section,buff,size);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_section(const char* package,const char* section,easy_uci_section** section_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_section(s,package,section,section_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_add_section(const char* package,const char* type,const char* name)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_add_section(s,package,type,name);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_delete_section(const char* package,const char* section)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_section(s,package,section);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_all_section_of_type(const char* package,const char* type,easy_uci_list* list_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_all_section_of_type(s,package,type,list_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_nth_section_of_type(const char* package,const char* type,int n,char** name_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_nth_section_of_type(s,package,type,n,name_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_section_count_of_type(const char* package,const char* type,size_t* count_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_section_count_of_type(s,package,type,count_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_string(const char* package,const char* section,const char* option,char* buff,size_t size)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_option_string(s,package,section,option,buff,size);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_set_option_string(const char* package,const char* section,const char* option,const char* value)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_string(s,package,section,option,value);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_option_list(s,package,section,option,list_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_set_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_list(s,package,section,option,list_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_append_to_option_list(const char* package,const char* section,const char* option,const char* value)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_append_to_option_list(s,package,section,option,value);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_delete_option(const char* package,const char* section,const char* option)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_option(s,package,section,option);
+
+    __eu_write_session_close(s);
+
+    return ret;
 }
@@ -10,19 +10,579 @@ typedef struct
     size_t len;
 } easy_uci_list;
 
+/*
+ * A string borrowed from a package loaded in a session, see easy_uci_session_view_option_string()
+ */
+typedef struct
+{
+    const char* str;
+    size_t len;
+} easy_uci_view;
+
+/*
+ * A token identifying the content of a package, see easy_uci_get_version()
+ */
+typedef unsigned long long easy_uci_version;
+
+/*
+ * An option of a section got by easy_uci_get_section()
+ */
+typedef struct
+{
+    const char* name;
+    //The value of a string option, NULL for a list option
+    const char* value;
+    //The values of a list option, NULL for a string option
+    const char** list;
+    size_t list_len;
+} easy_uci_option;
+
+/*
+ * A section with all its options in file order, allocated as one block, see easy_uci_free_section()
+ */
+typedef struct
+{
+    const char* name;
+    const char* type;
+    easy_uci_option* options;
+    size_t len;
+} easy_uci_section;
+
+/*
+ * The result of one path of easy_uci_get_batch()
+ */
+typedef struct
+{
+    //0 if found, 1 if the section or the option doesn't exist, -1 if the path is malformed or its package can't be loaded
+    int status;
+    //The option found, all its members are NULL unless status is 0
+    easy_uci_option option;
+} easy_uci_result;
+
+/**
+ * easy_uci_session: an opaque handle that keeps one uci context and the packages it has parsed
+ *
+ * Each easy_uci_xxx() function has an easy_uci_session_xxx() counterpart taking a session as its first argument
+ * A package is parsed on its first use in a session and kept until it's unloaded or the session is closed
+ * Changes made to a package outside of the session are not seen until the package is unloaded
+ * A session must not be used by more than one thread at a time
+ * The functions not taking a session are thread-safe: calls reading a package run in parallel,
+ * a call writing a package waits only for the other calls on that package
+ *
+ * Wherever an existing section is named, it can also be given as @type[n] like in the uci command line
+ * n counts from 0, or from -1 for the last section of the type
+ */
+typedef struct easy_uci_session easy_uci_session;
+
 /**
  * easy_uci_register_error_logger: register a function that will be called when error occurred
  * @param logger: the pointer to a logger function
+ *
+ * The logger can be changed at any time, it's called from whichever thread the error occurred in
  */
 void easy_uci_register_error_logger(void(*logger)(const char*));
 
+/**
+ * easy_uci_session_open: open a new session
+ * @return: the new session, NULL for failure
+ *
+ * The session must be closed by easy_uci_session_close()
+ * A commit of many packages interrupted by a crash is finished or discarded by the first session opened by the process
+ * after its config dir is set, see easy_uci_session_commit()
+ */
+easy_uci_session* easy_uci_session_open(void);
+
+/**
+ * easy_uci_session_open_readonly: open a new session that can only read
+ * @return: the new session, NULL for failure
+ *
+ * Packages are parsed straight from the mapped config file into one block instead of a node per element by libuci
+ * Files using what the fast parser doesn't handle, like backslash escapes, and packages with staged deltas
+ * are still parsed by libuci, the results are the same either way
+ * Setters fail on a read-only session
+ * The getters not taking a session read this way
+ */
+easy_uci_session* easy_uci_session_open_readonly(void);
+
+/**
+ * easy_uci_session_close: close a session and free all packages loaded in it
+ * @param s: the session, can be NULL
+ * @return: no return
+ */
+void easy_uci_session_close(easy_uci_session* s);
+
+/**
+ * easy_uci_session_unload: unload a package from a session
+ * @param s: the session
+ * @param package: the name of the package
+ * @return: 0 for success, -1 for failure
+ *
+ * The package will be parsed again on its next use, picking up changes made outside of the session
+ * Unloading a package that isn't loaded will succeed
+ */
+int easy_uci_session_unload(easy_uci_session* s,const char* package);
+
+/**
+ * easy_uci_session_begin: open a write transaction in a session
+ * @param s: the session
+ * @return: 0 for success, -1 for failure
+ *
+ * Until the transaction is committed, the setters of the session only change the packages loaded in the session
+ * Any mix of add, set, append and delete operations on any number of packages can be queued this way
+ * Getters of the session see the queued changes
+ * Only one transaction can be open in a session at a time
+ */
+int easy_uci_session_begin(easy_uci_session* s);
+
+/**
+ * easy_uci_session_commit: commit the open transaction of a session
+ * @param s: the session
+ * @return: 0 for success, EASY_UCI_CONFLICT if a package changed since the version a conditional setter expected, -1 for other failures
+ *
+ * Each package changed by the transaction is written once
+ * If any setter failed while the transaction was open, nothing is written and the transaction is rolled back
+ * The transaction is closed whether this function succeeds or not
+ *
+ * A transaction changing many packages is all or nothing, even across a crash: the new config files are synced
+ * and listed in a journal in the confdir before any of them replaces the old one. A journal left by a crash is
+ * finished or discarded by the next commit of any process, and by the first easy_uci_session_open() of a process
+ * Once the journal is committed this function succeeds, a config file that can't be replaced then is replaced by
+ * the next recovery
+ * Such a transaction fails with EASY_UCI_CONFLICT if one of its packages was changed by somebody else after it was
+ * loaded in the session, as the whole package is written
+ * A transaction in a session staging writes or queueing them for the background writer writes its packages one
+ * after another, a failure while writing one leaves the ones before it written
+ */
+int easy_uci_session_commit(easy_uci_session* s);
+
+/**
+ * easy_uci_session_rollback: discard the open transaction of a session
+ * @param s: the session
+ * @return: no return
+ *
+ * All packages changed by the transaction are unloaded from the session, leaving the config files untouched
+ * Closing a session with an open transaction also discards it
+ */
+void easy_uci_session_rollback(easy_uci_session* s);
+
+/**
+ * easy_uci_cache_enable: enable or disable the process-wide package cache
+ * @param enable: true to enable, false to disable and free all cached packages
+ * @return: 0 for success, -1 for failure
+ *
+ * When enabled, the getters not taking a session keep the packages they parse in the cache
+ * A cached package is only reused after a stat() shows its config file has the same mtime, size and inode
+ * Otherwise it's parsed again
+ * Each config file is cached on its own, threads reading a cached package share it without copying
+ * Writes made through easy_uci drop the written package from the cache
+ * The cache is disabled by default
+ */
+int easy_uci_cache_enable(bool enable);
+
+/**
+ * easy_uci_cache_invalidate: drop a package from the process-wide cache
+ * @param package: the name of the package, NULL for all packages
+ * @return: no return
+ */
+void easy_uci_cache_invalidate(const char* package);
+
+/**
+ * easy_uci_set_config_dir: set the directories used by all sessions opened afterwards
+ * @param confdir: the directory of the config files, NULL for the uci default (/etc/config)
+ * @param savedir: the directory of the uncommitted changes, NULL for the uci default (/tmp/.uci)
+ * @return: 0 for success, -1 for failure
+ *
+ * Sessions already open keep the directories they were opened with, the process-wide cache drops its cached packages
+ */
+int easy_uci_set_config_dir(const char* confdir,const char* savedir);
+
+/**
+ * easy_uci_watch: an opaque handle watching the config files for changes, see easy_uci_watch_open()
+ */
+typedef struct easy_uci_watch easy_uci_watch;
+
+/*
+ * Called with the name of a package whose config file or delta file has changed
+ * package is NULL if changes were lost because too many happened at once, any package may have changed
+ */
+typedef void (*easy_uci_watch_cb)(const char* package,void* arg);
+
+/**
+ * easy_uci_watch_open: start watching the confdir and the savedir with inotify
+ * @param cb: the function called for each changed package, can be NULL to only invalidate the cache
+ * @param arg: passed to cb as it is
+ * @return: the watch, NULL for failure
+ *
+ * Nothing is read until easy_uci_watch_dispatch() is called, so a process waiting for changes costs nothing
+ * The watch must be closed by easy_uci_watch_close()
+ */
+easy_uci_watch* easy_uci_watch_open(easy_uci_watch_cb cb,void* arg);
+
+/**
+ * easy_uci_watch_close: stop watching and free a watch
+ * @param w: the watch, can be NULL
+ * @return: no return
+ */
+void easy_uci_watch_close(easy_uci_watch* w);
+
+/**
+ * easy_uci_watch_fd: get the file descriptor of a watch
+ * @param w: the watch
+ * @return: the fd, which is readable when there're changes to dispatch
+ *
+ * The fd is non-blocking, add it to a poll(), select() or epoll loop and call easy_uci_watch_dispatch() when it's readable
+ */
+int easy_uci_watch_fd(easy_uci_watch* w);
+
+/**
+ * easy_uci_watch_dispatch: handle the changes pending on a watch
+ * @param w: the watch
+ * @return: the number of changes reported, -1 for failure
+ *
+ * Each changed package is dropped from the process-wide cache and reported to the callback
+ * A package is reported once per call even if both its files changed
+ * Changes made by this process are reported too
+ */
+int easy_uci_watch_dispatch(easy_uci_watch* w);
+
+/*
+ * easy_uci_snapshot: an opaque handle to a compiled snapshot of a package, see easy_uci_snapshot_open()
+ */
+typedef struct easy_uci_snapshot easy_uci_snapshot;
+
+/**
+ * easy_uci_snapshot_set_dir: set the dir the snapshot files are kept in
+ * @param dir: the dir, NULL for the default /var/run/easy_uci
+ * @return: 0 for success, -1 for failure
+ */
+int easy_uci_snapshot_set_dir(const char* dir);
+
+/**
+ * easy_uci_snapshot_compile: compile a package into a snapshot file
+ * @param package: the name of the package
+ * @return: 0 for success, -1 for failure
+ *
+ * A snapshot holds a string table, the sections with an index by type and the options, laid out to be read in place
+ * Once a package has a snapshot, every commit of it through easy_uci writes the snapshot again
+ */
+int easy_uci_snapshot_compile(const char* package);
+
+/**
+ * easy_uci_snapshot_open: map the snapshot of a package
+ * @param package: the name of the package
+ * @return: the snapshot, NULL for failure
+ *
+ * The snapshot file is mapped with no parsing if it's still valid: the config file and the delta file have the same
+ * stamp as when it was compiled, or the config file has the same content
+ * Otherwise the package is compiled again, and read from memory if the snapshot file can't be saved
+ * The snapshot doesn't change once opened, open it again to see later changes
+ * The snapshot must be closed by easy_uci_snapshot_close(), it can be read by many threads at once
+ */
+easy_uci_snapshot* easy_uci_snapshot_open(const char* package);
+
+/**
+ * easy_uci_snapshot_close: unmap and free a snapshot
+ * @param snap: the snapshot, can be NULL
+ * @return: no return
+ */
+void easy_uci_snapshot_close(easy_uci_snapshot* snap);
+
+/*
+ * The getters of a snapshot, same as the getters of a package with the same name
+ */
+int easy_uci_snapshot_get_section_type(const easy_uci_snapshot* snap,const char* section,char* buff,size_t size);
+int easy_uci_snapshot_get_all_section_of_type(const easy_uci_snapshot* snap,const char* type,easy_uci_list* list_p);
+int easy_uci_snapshot_get_nth_section_of_type(const easy_uci_snapshot* snap,const char* type,int n,char** name_p);
+int easy_uci_snapshot_get_section_count_of_type(const easy_uci_snapshot* snap,const char* type,size_t* count_p);
+int easy_uci_snapshot_get_option_string(const easy_uci_snapshot* snap,const char* section,const char* option,char* buff,size_t size);
+int easy_uci_snapshot_get_option_list(const easy_uci_snapshot* snap,const char* section,const char* option,easy_uci_list* list_p);
+
+/*
+ * The phases timed by the stats, see easy_uci_get_stats()
+ */
+enum
+{
+    //Parsing a package into a session
+    EASY_UCI_STATS_LOAD,
+    //Looking up a section or an option by name, a failure is a name not found
+    EASY_UCI_STATS_LOOKUP,
+    //Copying what a getter returns out of the package
+    EASY_UCI_STATS_COPY,
+    //Writing a package to its config file or its delta file
+    EASY_UCI_STATS_COMMIT,
+    EASY_UCI_STATS_PHASES,
+};
+
+#define EASY_UCI_HIST_BUCKETS 32
+
+typedef struct
+{
+    unsigned long calls;
+    unsigned long failures;
+    unsigned long long total_ns;
+    //Bucket i counts the calls taking from 2^i to 2^(i+1) ns, the last one also counts all longer calls
+    unsigned long hist[EASY_UCI_HIST_BUCKETS];
+} easy_uci_phase_stats;
+
+/*
+ * Counters of the whole process, see easy_uci_get_stats()
+ */
+typedef struct
+{
+    easy_uci_phase_stats phases[EASY_UCI_STATS_PHASES];
+    //Size of the config files and delta files parsed by loads
+    unsigned long long bytes_parsed;
+    //Size of the config files written by commits, plus what staged commits appended to delta files
+    unsigned long long bytes_written;
+} easy_uci_stats;
+
+/*
+ * Counters of one package, see easy_uci_get_package_stats()
+ */
+typedef struct
+{
+    unsigned long commits;
+    unsigned long failures;
+    unsigned long long bytes_written;
+} easy_uci_package_stats;
+
+/**
+ * easy_uci_stats_enable: turn the stats on or off for all sessions
+ * @param enable: true to count and time calls from now on, false to stop
+ * @return: 0 for success, -1 if the library was built with EASY_UCI_NO_STATS
+ *
+ * The stats are off by default, which costs one relaxed load per timed phase
+ * Building with -DEASY_UCI_NO_STATS compiles them out entirely
+ */
+int easy_uci_stats_enable(bool enable);
+
+/**
+ * easy_uci_get_stats: get the counters and latency histograms of each phase
+ * @param stats: the pointer to an easy_uci_stats for output
+ * @return: 0 for success, -1 if the library was built with EASY_UCI_NO_STATS
+ *
+ * Calls running meanwhile may be counted in some fields and not yet in others
+ */
+int easy_uci_get_stats(easy_uci_stats* stats);
+
+/**
+ * easy_uci_get_package_stats: get the commit counters of a package
+ * @param package: the name of the package, as given to the setters
+ * @param stats: the pointer to an easy_uci_package_stats for output, all zeros if the package has no commit counted
+ * @return: 0 for success, -1 if the library was built with EASY_UCI_NO_STATS
+ */
+int easy_uci_get_package_stats(const char* package,easy_uci_package_stats* stats);
+
+/**
+ * easy_uci_reset_stats: set all counters back to zero
+ * @return: no return
+ */
+void easy_uci_reset_stats(void);
+
+/*
+ * Counters of the background writer, see easy_uci_writer_get_stats()
+ * Changes are counted when their package is committed
+ */
+typedef struct
+{
+    //Changes made by the setters
+    unsigned long writes;
+    //Packages written
+    unsigned long commits;
+    //Changes written along with an earlier change to the same package instead of by a commit of their own
+    unsigned long coalesced;
+    //Commits that failed, their changes are lost
+    unsigned long failures;
+} easy_uci_writer_stats;
+
+/**
+ * easy_uci_writer_start: start the background writer
+ * @param debounce_ms: how long changes are collected before they're committed, in milliseconds
+ * @return: 0 for success, -1 for failure
+ *
+ * While the writer runs, the functions not taking a session share one session with it
+ * Setters only change that session and return, the writer thread commits each changed package once per debounce window
+ * The window starts with the first change after a commit, so a package is written at most once per debounce_ms
+ * Getters not taking a session see the changes not yet committed, other processes and sessions don't
+ * The thread commits with the shared session swapped out, a call on a package being committed waits for that commit
+ * and calls on other packages go on in a new session
+ * Conditional writes, JSON imports and async transactions commit with the shared session held, other calls not
+ * taking a session wait for those
+ * Errors of the writer thread are logged from that thread
+ */
+int easy_uci_writer_start(unsigned int debounce_ms);
+
+/**
+ * easy_uci_writer_stop: commit all queued changes and stop the background writer
+ * @return: no return
+ *
+ * Stopping a writer that isn't running does nothing
+ */
+void easy_uci_writer_stop(void);
+
+/**
+ * easy_uci_writer_sync: commit all queued changes now and wait for them to be written
+ * @return: 0 for success, -1 if any commit failed
+ *
+ * Syncing when the writer isn't running succeeds right away
+ */
+int easy_uci_writer_sync(void);
+
+/**
+ * easy_uci_writer_get_stats: get the counters of the background writer
+ * @param stats: the pointer to an easy_uci_writer_stats for output
+ * @return: no return
+ *
+ * The counters are reset when the writer is started
+ */
+void easy_uci_writer_get_stats(easy_uci_writer_stats* stats);
+
+/**
+ * easy_uci_async: an opaque handle to a queue of writes run by worker threads, see easy_uci_async_open()
+ */
+typedef struct easy_uci_async easy_uci_async;
+
+/*
+ * The kinds of change of an easy_uci_op, each one does what the setter with the same name does
+ */
+enum
+{
+    //Set option of section to value
+    EASY_UCI_OP_SET_OPTION_STRING,
+    //Set option of section to the list_len values of list
+    EASY_UCI_OP_SET_OPTION_LIST,
+    //Append value to the list option of section
+    EASY_UCI_OP_APPEND_TO_OPTION_LIST,
+    EASY_UCI_OP_DELETE_OPTION,
+    //Add a section of type value named section, section can be NULL for an anonymous section
+    EASY_UCI_OP_ADD_SECTION,
+    EASY_UCI_OP_DELETE_SECTION,
+};
+
+/*
+ * One change submitted by easy_uci_async_submit(), the members not used by its type are ignored
+ */
+typedef struct
+{
+    int type;
+    const char* package;
+    const char* section;
+    const char* option;
+    const char* value;
+    const char* const* list;
+    size_t list_len;
+} easy_uci_op;
+
+/*
+ * The outcome of a request, see easy_uci_async_reap()
+ */
+typedef struct
+{
+    long long id;
+    //0 for success, -1 for failure
+    int result;
+} easy_uci_completion;
+
+/**
+ * easy_uci_async_open: start a queue of writes
+ * @param workers: the number of worker threads, 0 for the default of 2
+ * @return: the queue, NULL for failure
+ *
+ * Requests on the same package run one at a time in the order they were submitted, requests on different packages
+ * run in parallel on the workers
+ * The queue must be closed by easy_uci_async_close()
+ */
+easy_uci_async* easy_uci_async_open(unsigned int workers);
+
+/**
+ * easy_uci_async_close: run the requests left, stop the workers and free the queue
+ * @param a: the queue, can be NULL
+ * @return: no return
+ *
+ * Completions not reaped yet are dropped
+ */
+void easy_uci_async_close(easy_uci_async* a);
+
+/**
+ * easy_uci_async_fd: get the eventfd of a queue
+ * @param a: the queue
+ * @return: the fd, which is readable when there're completions to reap
+ *
+ * The fd is non-blocking, add it to a poll(), select() or epoll loop and call easy_uci_async_reap() when it's readable
+ */
+int easy_uci_async_fd(easy_uci_async* a);
+
+/**
+ * easy_uci_async_submit: queue a request
+ * @param a: the queue
+ * @param ops: the changes of the request, all on the same package
+ * @param count: the number of changes, a request of more than one change is run as a transaction
+ * @return: the id of the request, which is positive, -1 for failure
+ *
+ * ops is copied, so it can be freed as soon as this function returns
+ * Nothing is written by this function, the request is run by a worker which reports it through easy_uci_async_fd()
+ * While the background writer runs, requests go through its session like the setters do, and complete when they've
+ * been made to that session
+ */
+long long easy_uci_async_submit(easy_uci_async* a,const easy_uci_op* ops,size_t count);
+
+/**
+ * easy_uci_async_reap: get the completions of the requests that have run
+ * @param a: the queue
+ * @param completions: the array the completions will be stored in, in the order the requests completed
+ * @param max: the number of elements of completions
+ * @return: the number of completions stored, 0 if there's none
+ *
+ * Never blocks, the fd stays readable while completions are left
+ */
+size_t easy_uci_async_reap(easy_uci_async* a,easy_uci_completion* completions,size_t max);
+
+/**
+ * easy_uci_stage_enable: stage writes as deltas instead of writing the config files
+ * @param enable: true to stage writes, false to write each change to the config file
+ * @return: no return
+ *
+ * A staged change is saved by uci_save() to a delta file in the savedir, which is small and only appended to
+ * The config file is left untouched until the package is flushed by easy_uci_flush()
+ * Reads, including those of other processes using libuci, see the staged values
+ * Sessions take this setting when they're opened, easy_uci_session_stage_enable() changes it for one session
+ */
+void easy_uci_stage_enable(bool enable);
+void easy_uci_session_stage_enable(easy_uci_session* s,bool enable);
+
+/**
+ * easy_uci_flush: write the staged changes of a package to its config file
+ * @param package: the name of the package
+ * @return: 0 for success, -1 for failure
+ *
+ * The delta file of the package is folded into the config file and removed
+ * In a transaction, the package is flushed when the transaction is committed
+ * While the background writer runs, easy_uci_flush() leaves it to the writer, see easy_uci_writer_sync()
+ */
+int easy_uci_flush(const char* package);
+int easy_uci_session_flush(easy_uci_session* s,const char* package);
+
 /**
  * easy_uci_free_list: free an easy_uci_list filled by some easy_uci functions
  * @param list_p: the pointer to the easy_uci_list to free
  * @return: no return
+ *
+ * Lists filled by easy_uci functions are packed: the pointer array and all the strings are allocated as one block
+ * A packed list is released with a single free()
+ * A list is packed when its first string starts right after the pointer array, which separate allocations never do
+ * Any other list, e.g. one built by the caller, has each string and the array freed separately
  */
 void easy_uci_free_list(easy_uci_list* list_p);
 
+/**
+ * easy_uci_free_section: free an easy_uci_section got by easy_uci_get_section()
+ * @param section: the section, can be NULL
+ * @return: no return
+ *
+ * Everything the section points to is released along with it
+ */
+void easy_uci_free_section(easy_uci_section* section);
+
 /**
  * easy_uci_get_section_type: get the type of a section
  * @param package: the name of the package
@@ -30,8 +590,24 @@ void easy_uci_free_list(easy_uci_list* list_p);
  * @param buff: the type of the section will be stored in it with '\0' term
  * @param size: the maximum size of buff
  * @return: 0 for success, -1 for failure
+ *
+ * A type longer than size-1 is truncated, buff is always '\0' terminated when size is not 0
  */
 int easy_uci_get_section_type(const char* package,const char* section,char* buff,size_t size);
+int easy_uci_session_get_section_type(easy_uci_session* s,const char* package,const char* section,char* buff,size_t size);
+
+/**
+ * easy_uci_get_section: get the type and all the options of a section in one call
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param section_p: the pointer to an easy_uci_section* for output
+ * @return: 0 for success, -1 for failure
+ *
+ * The section is allocated as one block and must be freed by easy_uci_free_section()
+ * If the section can't be found, this function fails and *section_p will not be changed
+ */
+int easy_uci_get_section(const char* package,const char* section,easy_uci_section** section_p);
+int easy_uci_session_get_section(easy_uci_session* s,const char* package,const char* section,easy_uci_section** section_p);
 
 /**
  * easy_uci_add_section: add a new section to package
@@ -44,6 +620,7 @@ int easy_uci_get_section_type(const char* package,const char* section,char* buff
  * If a section with the same name and a different type already exists, this function will fail
  */
 int easy_uci_add_section(const char* package,const char* type,const char* name);
+int easy_uci_session_add_section(easy_uci_session* s,const char* package,const char* type,const char* name);
 
 /**
  * easy_uci_delete_section: delete a section from package
@@ -54,6 +631,7 @@ int easy_uci_add_section(const char* package,const char* type,const char* name);
  * When deleting a section that doesn't exist, this function will succeed
  */
 int easy_uci_delete_section(const char* package,const char* section);
+int easy_uci_session_delete_section(easy_uci_session* s,const char* package,const char* section);
 
 /**
  * easy_uci_get_all_section_of_type: get all sections of type from package
@@ -67,11 +645,12 @@ int easy_uci_delete_section(const char* package,const char* section);
  * If there is no section of type, the list_p->len will be set to 0 list_p->list set to NULL
  * If this function fails, the content of *list_p will not be changed
  * If this function succeeds, *list_p must be freed by easy_uci_free_list()
- * This function will BREAK when there're more then 1024 sections of the type
+ * There's no limit on the number of sections of the type
  *
  * For anonymous sections, this function will return a internal name that can be used by other easy_uci functions
  */
 int easy_uci_get_all_section_of_type(const char* package,const char* type,easy_uci_list* list_p);
+int easy_uci_session_get_all_section_of_type(easy_uci_session* s,const char* package,const char* type,easy_uci_list* list_p);
 
 /**
  * easy_uci_get_nth_section_of_type: get the nth section of type from package
@@ -89,6 +668,72 @@ int easy_uci_get_all_section_of_type(const char* package,const char* type,easy_u
  * For anonymous sections, this function will return a internal name that can be used by other easy_uci functions
  */
 int easy_uci_get_nth_section_of_type(const char* package,const char* type,int n,char** name_p);
+int easy_uci_session_get_nth_section_of_type(easy_uci_session* s,const char* package,const char* type,int n,char** name_p);
+
+/**
+ * easy_uci_get_section_count_of_type: get the number of sections of type in package
+ * @param package: the name of the package
+ * @param type: the type of the sections
+ * @param count_p: the pointer to a size_t that will be set to the number of sections
+ * @return: 0 for success, -1 for failure
+ *
+ * If there is no section of type, *count_p will be set to 0
+ * If this function fails, *count_p will not be changed
+ */
+int easy_uci_get_section_count_of_type(const char* package,const char* type,size_t* count_p);
+int easy_uci_session_get_section_count_of_type(easy_uci_session* s,const char* package,const char* type,size_t* count_p);
+
+/*
+ * How an easy_uci_predicate compares the value of its option
+ */
+enum
+{
+    EASY_UCI_MATCH_EQUAL,
+    //The value starts with the value of the predicate
+    EASY_UCI_MATCH_PREFIX,
+};
+
+/*
+ * A condition on an option of a section, see easy_uci_find_sections()
+ * A list option matches if any of its values matches, a missing option never matches
+ */
+typedef struct
+{
+    const char* option;
+    int match;
+    const char* value;
+} easy_uci_predicate;
+
+/**
+ * easy_uci_find_sections: get the names of the sections of type matching all predicates
+ * @param package: the name of the package
+ * @param type: the type of the sections, NULL for any type
+ * @param preds: the predicates, can be NULL if count is 0
+ * @param count: the number of predicates, 0 to get all sections of type
+ * @param list_p: the pointer to an easy_uci_list the names will be stored in, in file order, see easy_uci_free_list()
+ * @return: 0 for success, -1 for failure
+ *
+ * The package is loaded once for the whole query, finding no section succeeds with an empty list
+ * An equality predicate on an option indexed by easy_uci_session_index_option() is answered from the index
+ * If this function fails, *list_p will not be changed
+ */
+int easy_uci_find_sections(const char* package,const char* type,const easy_uci_predicate* preds,size_t count,easy_uci_list* list_p);
+int easy_uci_session_find_sections(easy_uci_session* s,const char* package,const char* type,const easy_uci_predicate* preds,size_t count,easy_uci_list* list_p);
+
+/**
+ * easy_uci_session_index_option: index the sections of type in package by the values of option
+ * @param s: the session
+ * @param package: the name of the package
+ * @param type: the type of the sections
+ * @param option: the name of the option
+ * @return: 0 for success, -1 for failure
+ *
+ * Equality queries on the option then take O(1) instead of a scan of the sections of type
+ * The index is built by the first query using it and dropped by any change to the package, which builds it again on
+ * the next query, so it pays off for packages queried much more often than changed
+ * The index is kept until the session is closed, indexing an option twice does nothing
+ */
+int easy_uci_session_index_option(easy_uci_session* s,const char* package,const char* type,const char* option);
 
 /**
  * easy_uci_get_option_string: get the value of an option of type string
@@ -100,8 +745,10 @@ int easy_uci_get_nth_section_of_type(const char* package,const char* type,int n,
  * @return: 0 for success, -1 for failure
  *
  * If the opption can't be found, this function fails and the content of buff will not be changed
+ * A value longer than size-1 is truncated, buff is always '\0' terminated when size is not 0
  */
 int easy_uci_get_option_string(const char* package,const char* section,const char* option,char* buff,size_t size);
+int easy_uci_session_get_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,char* buff,size_t size);
 
 /**
  * easy_uci_set_option_string: set the value of an option of type string
@@ -116,6 +763,7 @@ int easy_uci_get_option_string(const char* package,const char* section,const cha
  * If the value is NULL or "", this function will fail
  */
 int easy_uci_set_option_string(const char* package,const char* section,const char* option,const char* value);
+int easy_uci_session_set_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value);
 
 /**
  * easy_uci_get_option_list: get the list of an option of type list
@@ -128,6 +776,7 @@ int easy_uci_set_option_string(const char* package,const char* section,const cha
  * If the opption can't be found, this function fails and the content of *list_p will not be changed
  */
 int easy_uci_get_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p);
+int easy_uci_session_get_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p);
 
 /**
  * easy_uci_set_option_list: set the value of an option of type list
@@ -143,6 +792,7 @@ int easy_uci_get_option_list(const char* package,const char* section,const char*
  * This function will not modify the content of *list_p
  */
 int easy_uci_set_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p);
+int easy_uci_session_set_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p);
 
 /**
  * easy_uci_append_to_option_list: append value to an option of type list
@@ -157,6 +807,7 @@ int easy_uci_set_option_list(const char* package,const char* section,const char*
  * If the value is NULL, this function will fail
  */
 int easy_uci_append_to_option_list(const char* package,const char* section,const char* option,const char* value);
+int easy_uci_session_append_to_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value);
 
 /**
  * easy_uci_delete_option: delete an option from section
@@ -167,5 +818,375 @@ int easy_uci_append_to_option_list(const char* package,const char* section,const
  * If the option doesn't exist, this function will succeed
  */
 int easy_uci_delete_option(const char* package,const char* section,const char* option);
+int easy_uci_session_delete_option(easy_uci_session* s,const char* package,const char* section,const char* option);
+
+/**
+ * easy_uci_get_batch: get the options of many "package.section.option" paths in one call
+ * @param paths: the paths, the section of a path can be given as @type[n]
+ * @param count: the number of paths
+ * @param results_p: the pointer to an easy_uci_result* for output
+ * @return: 0 for success, -1 for failure
+ *
+ * Paths are grouped by package and each package is loaded once
+ * On success *results_p points to count results in the order of paths, check the status of each one
+ * The results are allocated as one block and must be freed by easy_uci_free_results()
+ */
+int easy_uci_get_batch(const char* const* paths,size_t count,easy_uci_result** results_p);
+int easy_uci_session_get_batch(easy_uci_session* s,const char* const* paths,size_t count,easy_uci_result** results_p);
+
+/**
+ * easy_uci_free_results: free the results got by easy_uci_get_batch()
+ * @param results: the results, can be NULL
+ * @return: no return
+ */
+void easy_uci_free_results(easy_uci_result* results);
+
+/*
+ * Return codes of the typed getters below
+ */
+#define EASY_UCI_OK 0
+//The option or its section doesn't exist, the default value was stored
+#define EASY_UCI_DEFAULT 1
+//The package can't be loaded
+#define EASY_UCI_ERROR -1
+//The option is a list or its value can't be parsed as the type asked for, the output was not changed
+#define EASY_UCI_MALFORMED -2
+//Returned by the conditional setters: the package has changed since the version expected
+#define EASY_UCI_CONFLICT -3
+
+/*
+ * An IP address parsed by easy_uci_get_option_ipaddr()
+ */
+typedef struct
+{
+    //AF_INET or AF_INET6
+    int family;
+    //In network byte order, only the first 4 bytes are used for AF_INET
+    unsigned char addr[16];
+    //The prefix length given after a '/' either as a number or an IPv4 netmask, -1 if there's none
+    int prefix;
+} easy_uci_ipaddr;
+
+/**
+ * easy_uci_get_option_int: get the value of an option of type string as a signed integer
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param def: the value stored if the option doesn't exist
+ * @param value_p: the pointer to a long the value will be stored in
+ * @return: EASY_UCI_OK, EASY_UCI_DEFAULT, EASY_UCI_ERROR or EASY_UCI_MALFORMED
+ *
+ * The value is parsed like strtol() with base 0, so hex and octal forms are accepted
+ * The whole value must be a number in the range of long
+ */
+int easy_uci_get_option_int(const char* package,const char* section,const char* option,long def,long* value_p);
+int easy_uci_session_get_option_int(easy_uci_session* s,const char* package,const char* section,const char* option,long def,long* value_p);
+
+/**
+ * easy_uci_get_option_uint: get the value of an option of type string as an unsigned integer
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param def: the value stored if the option doesn't exist
+ * @param value_p: the pointer to an unsigned long the value will be stored in
+ * @return: EASY_UCI_OK, EASY_UCI_DEFAULT, EASY_UCI_ERROR or EASY_UCI_MALFORMED
+ *
+ * Same as easy_uci_get_option_int() except that negative values are malformed
+ */
+int easy_uci_get_option_uint(const char* package,const char* section,const char* option,unsigned long def,unsigned long* value_p);
+int easy_uci_session_get_option_uint(easy_uci_session* s,const char* package,const char* section,const char* option,unsigned long def,unsigned long* value_p);
+
+/**
+ * easy_uci_get_option_bool: get the value of an option of type string as a boolean
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param def: the value stored if the option doesn't exist
+ * @param value_p: the pointer to a bool the value will be stored in
+ * @return: EASY_UCI_OK, EASY_UCI_DEFAULT, EASY_UCI_ERROR or EASY_UCI_MALFORMED
+ *
+ * "1", "yes", "on", "true" and "enabled" are true, "0", "no", "off", "false" and "disabled" are false
+ * The words are matched case-insensitively, anything else is malformed
+ */
+int easy_uci_get_option_bool(const char* package,const char* section,const char* option,bool def,bool* value_p);
+int easy_uci_session_get_option_bool(easy_uci_session* s,const char* package,const char* section,const char* option,bool def,bool* value_p);
+
+/**
+ * easy_uci_get_option_double: get the value of an option of type string as a floating point number
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param def: the value stored if the option doesn't exist
+ * @param value_p: the pointer to a double the value will be stored in
+ * @return: EASY_UCI_OK, EASY_UCI_DEFAULT, EASY_UCI_ERROR or EASY_UCI_MALFORMED
+ *
+ * The value is parsed like strtod(), the whole value must be a number in the range of double
+ */
+int easy_uci_get_option_double(const char* package,const char* section,const char* option,double def,double* value_p);
+int easy_uci_session_get_option_double(easy_uci_session* s,const char* package,const char* section,const char* option,double def,double* value_p);
+
+/**
+ * easy_uci_get_option_ipaddr: get the value of an option of type string as an IPv4 or IPv6 address
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param def: the value stored if the option doesn't exist, NULL to leave *value_p unchanged
+ * @param value_p: the pointer to an easy_uci_ipaddr the value will be stored in
+ * @return: EASY_UCI_OK, EASY_UCI_DEFAULT, EASY_UCI_ERROR or EASY_UCI_MALFORMED
+ *
+ * The address can be followed by '/' and a prefix length, or an IPv4 netmask for IPv4 addresses
+ */
+int easy_uci_get_option_ipaddr(const char* package,const char* section,const char* option,const easy_uci_ipaddr* def,easy_uci_ipaddr* value_p);
+int easy_uci_session_get_option_ipaddr(easy_uci_session* s,const char* package,const char* section,const char* option,const easy_uci_ipaddr* def,easy_uci_ipaddr* value_p);
+
+/**
+ * easy_uci_get_version: get the version of a package
+ * @param package: the name of the package
+ * @param version_p: the pointer to an easy_uci_version for output
+ * @return: 0 for success, -1 for failure
+ *
+ * The version is a hash of the inode, size and mtime of the config file and of its delta file
+ * It changes whenever either file is written
+ * In a session, this is the version of the package as loaded in the session, or as on disk if it's not loaded yet
+ */
+int easy_uci_get_version(const char* package,easy_uci_version* version_p);
+int easy_uci_session_get_version(easy_uci_session* s,const char* package,easy_uci_version* version_p);
+
+/**
+ * easy_uci_xxx_if_version: the setters above, only writing if the package is still at a version
+ * @param version_p: the pointer to the version expected, the version written is stored back on success
+ * @return: 0 for success, EASY_UCI_CONFLICT if the package has changed since the version expected, -1 for other failures
+ *
+ * The other parameters are those of the setters
+ * No lock is held between reading a package and writing it, a conflict is found when the change is written
+ * On conflict nothing is written, the package is unloaded from the session and *version_p is set to the current version
+ * Read the package again and retry
+ * Writes of easy_uci to a package are serialized by a lock file in the savedir, so checking and writing are atomic
+ * Other writers of the config files, like the uci command, don't take that lock
+ * In a transaction, the version is checked when the transaction is committed, which returns EASY_UCI_CONFLICT
+ * While the background writer runs, conditional writes are committed right away, after the changes queued for it
+ * Those changes make a version read while they were queued conflict
+ */
+int easy_uci_add_section_if_version(const char* package,const char* type,const char* name,easy_uci_version* version_p);
+int easy_uci_session_add_section_if_version(easy_uci_session* s,const char* package,const char* type,const char* name,easy_uci_version* version_p);
+int easy_uci_delete_section_if_version(const char* package,const char* section,easy_uci_version* version_p);
+int easy_uci_session_delete_section_if_version(easy_uci_session* s,const char* package,const char* section,easy_uci_version* version_p);
+int easy_uci_set_option_string_if_version(const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p);
+int easy_uci_session_set_option_string_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p);
+int easy_uci_set_option_list_if_version(const char* package,const char* section,const char* option,easy_uci_list* list_p,easy_uci_version* version_p);
+int easy_uci_session_set_option_list_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p,easy_uci_version* version_p);
+int easy_uci_append_to_option_list_if_version(const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p);
+int easy_uci_session_append_to_option_list_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p);
+int easy_uci_delete_option_if_version(const char* package,const char* section,const char* option,easy_uci_version* version_p);
+int easy_uci_session_delete_option_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_version* version_p);
+
+/*
+ * The view functions below return strings borrowed from the package loaded in the session, without allocation or copy
+ * A view points into the memory of the package and is '\0' terminated at str[len]
+ * A view of a package stays valid until any of the following happens, after which it must not be used:
+ *  - a setter of the session is called on the same package, whether it succeeds or not
+ *  - a transaction including the package is committed or rolled back
+ *  - the package is unloaded from the session or the session is closed
+ * Views must never be written to or freed
+ */
+
+/**
+ * easy_uci_session_view_section_type: view the type of a section
+ * @param s: the session
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param view_p: the pointer to an easy_uci_view that will be set to the type
+ * @return: 0 for success, -1 for failure
+ *
+ * If this function fails, *view_p will not be changed
+ */
+int easy_uci_session_view_section_type(easy_uci_session* s,const char* package,const char* section,easy_uci_view* view_p);
+
+/**
+ * easy_uci_session_view_nth_section_of_type: view the name of the nth section of type
+ * @param s: the session
+ * @param package: the name of the package
+ * @param type: the type of the sections
+ * @param n: the index of the section, negative to count from the last one like easy_uci_get_nth_section_of_type()
+ * @param view_p: the pointer to an easy_uci_view that will be set to the name
+ * @return: 0 for success, -1 for failure
+ *
+ * If this function fails, *view_p will not be changed
+ */
+int easy_uci_session_view_nth_section_of_type(easy_uci_session* s,const char* package,const char* type,int n,easy_uci_view* view_p);
+
+/**
+ * easy_uci_session_view_all_section_of_type: view the names of all sections of type
+ * @param s: the session
+ * @param package: the name of the package
+ * @param type: the type of the sections
+ * @param views: the array the names will be stored in, can be NULL if max is 0
+ * @param max: the number of elements of views
+ * @param count_p: the pointer to a size_t that will be set to the number of sections of type
+ * @return: 0 for success, -1 for failure
+ *
+ * At most max names are stored, if *count_p is greater than max the rest can be got with a larger array
+ */
+int easy_uci_session_view_all_section_of_type(easy_uci_session* s,const char* package,const char* type,easy_uci_view* views,size_t max,size_t* count_p);
+
+/**
+ * easy_uci_session_view_option_string: view the value of an option of type string
+ * @param s: the session
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param view_p: the pointer to an easy_uci_view that will be set to the value
+ * @return: 0 for success, -1 for failure
+ *
+ * If the option can't be found or is not a string, this function fails and *view_p will not be changed
+ */
+int easy_uci_session_view_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* view_p);
+
+/**
+ * easy_uci_session_view_option_list: view the values of an option of type list
+ * @param s: the session
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param views: the array the values will be stored in, can be NULL if max is 0
+ * @param max: the number of elements of views
+ * @param count_p: the pointer to a size_t that will be set to the number of values in the list
+ * @return: 0 for success, -1 for failure
+ *
+ * At most max values are stored, if *count_p is greater than max the rest can be got with a larger array
+ * If the option can't be found or is not a list, this function fails and nothing will be changed
+ */
+int easy_uci_session_view_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* views,size_t max,size_t* count_p);
+
+/*
+ * The try getters below are for probing names that may not exist: they never log, and a miss costs no formatting
+ * and no allocation
+ * Each failure returns its own code and is kept as the last error of the calling thread, see easy_uci_last_error()
+ */
+//The package doesn't exist
+#define EASY_UCI_ENOPACKAGE -10
+//The section doesn't exist
+#define EASY_UCI_ENOSECTION -11
+//The option doesn't exist
+#define EASY_UCI_ENOOPTION -12
+//The option is a list where a string is asked for, or the other way around
+#define EASY_UCI_EWRONGTYPE -13
+//The value didn't fit in the buffer, which holds as much of it as fits
+#define EASY_UCI_ETRUNC -14
+//The package exists but can't be loaded
+#define EASY_UCI_ELOAD -15
+//Out of memory
+#define EASY_UCI_ENOMEM -16
+
+/**
+ * easy_uci_last_error: get the last failure of a try getter in the calling thread
+ * @param buff: the buffer the message will be written to, can be NULL to only get the code
+ * @param size: the size of buff
+ * @return: the code of the failure, 0 if no try getter has failed in the thread
+ *
+ * The message is only formatted by this function, names longer than 63 chars are cut in it
+ * A try getter that succeeds leaves the last error as it is
+ */
+int easy_uci_last_error(char* buff,size_t size);
+
+/**
+ * easy_uci_try_get_section_type: get the type of a section
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param buff: the buffer the type will be stored in, always '\0' terminated unless size is 0
+ * @param size: the size of buff
+ * @return: 0, EASY_UCI_ENOPACKAGE, EASY_UCI_ELOAD, EASY_UCI_ENOSECTION, EASY_UCI_ETRUNC or EASY_UCI_ENOMEM
+ */
+int easy_uci_try_get_section_type(const char* package,const char* section,char* buff,size_t size);
+int easy_uci_session_try_get_section_type(easy_uci_session* s,const char* package,const char* section,char* buff,size_t size);
+
+/**
+ * easy_uci_try_get_option_string: get the value of an option of type string
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param buff: the buffer the value will be stored in, always '\0' terminated unless size is 0
+ * @param size: the size of buff
+ * @return: 0, EASY_UCI_ENOPACKAGE, EASY_UCI_ELOAD, EASY_UCI_ENOSECTION, EASY_UCI_ENOOPTION, EASY_UCI_EWRONGTYPE,
+ *          EASY_UCI_ETRUNC or EASY_UCI_ENOMEM
+ *
+ * buff is only changed on success or EASY_UCI_ETRUNC
+ */
+int easy_uci_try_get_option_string(const char* package,const char* section,const char* option,char* buff,size_t size);
+int easy_uci_session_try_get_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,char* buff,size_t size);
+
+/**
+ * easy_uci_try_get_option_list: get the values of an option of type list
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param list_p: the pointer to an easy_uci_list the values will be stored in, see easy_uci_free_list()
+ * @return: 0, EASY_UCI_ENOPACKAGE, EASY_UCI_ELOAD, EASY_UCI_ENOSECTION, EASY_UCI_ENOOPTION, EASY_UCI_EWRONGTYPE
+ *          or EASY_UCI_ENOMEM
+ *
+ * *list_p is only changed on success
+ */
+int easy_uci_try_get_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p);
+int easy_uci_session_try_get_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p);
+
+/**
+ * easy_uci_session_try_view_option_string: view the value of an option of type string
+ * @param s: the session
+ * @param package: the name of the package
+ * @param section: the name of the section
+ * @param option: the name of the option
+ * @param view_p: the pointer to an easy_uci_view that will be set to the value
+ * @return: 0, EASY_UCI_ENOPACKAGE, EASY_UCI_ELOAD, EASY_UCI_ENOSECTION, EASY_UCI_ENOOPTION or EASY_UCI_EWRONGTYPE
+ *
+ * Same as easy_uci_session_view_option_string(), *view_p is only changed on success
+ */
+int easy_uci_session_try_view_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* view_p);
+
+/**
+ * easy_uci_export_json: write a package to fd as a JSON document
+ * @param package: the name of the package
+ * @param fd: the file descriptor to write to
+ * @return: 0 for success, -1 for failure
+ *
+ * The document is an object of the sections in file order, each an object of its options with the keys ".type" and
+ * ".anonymous", a list option is an array of strings:
+ * {"lan":{".type":"interface",".anonymous":false,"proto":"static","dns":["1.1.1.1","8.8.8.8"]}}
+ * The document is streamed through a fixed buffer, exporting a large package doesn't allocate the whole of it
+ * On failure part of the document may have been written
+ */
+int easy_uci_export_json(const char* package,int fd);
+int easy_uci_session_export_json(easy_uci_session* s,const char* package,int fd);
+
+/*
+ * The modes of easy_uci_import_json()
+ */
+enum
+{
+    //Change and add the sections and options in the document, leave the others alone
+    EASY_UCI_IMPORT_MERGE,
+    //Also delete the sections not in the document and the options not in their section
+    EASY_UCI_IMPORT_REPLACE,
+};
+
+/**
+ * easy_uci_import_json: apply a JSON document read from fd to a package
+ * @param package: the name of the package
+ * @param fd: the file descriptor to read from, read until the end of the document
+ * @param mode: EASY_UCI_IMPORT_MERGE or EASY_UCI_IMPORT_REPLACE
+ * @return: 0 for success, -1 for failure
+ *
+ * The document is in the format of easy_uci_export_json(), the output of the uci ubus object is accepted too as
+ * other keys starting with '.' are ignored
+ * A section missing ".type" must already exist, a section of another type is replaced by a new one
+ * An anonymous section that doesn't exist under its name is added as a new anonymous section
+ * A null value or an empty array deletes the option, numbers are kept as written, true and false become "1" and "0"
+ * Values that are already set are left alone, importing a document of an unchanged package writes nothing
+ *
+ * The document is applied as one transaction committed once, if it is malformed or any change fails nothing is
+ * changed. The document is parsed while it is applied, only one section of it is held in memory at a time
+ * In a transaction, the changes are part of it and committed along with it
+ */
+int easy_uci_import_json(const char* package,int fd,int mode);
+int easy_uci_session_import_json(easy_uci_session* s,const char* package,int fd,int mode);
 
 #endif /* _EASY_UCI_H_ */
@@ -0,0 +1,531 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define ASYNC_DEFAULT_WORKERS 2
+
+/*
+ * A submitted request, ops and all their strings are copied into the same block
+ */
+struct eu_async_req
+{
+    long long id;
+    int result;
+    const char* package;
+    easy_uci_op* ops;
+    size_t count;
+    struct eu_async_req* next;
+};
+
+/*
+ * The requests of one package in the order they were submitted
+ * A lane is scheduled while it's in the ready list or run by a worker, so only one worker runs it at a time
+ */
+struct eu_async_lane
+{
+    char* package;
+    struct eu_async_req* head;
+    struct eu_async_req* tail;
+    bool scheduled;
+    struct eu_async_lane* next;
+    struct eu_async_lane* next_ready;
+};
+
+/*
+ * All members below threads are guarded by lock
+ */
+struct easy_uci_async
+{
+    int fd;
+    pthread_t* threads;
+    unsigned int n_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+    long long last_id;
+    //Lanes are kept until the queue is closed, there's one per package written
+    struct eu_async_lane* lanes;
+    struct eu_async_lane* ready_head;
+    struct eu_async_lane* ready_tail;
+    struct eu_async_req* done_head;
+    struct eu_async_req* done_tail;
+};
+
+static int __run_op(easy_uci_session* s,const easy_uci_op* op)
+{
+    easy_uci_list list;
+
+    switch(op->type)
+    {
+    case EASY_UCI_OP_SET_OPTION_STRING:
+        return easy_uci_session_set_option_string(s,op->package,op->section,op->option,op->value);
+    case EASY_UCI_OP_SET_OPTION_LIST:
+        list.list=(const char**)op->list;
+        list.len=op->list_len;
+        return easy_uci_session_set_option_list(s,op->package,op->section,op->option,&list);
+    case EASY_UCI_OP_APPEND_TO_OPTION_LIST:
+        return easy_uci_session_append_to_option_list(s,op->package,op->section,op->option,op->value);
+    case EASY_UCI_OP_DELETE_OPTION:
+        return easy_uci_session_delete_option(s,op->package,op->section,op->option);
+    case EASY_UCI_OP_ADD_SECTION:
+        return easy_uci_session_add_section(s,op->package,op->value,op->section);
+    case EASY_UCI_OP_DELETE_SECTION:
+        return easy_uci_session_delete_section(s,op->package,op->section);
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Run a request the way the setters not taking a session do
+ * Return 0 for success, -1 for failure
+ */
+static int __run(struct eu_async_req* r)
+{
+    int ret=0;
+    size_t i;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(r->package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    if(r->count==1)
+    {
+        ret=__run_op(s,&r->ops[0]);
+        __eu_write_session_close(s);
+        return ret;
+    }
+
+    //The rollback of a failed transaction drops every dirty package, including those queued for the writer
+    if(s->deferred)
+    {
+        __eu_writer_commit();
+    }
+
+    easy_uci_session_begin(s);
+    for(i=0;i<r->count&&ret==0;++i)
+    {
+        ret=__run_op(s,&r->ops[i]);
+    }
+
+    if(ret==0)
+    {
+        ret=easy_uci_session_commit(s);
+    }
+    else
+    {
+        easy_uci_session_rollback(s);
+    }
+
+    __eu_write_session_close(s);
+
+    return ret==0?0:-1;
+}
+
+static void* __worker_main(void* arg)
+{
+    uint64_t one=1;
+    easy_uci_async* a=arg;
+    struct eu_async_lane* l;
+    struct eu_async_req* r;
+
+    pthread_mutex_lock(&a->lock);
+
+    while(true)
+    {
+        while(a->ready_head==NULL&&!a->stop)
+        {
+            pthread_cond_wait(&a->wake,&a->lock);
+        }
+
+        //Stopping only after the ready list is empty runs all requests left
+        if(a->ready_head==NULL)
+        {
+            break;
+        }
+
+        l=a->ready_head;
+        a->ready_head=l->next_ready;
+        if(a->ready_head==NULL)
+        {
+            a->ready_tail=NULL;
+        }
+        r=l->head;
+
+        pthread_mutex_unlock(&a->lock);
+        r->result=__run(r);
+        pthread_mutex_lock(&a->lock);
+
+        l->head=r->next;
+        if(l->head==NULL)
+        {
+            l->tail=NULL;
+            l->scheduled=false;
+        }
+        else
+        {
+            //Back to the end of the ready list, so a busy package doesn't starve the others
+            l->next_ready=NULL;
+            if(a->ready_tail==NULL)
+            {
+                a->ready_head=l;
+            }
+            else
+            {
+                a->ready_tail->next_ready=l;
+            }
+            a->ready_tail=l;
+            pthread_cond_signal(&a->wake);
+        }
+
+        r->next=NULL;
+        if(a->done_tail==NULL)
+        {
+            a->done_head=r;
+        }
+        else
+        {
+            a->done_tail->next=r;
+        }
+        a->done_tail=r;
+
+        if(write(a->fd,&one,sizeof(one))!=sizeof(one))
+        {
+            LogE("Failed to signal the eventfd");
+        }
+    }
+
+    pthread_mutex_unlock(&a->lock);
+
+    return NULL;
+}
+
+easy_uci_async* easy_uci_async_open(unsigned int workers)
+{
+    unsigned int i;
+    easy_uci_async* a;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    if(workers==0)
+    {
+        workers=ASYNC_DEFAULT_WORKERS;
+    }
+
+    a=calloc(1,sizeof(easy_uci_async));
+    if(a==NULL)
+    {
+        LogE("Failed to alloc async queue");
+        return NULL;
+    }
+
+    a->threads=calloc(workers,sizeof(pthread_t));
+    if(a->threads==NULL)
+    {
+        free(a);
+        LogE("Failed to alloc async queue");
+        return NULL;
+    }
+
+    a->fd=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+    if(a->fd<0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to create eventfd: %s",strerror(errno));
+        LogE(err_msg);
+        free(a->threads);
+        free(a);
+        return NULL;
+    }
+
+    pthread_mutex_init(&a->lock,NULL);
+    pthread_cond_init(&a->wake,NULL);
+
+    for(i=0;i<workers;++i)
+    {
+        if(pthread_create(&a->threads[i],NULL,__worker_main,a)!=0)
+        {
+            LogE("Failed to start async worker");
+            break;
+        }
+        ++a->n_threads;
+    }
+
+    if(a->n_threads==0)
+    {
+        easy_uci_async_close(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+void easy_uci_async_close(easy_uci_async* a)
+{
+    unsigned int i;
+    struct eu_async_lane* l;
+    struct eu_async_req* r;
+
+    if(a==NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    a->stop=true;
+    pthread_cond_broadcast(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+
+    for(i=0;i<a->n_threads;++i)
+    {
+        pthread_join(a->threads[i],NULL);
+    }
+
+    while(a->done_head!=NULL)
+    {
+        r=a->done_head;
+        a->done_head=r->next;
+        free(r);
+    }
+
+    while(a->lanes!=NULL)
+    {
+        l=a->lanes;
+        a->lanes=l->next;
+        free(l->package);
+        free(l);
+    }
+
+    pthread_cond_destroy(&a->wake);
+    pthread_mutex_destroy(&a->lock);
+    close(a->fd);
+    free(a->threads);
+    free(a);
+}
+
+int easy_uci_async_fd(easy_uci_async* a)
+{
+    return a->fd;
+}
+
+/*
+ * Copy a request into one block: the request, the ops, the list arrays, then the strings
+ * Return NULL if the request is malformed or for failure
+ */
+static struct eu_async_req* __copy_req(const easy_uci_op* ops,size_t count)
+{
+    size_t i,j;
+    size_t values=0;
+    size_t bytes=0;
+    struct eu_async_req* r;
+    const char** list;
+    char* buff;
+    const char* strs[4];
+    const char** dst[4];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    if(count==0)
+    {
+        LogE("A request needs at least one op");
+        return NULL;
+    }
+
+    for(i=0;i<count;++i)
+    {
+        if(ops[i].package==NULL||strcmp(ops[i].package,ops[0].package)!=0)
+        {
+            snprintf(err_msg,sizeof(err_msg),"All ops of a request must be on package: '%s'",
+                ops[0].package==NULL?"":ops[0].package);
+            LogE(err_msg);
+            return NULL;
+        }
+
+        bytes+=strlen(ops[i].package)+1;
+        bytes+=ops[i].section==NULL?0:strlen(ops[i].section)+1;
+        bytes+=ops[i].option==NULL?0:strlen(ops[i].option)+1;
+        bytes+=ops[i].value==NULL?0:strlen(ops[i].value)+1;
+        if(ops[i].type==EASY_UCI_OP_SET_OPTION_LIST)
+        {
+            values+=ops[i].list_len;
+            for(j=0;j<ops[i].list_len;++j)
+            {
+                bytes+=strlen(ops[i].list[j])+1;
+            }
+        }
+    }
+
+    r=malloc(sizeof(struct eu_async_req)+sizeof(easy_uci_op)*count+sizeof(char*)*values+bytes);
+    if(r==NULL)
+    {
+        LogE("Failed to alloc request");
+        return NULL;
+    }
+
+    r->ops=(easy_uci_op*)(r+1);
+    r->count=count;
+    r->next=NULL;
+    list=(const char**)(r->ops+count);
+    buff=(char*)(list+values);
+
+    for(i=0;i<count;++i)
+    {
+        r->ops[i]=ops[i];
+        strs[0]=ops[i].package;
+        strs[1]=ops[i].section;
+        strs[2]=ops[i].option;
+        strs[3]=ops[i].value;
+        dst[0]=&r->ops[i].package;
+        dst[1]=&r->ops[i].section;
+        dst[2]=&r->ops[i].option;
+        dst[3]=&r->ops[i].value;
+        for(j=0;j<4;++j)
+        {
+            if(strs[j]!=NULL)
+            {
+                *dst[j]=buff;
+                buff=stpcpy(buff,strs[j])+1;
+            }
+        }
+
+        if(ops[i].type==EASY_UCI_OP_SET_OPTION_LIST)
+        {
+            r->ops[i].list=list;
+            for(j=0;j<ops[i].list_len;++j)
+            {
+                list[j]=buff;
+                buff=stpcpy(buff,ops[i].list[j])+1;
+            }
+            list+=ops[i].list_len;
+        }
+        else
+        {
+            r->ops[i].list=NULL;
+            r->ops[i].list_len=0;
+        }
+    }
+
+    r->package=r->ops[0].package;
+
+    return r;
+}
+
+long long easy_uci_async_submit(easy_uci_async* a,const easy_uci_op* ops,size_t count)
+{
+    long long id;
+    struct eu_async_req* r;
+    struct eu_async_lane* l;
+
+    r=__copy_req(ops,count);
+    if(r==NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&a->lock);
+
+    for(l=a->lanes;l!=NULL;l=l->next)
+    {
+        if(strcmp(l->package,r->package)==0)
+        {
+            break;
+        }
+    }
+
+    if(l==NULL)
+    {
+        l=calloc(1,sizeof(struct eu_async_lane));
+        if(l==NULL||(l->package=strdup(r->package))==NULL)
+        {
+            pthread_mutex_unlock(&a->lock);
+            free(l);
+            free(r);
+            LogE("Failed to alloc request");
+            return -1;
+        }
+        l->next=a->lanes;
+        a->lanes=l;
+    }
+
+    id=++a->last_id;
+    r->id=id;
+
+    if(l->tail==NULL)
+    {
+        l->head=r;
+    }
+    else
+    {
+        l->tail->next=r;
+    }
+    l->tail=r;
+
+    if(!l->scheduled)
+    {
+        l->scheduled=true;
+        l->next_ready=NULL;
+        if(a->ready_tail==NULL)
+        {
+            a->ready_head=l;
+        }
+        else
+        {
+            a->ready_tail->next_ready=l;
+        }
+        a->ready_tail=l;
+        pthread_cond_signal(&a->wake);
+    }
+
+    pthread_mutex_unlock(&a->lock);
+
+    return id;
+}
+
+size_t easy_uci_async_reap(easy_uci_async* a,easy_uci_completion* completions,size_t max)
+{
+    size_t n=0;
+    uint64_t value;
+    struct eu_async_req* r;
+
+    //Reset the counter first, a completion added meanwhile signals it again
+    if(read(a->fd,&value,sizeof(value))<0&&errno!=EAGAIN)
+    {
+        LogE("Failed to read the eventfd");
+    }
+
+    pthread_mutex_lock(&a->lock);
+
+    while(n<max&&a->done_head!=NULL)
+    {
+        r=a->done_head;
+        a->done_head=r->next;
+        if(a->done_head==NULL)
+        {
+            a->done_tail=NULL;
+        }
+        completions[n].id=r->id;
+        completions[n].result=r->result;
+        ++n;
+        free(r);
+    }
+
+    //Keep the fd readable for what's left
+    value=1;
+    if(a->done_head!=NULL&&write(a->fd,&value,sizeof(value))!=sizeof(value))
+    {
+        LogE("Failed to signal the eventfd");
+    }
+
+    pthread_mutex_unlock(&a->lock);
+
+    return n;
+}
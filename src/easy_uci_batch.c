@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+//Status of a path whose package hasn't been loaded yet
+#define BATCH_PENDING 2
+
+struct eu_batch_entry
+{
+    int status;
+    struct uci_option* opt;
+};
+
+/*
+ * Find the option of a path in the package it names
+ * Return the status of the path
+ */
+static int __resolve(struct eu_package* p,const char* path,size_t pkg_len,struct uci_option** opt_p)
+{
+    const char* section=path+pkg_len+1;
+    const char* option;
+    struct uci_section* sec;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    option=strchr(section,'.');
+    if(option==NULL||option==section||option[1]=='\0')
+    {
+        snprintf(err_msg,sizeof(err_msg),"Malformed path: '%s'",path);
+        LogE(err_msg);
+        return -1;
+    }
+    ++option;
+
+    sec=__eu_index_section_len(p,section,option-section-1);
+    *opt_p=sec==NULL?NULL:__eu_index_option(p,sec,option);
+
+    return *opt_p==NULL?1:0;
+}
+
+int easy_uci_session_get_batch(easy_uci_session* s,const char* const* paths,size_t count,easy_uci_result** results_p)
+{
+    size_t i,j;
+    size_t pkg_len;
+    size_t values=0;
+    size_t bytes=0;
+    struct eu_batch_entry* entries;
+    struct eu_package* p;
+    struct uci_option* opt;
+    struct uci_element* e;
+    easy_uci_result* results;
+    easy_uci_option* o;
+    const char** list;
+    char* package;
+    char* buff;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    entries=malloc(sizeof(struct eu_batch_entry)*(count>0?count:1));
+    if(entries==NULL)
+    {
+        LogE("Failed to alloc batch");
+        return -1;
+    }
+
+    for(i=0;i<count;++i)
+    {
+        entries[i].status=BATCH_PENDING;
+        entries[i].opt=NULL;
+    }
+
+    //Load the package of the first pending path, then resolve all pending paths of that package
+    for(i=0;i<count;++i)
+    {
+        if(entries[i].status!=BATCH_PENDING)
+        {
+            continue;
+        }
+
+        buff=strchr(paths[i],'.');
+        if(buff==NULL||buff==paths[i])
+        {
+            snprintf(err_msg,sizeof(err_msg),"Malformed path: '%s'",paths[i]);
+            LogE(err_msg);
+            entries[i].status=-1;
+            continue;
+        }
+        pkg_len=buff-paths[i];
+
+        package=strndup(paths[i],pkg_len);
+        if(package==NULL)
+        {
+            free(entries);
+            LogE("Failed to alloc batch");
+            return -1;
+        }
+
+        p=__eu_session_load(s,package);
+        if(p==NULL)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+            uci_get_errorstr(s->ctx,&err_str,err_msg);
+            LogE(err_str);
+            free(err_str);
+            err_str=NULL;
+        }
+        free(package);
+
+        for(j=i;j<count;++j)
+        {
+            if(entries[j].status!=BATCH_PENDING||strncmp(paths[j],paths[i],pkg_len+1)!=0)
+            {
+                continue;
+            }
+
+            entries[j].status=p==NULL?-1:__resolve(p,paths[j],pkg_len,&entries[j].opt);
+            if(entries[j].status!=0)
+            {
+                continue;
+            }
+
+            opt=entries[j].opt;
+            bytes+=strlen(opt->e.name)+1;
+            if(opt->type==UCI_TYPE_STRING)
+            {
+                bytes+=strlen(opt->v.string)+1;
+            }
+            else
+            {
+                uci_foreach_element(&opt->v.list,e)
+                {
+                    ++values;
+                    bytes+=strlen(e->name)+1;
+                }
+            }
+        }
+    }
+
+    results=malloc(sizeof(easy_uci_result)*count+sizeof(char*)*values+bytes);
+    if(results==NULL)
+    {
+        free(entries);
+        LogE("Failed to alloc batch");
+        return -1;
+    }
+
+    list=(const char**)(results+count);
+    buff=(char*)(list+values);
+
+    for(i=0;i<count;++i)
+    {
+        results[i].status=entries[i].status;
+        o=&results[i].option;
+        memset(o,0,sizeof(easy_uci_option));
+
+        opt=entries[i].opt;
+        if(opt==NULL)
+        {
+            continue;
+        }
+
+        o->name=buff;
+        buff=stpcpy(buff,opt->e.name)+1;
+        if(opt->type==UCI_TYPE_STRING)
+        {
+            o->value=buff;
+            buff=stpcpy(buff,opt->v.string)+1;
+        }
+        else
+        {
+            o->list=list;
+            uci_foreach_element(&opt->v.list,e)
+            {
+                list[o->list_len++]=buff;
+                buff=stpcpy(buff,e->name)+1;
+            }
+            list+=o->list_len;
+        }
+    }
+
+    free(entries);
+
+    *results_p=results;
+
+    return 0;
+}
+
+void easy_uci_free_results(easy_uci_result* results)
+{
+    free(results);
+}
+
+int easy_uci_get_batch(const char* const* paths,size_t count,easy_uci_result** results_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(NULL);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_batch(s,paths,count,results_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define SHARED_BUCKETS 64
+
+/*
+ * One entry per config file ever used by the functions not taking a session, hashed by its path
+ * Entries are only added and never freed, so pointers to them stay valid without holding shared_lock
+ * The cached copy an entry holds is freed when the config dir changes, so only the entries themselves stay behind
+ */
+static pthread_rwlock_t shared_lock=PTHREAD_RWLOCK_INITIALIZER;
+static struct eu_shared* shared_buckets[SHARED_BUCKETS];
+//Accessed atomically
+static bool cache_enabled=false;
+
+static unsigned int __shared_hash(const char* path)
+{
+    unsigned int hash=5381;
+
+    for(;*path!='\0';++path)
+    {
+        hash=((hash<<5)+hash)+(unsigned char)*path;
+    }
+
+    return hash%SHARED_BUCKETS;
+}
+
+static struct eu_shared* __shared_find(const char* path,unsigned int hash)
+{
+    struct eu_shared* e;
+
+    for(e=shared_buckets[hash];e!=NULL;e=e->next)
+    {
+        if(strcmp(e->path,path)==0)
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Get the entry of a package in the current config dir, adding it on first use
+ * Return NULL on failure
+ */
+static struct eu_shared* __shared_get(const char* package)
+{
+    unsigned int hash;
+    struct eu_shared* e;
+    char config[PATH_MAX];
+    char delta[PATH_MAX];
+
+    //The same name in another config dir is another package
+    __eu_package_files(package,config,delta,sizeof(config));
+    hash=__shared_hash(config);
+
+    pthread_rwlock_rdlock(&shared_lock);
+    e=__shared_find(config,hash);
+    pthread_rwlock_unlock(&shared_lock);
+
+    if(e!=NULL)
+    {
+        return e;
+    }
+
+    pthread_rwlock_wrlock(&shared_lock);
+
+    //Another thread may have added it meanwhile
+    e=__shared_find(config,hash);
+    if(e==NULL)
+    {
+        e=calloc(1,sizeof(struct eu_shared));
+        if(e!=NULL&&((e->name=strdup(package))==NULL||(e->path=strdup(config))==NULL))
+        {
+            free(e->name);
+            free(e);
+            e=NULL;
+        }
+        if(e!=NULL)
+        {
+            pthread_rwlock_init(&e->lock,NULL);
+            e->next=shared_buckets[hash];
+            shared_buckets[hash]=e;
+        }
+    }
+
+    pthread_rwlock_unlock(&shared_lock);
+
+    if(e==NULL)
+    {
+        LogE("Failed to alloc package lock");
+    }
+
+    return e;
+}
+
+void __eu_cache_drop_all(void)
+{
+    size_t i;
+    struct eu_shared* heads[SHARED_BUCKETS];
+    struct eu_shared* e;
+
+    pthread_rwlock_rdlock(&shared_lock);
+    memcpy(heads,shared_buckets,sizeof(heads));
+    pthread_rwlock_unlock(&shared_lock);
+
+    //A writer holding e->lock may wait for shared_lock, so it's not held here
+    for(i=0;i<SHARED_BUCKETS;++i)
+    {
+        for(e=heads[i];e!=NULL;e=e->next)
+        {
+            pthread_rwlock_wrlock(&e->lock);
+            easy_uci_session_close(e->cache);
+            e->cache=NULL;
+            pthread_rwlock_unlock(&e->lock);
+        }
+    }
+}
+
+/*
+ * Whether the cached copy of a package can be read as it is
+ * Must be called with e->lock held
+ */
+static bool __shared_fresh(struct eu_shared* e)
+{
+    return e->cache!=NULL&&!__atomic_load_n(&e->stale,__ATOMIC_ACQUIRE)&&__eu_session_fresh(e->cache,e->name);
+}
+
+int easy_uci_cache_enable(bool enable)
+{
+    __atomic_store_n(&cache_enabled,enable,__ATOMIC_RELEASE);
+
+    if(!enable)
+    {
+        __eu_cache_drop_all();
+    }
+
+    return 0;
+}
+
+void easy_uci_cache_invalidate(const char* package)
+{
+    size_t i;
+    struct eu_shared* e;
+
+    pthread_rwlock_rdlock(&shared_lock);
+
+    //Only on writes, by name as the writer's session may use another config dir
+    for(i=0;i<SHARED_BUCKETS;++i)
+    {
+        for(e=shared_buckets[i];e!=NULL;e=e->next)
+        {
+            if(package==NULL||strcmp(e->name,package)==0)
+            {
+                __atomic_store_n(&e->stale,true,__ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&shared_lock);
+}
+
+easy_uci_session* __eu_read_session_open(const char* package)
+{
+    bool enabled;
+    struct eu_shared* e;
+    easy_uci_session* s;
+
+    //Reads must see the changes queued for the background writer
+    s=__eu_writer_acquire(package);
+    if(s!=NULL)
+    {
+        return s;
+    }
+
+    if(package==NULL)
+    {
+        return easy_uci_session_open_readonly();
+    }
+
+    e=__shared_get(package);
+    if(e==NULL)
+    {
+        return NULL;
+    }
+
+    pthread_rwlock_rdlock(&e->lock);
+
+    enabled=__atomic_load_n(&cache_enabled,__ATOMIC_ACQUIRE);
+
+    //Readers of a cached package share its session, which is only read from while e->lock is held shared
+    if(enabled&&__shared_fresh(e))
+    {
+        return e->cache;
+    }
+
+    if(!enabled)
+    {
+        s=easy_uci_session_open_readonly();
+        if(s==NULL)
+        {
+            pthread_rwlock_unlock(&e->lock);
+            return NULL;
+        }
+        s->shared=e;
+        return s;
+    }
+
+    //Loading changes the session, this read is served with e->lock held exclusive
+    pthread_rwlock_unlock(&e->lock);
+    pthread_rwlock_wrlock(&e->lock);
+
+    if(e->cache==NULL)
+    {
+        e->cache=easy_uci_session_open_readonly();
+        if(e->cache==NULL)
+        {
+            pthread_rwlock_unlock(&e->lock);
+            return NULL;
+        }
+        e->cache->shared=e;
+    }
+
+    if(!__shared_fresh(e))
+    {
+        //A failed load is reported by the read itself, which tries again
+        __atomic_store_n(&e->stale,false,__ATOMIC_RELEASE);
+        easy_uci_session_unload(e->cache,package);
+        __eu_session_load(e->cache,package);
+    }
+
+    return e->cache;
+}
+
+void __eu_read_session_close(easy_uci_session* s)
+{
+    struct eu_shared* e=s->shared;
+
+    if(s->deferred)
+    {
+        __eu_writer_release(s);
+        return;
+    }
+
+    if(e==NULL||s!=e->cache)
+    {
+        easy_uci_session_close(s);
+    }
+
+    if(e!=NULL)
+    {
+        pthread_rwlock_unlock(&e->lock);
+    }
+}
+
+easy_uci_session* __eu_write_session_open(const char* package)
+{
+    struct eu_shared* e;
+    easy_uci_session* s;
+
+    s=__eu_writer_acquire(package);
+    if(s!=NULL)
+    {
+        return s;
+    }
+
+    e=__shared_get(package);
+    if(e==NULL)
+    {
+        return NULL;
+    }
+
+    s=easy_uci_session_open();
+    if(s==NULL)
+    {
+        return NULL;
+    }
+    s->shared=e;
+
+    //Writers of different packages never wait for each other
+    pthread_rwlock_wrlock(&e->lock);
+
+    return s;
+}
+
+void __eu_write_session_close(easy_uci_session* s)
+{
+    struct eu_shared* e;
+
+    if(s==NULL)
+    {
+        return;
+    }
+
+    if(s->deferred)
+    {
+        __eu_writer_release(s);
+        return;
+    }
+
+    e=s->shared;
+    easy_uci_session_close(s);
+
+    if(e!=NULL)
+    {
+        pthread_rwlock_unlock(&e->lock);
+    }
+}
@@ -0,0 +1,537 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define FAST_CHUNK_SIZE 16384
+
+/*
+ * Nodes are bump allocated from chunks and freed all at once
+ */
+struct eu_fast_chunk
+{
+    struct eu_fast_chunk* next;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+};
+
+struct eu_fast
+{
+    //A private writable mapping of the file, the strings of the nodes are terminated in place
+    char* map;
+    size_t map_size;
+    struct eu_fast_chunk* chunks;
+    struct uci_package pkg;
+};
+
+/*
+ * The tokenizer works on one line at a time, a quote left open at the end of a line makes the file fall back to libuci
+ */
+struct eu_fast_line
+{
+    char* cur;
+    char* end;
+    //A ';' ended the last token, which ends the statement
+    bool stmt_end;
+};
+
+enum
+{
+    TOKEN_OK,
+    TOKEN_NONE,
+    TOKEN_FALLBACK,
+};
+
+static void* __alloc(struct eu_fast* f,size_t size)
+{
+    void* ret;
+    size_t chunk_size;
+    struct eu_fast_chunk* c=f->chunks;
+
+    size=(size+sizeof(max_align_t)-1)/sizeof(max_align_t)*sizeof(max_align_t);
+
+    if(c==NULL||c->size-c->used<size)
+    {
+        chunk_size=size>FAST_CHUNK_SIZE?size:FAST_CHUNK_SIZE;
+        c=malloc(sizeof(struct eu_fast_chunk)+chunk_size);
+        if(c==NULL)
+        {
+            return NULL;
+        }
+        c->next=f->chunks;
+        c->used=0;
+        c->size=chunk_size;
+        f->chunks=c;
+    }
+
+    ret=(char*)c->data+c->used;
+    c->used+=size;
+
+    return memset(ret,0,size);
+}
+
+static void __list_init(struct uci_list* head)
+{
+    head->next=head;
+    head->prev=head;
+}
+
+static void __list_append(struct uci_list* head,struct uci_list* ptr)
+{
+    ptr->prev=head->prev;
+    ptr->next=head;
+    head->prev->next=ptr;
+    head->prev=ptr;
+}
+
+/*
+ * Same as uci_validate_name() and uci_validate_type() of libuci
+ */
+static bool __valid_name(const char* str)
+{
+    if(*str=='\0')
+    {
+        return false;
+    }
+
+    for(;*str!='\0';++str)
+    {
+        if(!isalnum((unsigned char)*str)&&*str!='_')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool __valid_type(const char* str)
+{
+    if(*str=='\0')
+    {
+        return false;
+    }
+
+    for(;*str!='\0';++str)
+    {
+        if((unsigned char)*str<33||(unsigned char)*str>126)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Get the next token of a line, unquoted and '\0' terminated in place
+ * Backslash escapes and quotes spanning lines are left to libuci
+ */
+static int __next_token(struct eu_fast_line* l,char** token_p)
+{
+    char* w;
+    char* q;
+    char c;
+
+    if(l->stmt_end)
+    {
+        return TOKEN_NONE;
+    }
+
+    while(l->cur<l->end&&isspace((unsigned char)*l->cur))
+    {
+        ++l->cur;
+    }
+
+    if(l->cur==l->end||*l->cur=='#')
+    {
+        l->cur=l->end;
+        return TOKEN_NONE;
+    }
+
+    if(*l->cur==';')
+    {
+        ++l->cur;
+        l->stmt_end=true;
+        return TOKEN_NONE;
+    }
+
+    //Quoted parts are moved down over their quotes, the token never grows
+    *token_p=w=l->cur;
+    while(l->cur<l->end&&!isspace((unsigned char)*l->cur))
+    {
+        c=*l->cur;
+        if(c=='\''||c=='"')
+        {
+            q=memchr(l->cur+1,c,l->end-l->cur-1);
+            if(q==NULL||(c=='"'&&memchr(l->cur+1,'\\',q-l->cur-1)!=NULL))
+            {
+                return TOKEN_FALLBACK;
+            }
+            memmove(w,l->cur+1,q-l->cur-1);
+            w+=q-l->cur-1;
+            l->cur=q+1;
+        }
+        else if(c=='#')
+        {
+            //The rest of the line is a comment
+            l->cur=l->end;
+            break;
+        }
+        else if(c==';')
+        {
+            l->stmt_end=true;
+            ++l->cur;
+            break;
+        }
+        else if(c=='\\')
+        {
+            return TOKEN_FALLBACK;
+        }
+        else
+        {
+            *w++=c;
+            ++l->cur;
+        }
+    }
+
+    //w is at most at the char that ended the token, step over it before it's overwritten
+    if(l->cur<l->end&&isspace((unsigned char)*l->cur))
+    {
+        ++l->cur;
+    }
+    *w='\0';
+
+    return TOKEN_OK;
+}
+
+/*
+ * Same as djbhash() of libuci
+ */
+static unsigned int __djbhash(unsigned int hash,const char* str)
+{
+    if(hash==~0U)
+    {
+        hash=5381;
+    }
+
+    for(;*str!='\0';++str)
+    {
+        hash=((hash<<5)+hash)+*str;
+    }
+
+    return hash&0x7FFFFFFF;
+}
+
+/*
+ * Name an anonymous section when it's added, like uci_add_section() of libuci
+ * Its options aren't known yet, so only the type is hashed, and the count includes the section itself
+ */
+static char* __anonymous_name(struct eu_fast* f,const char* type)
+{
+    char* name;
+
+    name=__alloc(f,16);
+    if(name==NULL)
+    {
+        return NULL;
+    }
+    snprintf(name,16,"cfg%02x%04x",f->pkg.n_section,__djbhash(~0U,type)%(1<<16));
+
+    return name;
+}
+
+static struct uci_section* __find_section(struct eu_fast* f,const char* name)
+{
+    struct uci_element* e;
+
+    uci_foreach_element(&f->pkg.sections,e)
+    {
+        if(strcmp(e->name,name)==0)
+        {
+            return uci_to_section(e);
+        }
+    }
+
+    return NULL;
+}
+
+static struct uci_option* __find_option(struct uci_section* sec,const char* name)
+{
+    struct uci_element* e;
+
+    uci_foreach_element(&sec->options,e)
+    {
+        if(strcmp(e->name,name)==0)
+        {
+            return uci_to_option(e);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Parse one statement
+ * Return 0 for success, -1 to fall back to libuci
+ */
+static int __parse_statement(struct eu_fast* f,struct eu_fast_line* l,char* keyword,struct uci_section** sec_p)
+{
+    int ret;
+    size_t argc=0;
+    char* argv[3];
+    char* extra;
+    struct uci_section* sec;
+    struct uci_option* opt;
+    struct uci_element* item;
+
+    while(argc<2&&(ret=__next_token(l,&argv[argc]))==TOKEN_OK)
+    {
+        ++argc;
+    }
+    if(ret==TOKEN_FALLBACK||(argc==2&&__next_token(l,&extra)!=TOKEN_NONE))
+    {
+        return -1;
+    }
+
+    //Like libuci, a keyword can be shortened to its first letter
+    switch(keyword[0])
+    {
+    case 'c':
+        if(keyword[1]!='\0'&&strcmp(keyword+1,"onfig")!=0)
+        {
+            return -1;
+        }
+        if(argc==0||!__valid_type(argv[0])||(argc==2&&!__valid_name(argv[1])))
+        {
+            return -1;
+        }
+        //libuci reuses a section declared again, merging its options and taking the later type
+        if(argc==2&&__find_section(f,argv[1])!=NULL)
+        {
+            return -1;
+        }
+
+        sec=__alloc(f,sizeof(struct uci_section));
+        if(sec==NULL)
+        {
+            return -1;
+        }
+        ++f->pkg.n_section;
+        sec->e.type=UCI_TYPE_SECTION;
+        sec->e.name=argc==2?argv[1]:__anonymous_name(f,argv[0]);
+        if(sec->e.name==NULL)
+        {
+            return -1;
+        }
+        sec->type=argv[0];
+        sec->package=&f->pkg;
+        sec->anonymous=argc<2;
+        __list_init(&sec->options);
+        __list_append(&f->pkg.sections,&sec->e.list);
+
+        *sec_p=sec;
+        return 0;
+
+    case 'o':
+    case 'l':
+        if(keyword[1]!='\0'&&strcmp(keyword+1,keyword[0]=='o'?"ption":"ist")!=0)
+        {
+            return -1;
+        }
+        sec=*sec_p;
+        if(sec==NULL||argc<2||!__valid_name(argv[0]))
+        {
+            return -1;
+        }
+
+        //Setting an option twice or turning it into a list is left to libuci
+        opt=__find_option(sec,argv[0]);
+        if(opt!=NULL&&(keyword[0]=='o'||opt->type!=UCI_TYPE_LIST))
+        {
+            return -1;
+        }
+
+        if(opt==NULL)
+        {
+            opt=__alloc(f,sizeof(struct uci_option));
+            if(opt==NULL)
+            {
+                return -1;
+            }
+            opt->e.type=UCI_TYPE_OPTION;
+            opt->e.name=argv[0];
+            opt->section=sec;
+            __list_append(&sec->options,&opt->e.list);
+
+            if(keyword[0]=='o')
+            {
+                opt->type=UCI_TYPE_STRING;
+                opt->v.string=argv[1];
+                return 0;
+            }
+
+            opt->type=UCI_TYPE_LIST;
+            __list_init(&opt->v.list);
+        }
+
+        item=__alloc(f,sizeof(struct uci_element));
+        if(item==NULL)
+        {
+            return -1;
+        }
+        item->type=UCI_TYPE_ITEM;
+        item->name=argv[1];
+        __list_append(&opt->v.list,&item->list);
+        return 0;
+
+    default:
+        //Including 'package', which may switch to another package
+        return -1;
+    }
+}
+
+void __eu_fast_free(struct eu_fast* f)
+{
+    struct eu_fast_chunk* c;
+    struct eu_fast_chunk* next;
+
+    if(f==NULL)
+    {
+        return;
+    }
+
+    for(c=f->chunks;c!=NULL;c=next)
+    {
+        next=c->next;
+        free(c);
+    }
+
+    if(f->map!=NULL)
+    {
+        munmap(f->map,f->map_size);
+    }
+
+    free(f);
+}
+
+struct eu_fast* __eu_fast_load(const char* path,const char* name,const struct eu_stamp* stamp,struct uci_package** pkg_p)
+{
+    int fd;
+    long page;
+    size_t size;
+    char* end;
+    char* keyword;
+    struct eu_fast* f;
+    struct eu_fast_line l;
+    struct uci_section* sec=NULL;
+    struct stat st;
+
+    fd=open(path,O_RDONLY|O_CLOEXEC);
+    if(fd<0)
+    {
+        return NULL;
+    }
+
+    //The file may have been replaced or truncated since it was stamped, reading past its end would raise SIGBUS
+    if(fstat(fd,&st)!=0||st.st_dev!=stamp->dev||st.st_ino!=stamp->ino||st.st_size!=stamp->size
+        ||st.st_mtim.tv_sec!=stamp->mtime.tv_sec||st.st_mtim.tv_nsec!=stamp->mtime.tv_nsec)
+    {
+        close(fd);
+        return NULL;
+    }
+    size=(size_t)st.st_size;
+
+    //The last token is terminated after the end of the file, which needs room in the last page
+    page=sysconf(_SC_PAGESIZE);
+    if(size==0||(page>0&&size%(size_t)page==0))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    f=calloc(1,sizeof(struct eu_fast));
+    if(f==NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    //Pages are only copied when a token on them is terminated
+    f->map=mmap(NULL,size+1,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(f->map==MAP_FAILED)
+    {
+        f->map=NULL;
+        goto fallback;
+    }
+    f->map_size=size+1;
+    f->map[size]='\0';
+
+    f->pkg.e.type=UCI_TYPE_PACKAGE;
+    __list_init(&f->pkg.e.list);
+    __list_init(&f->pkg.sections);
+    __list_init(&f->pkg.delta);
+    __list_init(&f->pkg.saved_delta);
+    f->pkg.e.name=__alloc(f,strlen(name)+1);
+    if(f->pkg.e.name==NULL)
+    {
+        goto fallback;
+    }
+    strcpy(f->pkg.e.name,name);
+
+    for(l.cur=f->map,end=f->map+size;l.cur<end;)
+    {
+        //memchr() is vectorized by libc, most of a line is skipped at word speed
+        l.end=memchr(l.cur,'\n',end-l.cur);
+        if(l.end==NULL)
+        {
+            l.end=end;
+        }
+
+        //A line holds any number of statements separated by ';'
+        while(true)
+        {
+            l.stmt_end=false;
+            switch(__next_token(&l,&keyword))
+            {
+            case TOKEN_FALLBACK:
+                goto fallback;
+            case TOKEN_NONE:
+                if(l.stmt_end)
+                {
+                    continue;
+                }
+                break;
+            default:
+                if(__parse_statement(f,&l,keyword,&sec)!=0)
+                {
+                    goto fallback;
+                }
+                continue;
+            }
+            break;
+        }
+
+        l.cur=l.end+1;
+    }
+
+    *pkg_p=&f->pkg;
+
+    return f;
+
+fallback:
+    __eu_fast_free(f);
+    return NULL;
+}
@@ -0,0 +1,585 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define HASH_MIN_CAP 16
+#define TYPE_LIST_MIN_CAP 8
+
+/*
+ * Open addressing with linear probing, deletion shifts the following entries back so there're no tombstones
+ * Keys point to names owned by libuci, an entry must be removed before its element is freed
+ */
+
+static unsigned int __hash(const void* owner,const char* name,size_t len)
+{
+    size_t i;
+    uint32_t h=2166136261u;
+    uintptr_t o=(uintptr_t)owner;
+
+    for(i=0;i<len;++i)
+    {
+        h^=(unsigned char)name[i];
+        h*=16777619u;
+    }
+
+    //Section pointers are aligned, mix all their bits into the low ones used as slot index
+    o^=o>>16;
+    h^=(uint32_t)o;
+    h^=h>>16;
+    h*=0x85ebca6bu;
+    h^=h>>13;
+    h*=0xc2b2ae35u;
+    h^=h>>16;
+
+    return h;
+}
+
+/*
+ * name doesn't need to be '\0' terminated, only its first len chars are matched
+ */
+static struct eu_hash_slot* __find(struct eu_hash* h,const void* owner,const char* name,size_t len,unsigned int hash)
+{
+    size_t i;
+    struct eu_hash_slot* slot;
+
+    if(h->cap==0)
+    {
+        return NULL;
+    }
+
+    for(i=hash&(h->cap-1);;i=(i+1)&(h->cap-1))
+    {
+        slot=&h->slots[i];
+        if(slot->name==NULL)
+        {
+            return NULL;
+        }
+        if(slot->hash==hash&&slot->owner==owner&&strncmp(slot->name,name,len)==0&&slot->name[len]=='\0')
+        {
+            return slot;
+        }
+    }
+}
+
+static void __place(struct eu_hash* h,const struct eu_hash_slot* src)
+{
+    size_t i;
+
+    for(i=src->hash&(h->cap-1);h->slots[i].name!=NULL;i=(i+1)&(h->cap-1));
+    h->slots[i]=*src;
+}
+
+static int __grow(struct eu_hash* h)
+{
+    size_t i;
+    size_t old_cap=h->cap;
+    struct eu_hash_slot* old=h->slots;
+    struct eu_hash_slot* slots;
+
+    slots=calloc(old_cap==0?HASH_MIN_CAP:old_cap*2,sizeof(struct eu_hash_slot));
+    if(slots==NULL)
+    {
+        return -1;
+    }
+
+    h->slots=slots;
+    h->cap=old_cap==0?HASH_MIN_CAP:old_cap*2;
+
+    for(i=0;i<old_cap;++i)
+    {
+        if(old[i].name!=NULL)
+        {
+            __place(h,&old[i]);
+        }
+    }
+    free(old);
+
+    return 0;
+}
+
+static int __put(struct eu_hash* h,const void* owner,const char* name,void* value)
+{
+    unsigned int hash;
+    size_t len=strlen(name);
+    struct eu_hash_slot* slot;
+    struct eu_hash_slot n;
+
+    hash=__hash(owner,name,len);
+
+    slot=__find(h,owner,name,len,hash);
+    if(slot!=NULL)
+    {
+        slot->name=name;
+        slot->value=value;
+        return 0;
+    }
+
+    //Keep the load factor under 3/4
+    if((h->count+1)*4>h->cap*3&&__grow(h)!=0)
+    {
+        return -1;
+    }
+
+    n.owner=owner;
+    n.name=name;
+    n.value=value;
+    n.hash=hash;
+    __place(h,&n);
+    ++h->count;
+
+    return 0;
+}
+
+static void* __get(struct eu_hash* h,const void* owner,const char* name,size_t len)
+{
+    struct eu_hash_slot* slot;
+
+    slot=__find(h,owner,name,len,__hash(owner,name,len));
+
+    return slot==NULL?NULL:slot->value;
+}
+
+static void __del(struct eu_hash* h,const void* owner,const char* name)
+{
+    size_t i,j,k;
+    size_t len=strlen(name);
+    struct eu_hash_slot* slot;
+
+    slot=__find(h,owner,name,len,__hash(owner,name,len));
+    if(slot==NULL)
+    {
+        return;
+    }
+
+    i=slot-h->slots;
+    for(j=(i+1)&(h->cap-1);h->slots[j].name!=NULL;j=(j+1)&(h->cap-1))
+    {
+        //Move back an entry unless its home slot lies cyclically in (i,j]
+        k=h->slots[j].hash&(h->cap-1);
+        if(i<=j?(i<k&&k<=j):(i<k||k<=j))
+        {
+            continue;
+        }
+        h->slots[i]=h->slots[j];
+        i=j;
+    }
+    memset(&h->slots[i],0,sizeof(struct eu_hash_slot));
+    --h->count;
+}
+
+static void __clear(struct eu_hash* h)
+{
+    free(h->slots);
+    memset(h,0,sizeof(struct eu_hash));
+}
+
+static int __list_append(struct eu_type_list* tl,struct uci_section* sec)
+{
+    struct uci_section** secs;
+    size_t cap;
+
+    if(tl->len==tl->cap)
+    {
+        cap=tl->cap==0?TYPE_LIST_MIN_CAP:tl->cap*2;
+        secs=realloc(tl->secs,sizeof(struct uci_section*)*cap);
+        if(secs==NULL)
+        {
+            return -1;
+        }
+        tl->secs=secs;
+        tl->cap=cap;
+    }
+
+    tl->secs[tl->len++]=sec;
+
+    return 0;
+}
+
+static int __type_append(struct eu_package* p,struct uci_section* sec)
+{
+    struct eu_type_list* tl;
+
+    tl=__get(&p->types,NULL,sec->type,strlen(sec->type));
+    if(tl==NULL)
+    {
+        tl=calloc(1,sizeof(struct eu_type_list));
+        if(tl==NULL)
+        {
+            return -1;
+        }
+
+        tl->type=strdup(sec->type);
+        if(tl->type==NULL||__put(&p->types,NULL,tl->type,tl)!=0)
+        {
+            free(tl->type);
+            free(tl);
+            return -1;
+        }
+    }
+
+    return __list_append(tl,sec);
+}
+
+static void __type_remove(struct eu_package* p,struct uci_section* sec)
+{
+    size_t i;
+    struct eu_type_list* tl;
+
+    tl=__get(&p->types,NULL,sec->type,strlen(sec->type));
+    if(tl==NULL)
+    {
+        return;
+    }
+
+    //Sections are usually deleted from the end
+    for(i=tl->len;i>0;--i)
+    {
+        if(tl->secs[i-1]==sec)
+        {
+            memmove(&tl->secs[i-1],&tl->secs[i],sizeof(struct uci_section*)*(tl->len-i));
+            --tl->len;
+            break;
+        }
+    }
+}
+
+static void __values_free(struct eu_value_index* vi)
+{
+    size_t i;
+    struct eu_type_list* tl;
+
+    for(i=0;i<vi->values.cap;++i)
+    {
+        tl=vi->values.slots[i].value;
+        if(tl!=NULL)
+        {
+            free(tl->secs);
+            free(tl);
+        }
+    }
+
+    __clear(&vi->values);
+    free(vi->type);
+    free(vi->option);
+    free(vi);
+}
+
+static void __values_drop(struct eu_package* p)
+{
+    struct eu_value_index* vi;
+
+    while(p->values!=NULL)
+    {
+        vi=p->values;
+        p->values=vi->next;
+        __values_free(vi);
+    }
+}
+
+static int __values_add(struct eu_value_index* vi,const char* value,struct uci_section* sec)
+{
+    struct eu_type_list* tl;
+
+    tl=__get(&vi->values,NULL,value,strlen(value));
+    if(tl==NULL)
+    {
+        tl=calloc(1,sizeof(struct eu_type_list));
+        if(tl==NULL)
+        {
+            return -1;
+        }
+
+        if(__put(&vi->values,NULL,value,tl)!=0)
+        {
+            free(tl);
+            return -1;
+        }
+    }
+
+    //A list holding the same value twice lists its section once
+    if(tl->len>0&&tl->secs[tl->len-1]==sec)
+    {
+        return 0;
+    }
+
+    return __list_append(tl,sec);
+}
+
+static int __values_build(struct eu_package* p,struct eu_value_index* vi)
+{
+    size_t i;
+    size_t len=strlen(vi->option);
+    struct eu_type_list* tl;
+    struct uci_option* opt;
+    struct uci_element* e;
+
+    tl=__get(&p->types,NULL,vi->type,strlen(vi->type));
+    for(i=0;tl!=NULL&&i<tl->len;++i)
+    {
+        opt=__get(&p->options,tl->secs[i],vi->option,len);
+        if(opt==NULL)
+        {
+            continue;
+        }
+
+        if(opt->type==UCI_TYPE_STRING)
+        {
+            if(__values_add(vi,opt->v.string,tl->secs[i])!=0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        uci_foreach_element(&opt->v.list,e)
+        {
+            if(__values_add(vi,e->name,tl->secs[i])!=0)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int __eu_index_values(struct eu_package* p,const char* type,const char* option,const char* value,struct eu_type_list** tl_p)
+{
+    struct eu_value_index* vi;
+
+    for(vi=p->values;vi!=NULL;vi=vi->next)
+    {
+        if(strcmp(vi->type,type)==0&&strcmp(vi->option,option)==0)
+        {
+            break;
+        }
+    }
+
+    if(vi==NULL)
+    {
+        vi=calloc(1,sizeof(struct eu_value_index));
+        if(vi==NULL)
+        {
+            return -1;
+        }
+
+        vi->type=strdup(type);
+        vi->option=strdup(option);
+        if(vi->type==NULL||vi->option==NULL||__values_build(p,vi)!=0)
+        {
+            __values_free(vi);
+            return -1;
+        }
+
+        vi->next=p->values;
+        p->values=vi;
+    }
+
+    *tl_p=__get(&vi->values,NULL,value,strlen(value));
+
+    return 0;
+}
+
+int __eu_index_build(struct eu_package* p)
+{
+    struct uci_element* se;
+    struct uci_element* oe;
+    struct uci_section* sec;
+
+    __eu_index_free(p);
+
+    uci_foreach_element(&p->pkg->sections,se)
+    {
+        sec=uci_to_section(se);
+        if(__put(&p->sections,NULL,se->name,sec)!=0||__type_append(p,sec)!=0)
+        {
+            goto error;
+        }
+
+        uci_foreach_element(&sec->options,oe)
+        {
+            if(__put(&p->options,sec,oe->name,uci_to_option(oe))!=0)
+            {
+                goto error;
+            }
+        }
+    }
+
+    return 0;
+
+error:
+    __eu_index_free(p);
+    return -1;
+}
+
+void __eu_index_free(struct eu_package* p)
+{
+    size_t i;
+    struct eu_type_list* tl;
+
+    for(i=0;i<p->types.cap;++i)
+    {
+        tl=p->types.slots[i].value;
+        if(tl!=NULL)
+        {
+            free(tl->secs);
+            free(tl->type);
+            free(tl);
+        }
+    }
+
+    __clear(&p->sections);
+    __clear(&p->options);
+    __clear(&p->types);
+    __values_drop(p);
+}
+
+/*
+ * Get the nth section of a type, a negative n counts from the last one
+ */
+static struct uci_section* __nth_of_type(struct eu_package* p,const char* type,size_t len,long n)
+{
+    struct eu_type_list* tl;
+
+    tl=__get(&p->types,NULL,type,len);
+    if(tl==NULL)
+    {
+        return NULL;
+    }
+
+    //Counted from the end, -(n+1) can't overflow like -n does for LONG_MIN
+    if(n<0)
+    {
+        if((size_t)-(n+1)>=tl->len)
+        {
+            return NULL;
+        }
+        return tl->secs[tl->len-1-(size_t)-(n+1)];
+    }
+
+    if((size_t)n>=tl->len)
+    {
+        return NULL;
+    }
+    return tl->secs[n];
+}
+
+static struct uci_section* __section(struct eu_package* p,const char* name,size_t len)
+{
+    long n;
+    char* end;
+    const char* bracket;
+
+    if(len==0||name[0]!='@')
+    {
+        return __get(&p->sections,NULL,name,len);
+    }
+
+    //Extended syntax: @type[n]
+    bracket=memchr(name,'[',len);
+    if(bracket==NULL||bracket==name+1||name[len-1]!=']')
+    {
+        return NULL;
+    }
+
+    n=strtol(bracket+1,&end,10);
+    if(end==bracket+1||end!=name+len-1)
+    {
+        return NULL;
+    }
+
+    return __nth_of_type(p,name+1,bracket-name-1,n);
+}
+
+struct uci_section* __eu_index_section(struct eu_package* p,const char* name)
+{
+    return __eu_index_section_len(p,name,strlen(name));
+}
+
+struct uci_section* __eu_index_section_len(struct eu_package* p,const char* name,size_t len)
+{
+    struct uci_section* sec;
+    STATS_DECL(t);
+
+    STATS_START(t);
+    sec=__section(p,name,len);
+    STATS_END(t,EASY_UCI_STATS_LOOKUP,sec!=NULL);
+
+    return sec;
+}
+
+struct uci_option* __eu_index_option(struct eu_package* p,struct uci_section* sec,const char* name)
+{
+    return __eu_index_option_len(p,sec,name,strlen(name));
+}
+
+struct uci_option* __eu_index_option_len(struct eu_package* p,struct uci_section* sec,const char* name,size_t len)
+{
+    struct uci_option* opt;
+    STATS_DECL(t);
+
+    STATS_START(t);
+    opt=__get(&p->options,sec,name,len);
+    STATS_END(t,EASY_UCI_STATS_LOOKUP,opt!=NULL);
+
+    return opt;
+}
+
+struct eu_type_list* __eu_index_type(struct eu_package* p,const char* type)
+{
+    return __get(&p->types,NULL,type,strlen(type));
+}
+
+struct uci_section* __eu_index_nth_of_type(struct eu_package* p,const char* type,int n)
+{
+    return __nth_of_type(p,type,strlen(type),n);
+}
+
+int __eu_index_add_section(struct eu_package* p,struct uci_section* sec)
+{
+    __values_drop(p);
+
+    if(__put(&p->sections,NULL,sec->e.name,sec)!=0)
+    {
+        return -1;
+    }
+
+    if(__type_append(p,sec)!=0)
+    {
+        __del(&p->sections,NULL,sec->e.name);
+        return -1;
+    }
+
+    return 0;
+}
+
+void __eu_index_del_section(struct eu_package* p,struct uci_section* sec)
+{
+    struct uci_element* e;
+
+    __values_drop(p);
+
+    uci_foreach_element(&sec->options,e)
+    {
+        __del(&p->options,sec,e->name);
+    }
+    __del(&p->sections,NULL,sec->e.name);
+    __type_remove(p,sec);
+}
+
+int __eu_index_put_option(struct eu_package* p,struct uci_section* sec,struct uci_option* opt)
+{
+    __values_drop(p);
+
+    return __put(&p->options,sec,opt->e.name,opt);
+}
+
+void __eu_index_del_option(struct eu_package* p,struct uci_section* sec,const char* name)
+{
+    __values_drop(p);
+    __del(&p->options,sec,name);
+}
@@ -0,0 +1,405 @@
+#ifndef _EASY_UCI_INTERNAL_H_
+#define _EASY_UCI_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <uci.h>
+
+#include "easy_uci.h"
+
+#define ERR_MSG_BUFF_SIZE 256
+
+#define LogE(s) __logE(__func__,s)
+
+/*
+ * Timing a phase for the stats: STATS_DECL(t) with the declarations, STATS_START(t) where the phase starts
+ * t stays 0 while the stats are off, so a phase costs one relaxed load and no clock read
+ */
+#ifndef EASY_UCI_NO_STATS
+extern bool __eu_stats_on;
+#define STATS_DECL(t) uint64_t t=0
+#define STATS_START(t) do{if(__atomic_load_n(&__eu_stats_on,__ATOMIC_RELAXED)){t=__eu_stats_now();}}while(0)
+#define STATS_END(t,phase,ok) do{if(t!=0){__eu_stats_record(phase,t,ok);}}while(0)
+#define STATS_PARSED(t,bytes) do{if(t!=0){__eu_stats_parsed(bytes);}}while(0)
+#define STATS_COMMIT(t,package,ok,bytes) do{if(t!=0){__eu_stats_commit(t,package,ok,bytes);}}while(0)
+#else
+#define STATS_DECL(t) uint64_t t __attribute__((unused))=0
+#define STATS_START(t) do{}while(0)
+#define STATS_END(t,phase,ok) do{}while(0)
+#define STATS_PARSED(t,bytes) do{(void)(bytes);}while(0)
+#define STATS_COMMIT(t,package,ok,bytes) do{(void)(bytes);}while(0)
+#endif
+
+/*
+ * What stat() says about a config file and its delta file in the savedir, used to tell whether they have changed
+ */
+struct eu_stamp
+{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    //All zeros if there's no delta file
+    ino_t delta_ino;
+    off_t delta_size;
+    struct timespec delta_mtime;
+};
+
+struct eu_hash_slot
+{
+    const void* owner;
+    const char* name;
+    void* value;
+    unsigned int hash;
+};
+
+/*
+ * A hash table keyed by an (owner, name) pair
+ */
+struct eu_hash
+{
+    struct eu_hash_slot* slots;
+    size_t cap;
+    size_t count;
+};
+
+/*
+ * The sections of one type in file order
+ */
+struct eu_type_list
+{
+    char* type;
+    struct uci_section** secs;
+    size_t len;
+    size_t cap;
+};
+
+/*
+ * The sections of a type by the value of one of their options, see easy_uci_session_index_option()
+ * Built on first use and dropped by any change to the package, as its keys point to the values in the package
+ */
+struct eu_value_index
+{
+    char* type;
+    char* option;
+    //Value -> struct eu_type_list* of the sections having it, a list option has an entry for each of its values
+    struct eu_hash values;
+    struct eu_value_index* next;
+};
+
+/*
+ * An option whose values are indexed, kept by the session across reloads of the package
+ */
+struct eu_index_def
+{
+    char* package;
+    char* type;
+    char* option;
+    struct eu_index_def* next;
+};
+
+struct eu_fast;
+
+/*
+ * A package loaded into a session
+ * pkg is owned by the uci_context of the session and may be replaced by uci_commit()
+ */
+struct eu_package
+{
+    char* name;
+    struct uci_package* pkg;
+    //Set if pkg was parsed by __eu_fast_load() and isn't known to the uci context
+    struct eu_fast* fast;
+    //Section name -> uci_section*
+    struct eu_hash sections;
+    //(uci_section*, option name) -> uci_option*
+    struct eu_hash options;
+    //Section type -> struct eu_type_list*
+    struct eu_hash types;
+    //The value indexes built so far
+    struct eu_value_index* values;
+    struct eu_stamp stamp;
+    bool dirty;
+    //Write to the config file on the next commit even if the session stages writes
+    bool flush;
+    //Changes queued for the background writer since the last commit
+    unsigned long pending;
+    //Fail the next commit with a conflict unless the files are still at version expected
+    bool expect;
+    easy_uci_version expected;
+    struct eu_package* next;
+};
+
+/*
+ * A package used by the functions not taking a session, shared by all threads
+ */
+struct eu_shared
+{
+    char* name;
+    //The config file, entries are keyed by it so another config dir gets other entries
+    char* path;
+    //Held shared by reads of the package and exclusive by writes
+    pthread_rwlock_t lock;
+    //The cached copy of the package in a session of its own, NULL if it's not cached
+    easy_uci_session* cache;
+    //Set by easy_uci_cache_invalidate() to have the cached copy reloaded, accessed atomically
+    bool stale;
+    struct eu_shared* next;
+};
+
+struct easy_uci_session
+{
+    struct uci_context* ctx;
+    struct eu_package* packages;
+    bool in_txn;
+    bool txn_failed;
+    //Reload packages whose config file has changed since they were loaded
+    bool validate;
+    //Save changes as deltas in the savedir instead of writing the config files
+    bool staged;
+    //Only mark changed packages dirty and leave committing them to the background writer
+    bool deferred;
+    //The package whose lock is held for a call of a function not taking a session, NULL if none
+    struct eu_shared* shared;
+    //Set when a commit failed because of a version conflict
+    bool conflict;
+    //Packages are parsed by __eu_fast_load() when possible and can't be changed
+    bool readonly;
+    //Options to index the values of, see easy_uci_session_index_option()
+    struct eu_index_def* index_defs;
+};
+
+void __logE(const char* func,const char* msg);
+
+/*
+ * Used by the STATS_ macros, start is what __eu_stats_now() returned when the phase started
+ * __eu_stats_commit() times the commit phase and counts it for the package
+ */
+uint64_t __eu_stats_now(void);
+void __eu_stats_record(int phase,uint64_t start,bool ok);
+void __eu_stats_parsed(size_t bytes);
+void __eu_stats_commit(uint64_t start,const char* package,bool ok,size_t bytes);
+
+/*
+ * Allocate a packed easy_uci_list for count strings taking bytes in total, '\0' terms included
+ * Return the start of the string area for the caller to copy the strings to, NULL for failure
+ * On success *list_p is filled with list_p->list[] left for the caller to set, in order from the start of the string area
+ */
+char* __eu_list_alloc(easy_uci_list* list_p,size_t count,size_t bytes);
+
+/*
+ * Get a package from the session, loading it on first use
+ * Return NULL on failure, the uci error is left in s->ctx
+ */
+struct eu_package* __eu_session_load(easy_uci_session* s,const char* package);
+
+/*
+ * Same as __eu_session_load() for a call that changes the package, which fails in a read-only session
+ */
+struct eu_package* __eu_session_load_rw(easy_uci_session* s,const char* package);
+
+/*
+ * Unload a package from the session and free it
+ * Changes not yet committed are lost, which fails the open transaction if there's one
+ */
+void __eu_session_drop(easy_uci_session* s,struct eu_package* p);
+
+/*
+ * Record that an operation failed, which fails the open transaction if there's one
+ */
+void __eu_session_fail(easy_uci_session* s);
+
+/*
+ * Write all changes made to a package back to the config file, or save them as deltas if the session stages writes
+ * When a transaction is open, the package is only marked dirty and written by easy_uci_session_commit()
+ * Return 0 for success, -1 for failure with the uci error left in s->ctx
+ * On failure the package is dropped from the session
+ */
+int __eu_session_commit(easy_uci_session* s,struct eu_package* p);
+
+/*
+ * Take the lock serializing the writes of easy_uci to a package, released by closing the fd
+ * Return the fd holding the lock, -1 for failure
+ */
+int __eu_lock_package(struct uci_context* ctx,const char* package);
+
+/*
+ * Write the dirty packages of the session through the journal, so either all of them are changed or none
+ * Return 0 for success, -1 for failure with s->conflict set if a package changed since it was loaded
+ * Once the commit line is synced it's a success, config files that can't be replaced then are left to recovery
+ * On success the packages are dropped from the session, on failure they are left dirty
+ */
+int __eu_journal_commit(easy_uci_session* s);
+
+/*
+ * Finish or discard a journaled commit interrupted by a crash, if the confdir of ctx has its journal
+ * Return 0 for success, -1 for failure
+ */
+int __eu_journal_recover(struct uci_context* ctx);
+
+/*
+ * Same as __eu_journal_recover(), only once per process for the config dir generation gen
+ * Called by session opens, a journal left by a crash after that is recovered by the next commit
+ */
+int __eu_journal_recover_once(struct uci_context* ctx,unsigned long gen);
+
+/*
+ * Whether a package is loaded in the session and its files haven't changed since
+ * Only reads the session, so it can run in many threads at once
+ */
+bool __eu_session_fresh(easy_uci_session* s,const char* package);
+
+/*
+ * Get the stamp of the config file and the delta file of a package
+ * Return 0 for success, -1 for failure
+ */
+int __eu_stamp_package(struct uci_context* ctx,const char* package,struct eu_stamp* stamp);
+
+/*
+ * Get the stamp of a config file and a delta file, delta is "" if there's none
+ * Return 0 for success, -1 for failure
+ */
+int __eu_stamp_files(const char* config,const char* delta,struct eu_stamp* stamp);
+
+/*
+ * Whether two stamps are the same
+ */
+bool __eu_stamp_equal(const struct eu_stamp* a,const struct eu_stamp* b);
+
+/*
+ * Get the paths of the config file and the delta file of a package for the dirs set by easy_uci_set_config_dir()
+ * delta is set to "" for a package given by path, which has no delta file
+ */
+void __eu_package_files(const char* package,char* config,char* delta,size_t size);
+
+/*
+ * Hash a stamp into a version
+ */
+easy_uci_version __eu_stamp_version(const struct eu_stamp* stamp);
+
+/*
+ * Get a session for a read-only call on a package, with the package locked shared for the call
+ * This is the session of the background writer when it's running, the cached copy of the package when the cache
+ * is enabled, or a new session otherwise
+ * package can be NULL for a call reading many packages, which gets a new session with no lock held
+ * Return NULL on failure
+ */
+easy_uci_session* __eu_read_session_open(const char* package);
+
+/*
+ * Free the cached copies of all packages, called when the config dir changes
+ */
+void __eu_cache_drop_all(void);
+
+/*
+ * Release a session got by __eu_read_session_open()
+ */
+void __eu_read_session_close(easy_uci_session* s);
+
+/*
+ * Get the session of the background writer for a call on package, locked for the caller
+ * Waits for the writer thread to finish committing package first, or any package if package is NULL
+ * Return NULL if the writer isn't running
+ */
+easy_uci_session* __eu_writer_acquire(const char* package);
+
+/*
+ * Commit the changes queued in the session of the background writer now, called with the session acquired
+ * A transaction in that session commits them first, its rollback would drop them otherwise
+ */
+void __eu_writer_commit(void);
+
+/*
+ * Unlock the session of the background writer and wake the writer up if changes have been queued
+ */
+void __eu_writer_release(easy_uci_session* s);
+
+/*
+ * Get a session for a call that writes a package, with the package locked exclusive for the call
+ * This is the session of the background writer when it's running, or a new session otherwise
+ * Return NULL on failure
+ */
+easy_uci_session* __eu_write_session_open(const char* package);
+
+/*
+ * Release a session got by __eu_write_session_open()
+ */
+void __eu_write_session_close(easy_uci_session* s);
+
+/*
+ * Parse a config file into a package without libuci, the file must still be the one stamp was taken of
+ * Only the usual subset of the format is handled: no backslash escapes, no quotes spanning lines, no options set twice
+ * Return NULL if the file should be left to libuci, otherwise the package is stored in *pkg_p
+ * The package holds the file mapped, its nodes are valid until __eu_fast_free() and must not be passed to libuci
+ */
+struct eu_fast* __eu_fast_load(const char* path,const char* name,const struct eu_stamp* stamp,struct uci_package** pkg_p);
+
+/*
+ * Free a package parsed by __eu_fast_load(), f can be NULL
+ */
+void __eu_fast_free(struct eu_fast* f);
+
+/*
+ * Rewrite the snapshot of a package from what's in p after a commit, if the package has a snapshot
+ * config is the path of the config file p was loaded from
+ */
+void __eu_snapshot_refresh(struct eu_package* p,const char* config);
+
+/*
+ * Index the sections and options of p->pkg by name, dropping the old index
+ * Return 0 for success, -1 for failure
+ */
+int __eu_index_build(struct eu_package* p);
+
+/*
+ * Free the index of a package
+ */
+void __eu_index_free(struct eu_package* p);
+
+/*
+ * Look up a section or an option by name in O(1)
+ * A section can also be named as @type[n], which is looked up like __eu_index_nth_of_type()
+ * The _len versions match the first len chars of name, which doesn't need to be '\0' terminated
+ * Return NULL if not found
+ */
+struct uci_section* __eu_index_section(struct eu_package* p,const char* name);
+struct uci_section* __eu_index_section_len(struct eu_package* p,const char* name,size_t len);
+struct uci_option* __eu_index_option(struct eu_package* p,struct uci_section* sec,const char* name);
+struct uci_option* __eu_index_option_len(struct eu_package* p,struct uci_section* sec,const char* name,size_t len);
+
+/*
+ * Get the sections of a type in file order
+ * Return NULL if there's no section of the type
+ */
+struct eu_type_list* __eu_index_type(struct eu_package* p,const char* type);
+
+/*
+ * Get the nth section of a type in O(1), a negative n counts from the last one
+ * Return NULL if not found
+ */
+struct uci_section* __eu_index_nth_of_type(struct eu_package* p,const char* type,int n);
+
+/*
+ * Get the sections of type whose option has value, using the value index of (type, option) built on first use
+ * *tl_p is set to NULL if there's none
+ * Return 0 for success, -1 if the index can't be built
+ */
+int __eu_index_values(struct eu_package* p,const char* type,const char* option,const char* value,struct eu_type_list** tl_p);
+
+/*
+ * Keep the index up to date after a section or an option has been added, replaced or before it's deleted
+ * The value indexes are dropped, they're built again on next use
+ * A section can only be added after all sections already in the package
+ * The add and put functions return 0 for success, -1 for failure
+ */
+int __eu_index_add_section(struct eu_package* p,struct uci_section* sec);
+void __eu_index_del_section(struct eu_package* p,struct uci_section* sec);
+int __eu_index_put_option(struct eu_package* p,struct uci_section* sec,struct uci_option* opt);
+void __eu_index_del_option(struct eu_package* p,struct uci_section* sec,const char* name);
+
+#endif /* _EASY_UCI_INTERNAL_H_ */
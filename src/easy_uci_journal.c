@@ -0,0 +1,638 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+/*
+ * A commit changing many packages is made all or nothing by a write-ahead journal in the confdir:
+ *  1. the new config files are written next to the old ones as hidden temp files and synced
+ *  2. the journal lists them and gets a commit line once they're all synced, which is the point of no return
+ *  3. the delta files folded into them are removed and the temp files renamed over the config files
+ *  4. the journal is removed
+ * A journal without its commit line is discarded with its temp files, one with it is finished by renaming the temp
+ * files still there. Both are idempotent, so a crash during recovery is recovered from the same way
+ */
+
+#define JOURNAL_NAME ".easy_uci.journal"
+//Taken before any package lock, so commits through the journal and recoveries don't run at once
+#define JOURNAL_LOCK "easy_uci.journal"
+#define JOURNAL_HEADER "easy_uci journal 1\n"
+#define JOURNAL_COMMIT "commit\n"
+#define JOURNAL_TEMP_SUFFIX ".easy_uci-new"
+//Way more than a journal of any sane transaction
+#define JOURNAL_MAX_SIZE (1024*1024)
+
+//The config dir generation this process has checked the confdir of, ULONG_MAX if none, accessed atomically
+static unsigned long recovered_gen=ULONG_MAX;
+
+struct eu_journal_entry
+{
+    //NULL when recovering
+    struct eu_package* p;
+    const char* name;
+    //The fd of the package lock, -1 if it's held for another entry
+    int lock;
+    size_t size;
+    char config[PATH_MAX];
+    //"" for a package given by path, which has no delta file
+    char delta[PATH_MAX];
+    char temp[PATH_MAX];
+};
+
+static const char* __base(const char* path)
+{
+    const char* base;
+
+    base=strrchr(path,'/');
+
+    return base==NULL?path:base+1;
+}
+
+/*
+ * Fill the paths of e for the package name like __eu_stamp_package() does
+ * Return 0 for success, -1 if the name can't be written to the journal
+ */
+static int __entry_paths(struct uci_context* ctx,struct eu_journal_entry* e,const char* name)
+{
+    int len;
+
+    e->name=name;
+    e->lock=-1;
+
+    if(name[0]=='/')
+    {
+        snprintf(e->config,sizeof(e->config),"%s",name);
+        e->delta[0]='\0';
+    }
+    else
+    {
+        snprintf(e->config,sizeof(e->config),"%s/%s",ctx->confdir,name);
+        snprintf(e->delta,sizeof(e->delta),"%s/%s",ctx->savedir,name);
+    }
+
+    //The temp file is in the dir of the config file, renaming it over the config file is atomic
+    len=(int)(__base(e->config)-e->config);
+    snprintf(e->temp,sizeof(e->temp),"%.*s.%s%s",len,e->config,__base(e->config),JOURNAL_TEMP_SUFFIX);
+
+    //The journal has a name per line
+    return strchr(name,'\n')!=NULL?-1:0;
+}
+
+static int __cmp_entry(const void* a,const void* b)
+{
+    return strcmp(__base(((const struct eu_journal_entry*)a)->config),__base(((const struct eu_journal_entry*)b)->config));
+}
+
+/*
+ * Lock the packages of the entries, which are sorted so every caller takes the locks in the same order
+ * Return 0 for success, -1 for failure
+ */
+static int __lock_entries(struct uci_context* ctx,struct eu_journal_entry* entries,size_t count)
+{
+    size_t i;
+
+    for(i=0;i<count;++i)
+    {
+        //Both a package of the confdir and one given by path may use the same lock file
+        if(i>0&&__cmp_entry(&entries[i-1],&entries[i])==0)
+        {
+            continue;
+        }
+
+        entries[i].lock=__eu_lock_package(ctx,entries[i].config);
+        if(entries[i].lock<0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void __unlock_entries(struct eu_journal_entry* entries,size_t count)
+{
+    size_t i;
+
+    for(i=0;i<count;++i)
+    {
+        if(entries[i].lock>=0)
+        {
+            close(entries[i].lock);
+            entries[i].lock=-1;
+        }
+    }
+}
+
+/*
+ * Sync the dir holding path, so a file created, renamed or removed in it stays that way after a crash
+ */
+static int __sync_dir(const char* path)
+{
+    int fd;
+    int ret;
+    char dir[PATH_MAX];
+
+    snprintf(dir,sizeof(dir),"%.*s",(int)(__base(path)-path),path);
+    fd=open(dir[0]=='\0'?".":dir,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if(fd<0)
+    {
+        return -1;
+    }
+
+    ret=fsync(fd);
+    close(fd);
+
+    return ret;
+}
+
+static int __write_all(int fd,const char* data,size_t len)
+{
+    ssize_t n;
+
+    while(len>0)
+    {
+        n=write(fd,data,len);
+        if(n<0&&errno==EINTR)
+        {
+            continue;
+        }
+        if(n<=0)
+        {
+            return -1;
+        }
+        data+=n;
+        len-=(size_t)n;
+    }
+
+    return 0;
+}
+
+/*
+ * Write the package of e to its temp file and sync it, the file gets the mode of the config file
+ * Return 0 for success, -1 for failure
+ */
+static int __write_temp(struct uci_context* ctx,struct eu_journal_entry* e)
+{
+    int fd;
+    int ret;
+    long size;
+    FILE* f;
+    struct stat st;
+
+    if(stat(e->config,&st)!=0)
+    {
+        st.st_mode=0644;
+    }
+
+    fd=open(e->temp,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,st.st_mode&0777);
+    if(fd<0)
+    {
+        return -1;
+    }
+
+    f=fdopen(fd,"w");
+    if(f==NULL)
+    {
+        close(fd);
+        return -1;
+    }
+
+    ret=uci_export(ctx,f,e->p->pkg,false);
+    size=ftell(f);
+    if(ret!=0||fflush(f)!=0||fsync(fd)!=0)
+    {
+        fclose(f);
+        return -1;
+    }
+    e->size=size>0?(size_t)size:0;
+
+    return fclose(f)==0?0:-1;
+}
+
+/*
+ * Finish a commit past its commit line, the temp files already renamed are skipped
+ * Return 0 for success, -1 for failure with the journal left for the next recovery
+ */
+static int __roll_forward(const char* journal,struct eu_journal_entry* entries,size_t count)
+{
+    size_t i;
+    bool removed=false;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    //The deltas are folded into the temp files, they go first so a temp file renamed never meets its delta again
+    for(i=0;i<count;++i)
+    {
+        if(entries[i].delta[0]!='\0'&&access(entries[i].temp,F_OK)==0&&unlink(entries[i].delta)==0)
+        {
+            removed=true;
+        }
+    }
+    for(i=0;removed&&i<count;++i)
+    {
+        if(entries[i].delta[0]!='\0')
+        {
+            __sync_dir(entries[i].delta);
+            break;
+        }
+    }
+
+    for(i=0;i<count;++i)
+    {
+        if(rename(entries[i].temp,entries[i].config)!=0&&errno!=ENOENT)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to replace the config file of package: '%s' with error: %s",entries[i].name,strerror(errno));
+            LogE(err_msg);
+            return -1;
+        }
+        easy_uci_cache_invalidate(entries[i].name);
+    }
+
+    //The journal must not go before the renames are durable, the config files of the confdir share its dir
+    for(i=0;i<count;++i)
+    {
+        if(entries[i].name[0]=='/'&&__sync_dir(entries[i].config)!=0)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Failed to sync the dir of package: '%s' with error: %s",entries[i].name,strerror(errno));
+            LogE(err_msg);
+            return -1;
+        }
+    }
+    if(__sync_dir(journal)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to sync the confdir with error: %s",strerror(errno));
+        LogE(err_msg);
+        return -1;
+    }
+
+    unlink(journal);
+
+    return 0;
+}
+
+/*
+ * Read the journal into *entries_p, the names of the entries point into *buff_p
+ * Return the number of entries, -1 if the journal can't be read
+ * *committed is set if the journal has its commit line
+ */
+static int __read_journal(struct uci_context* ctx,const char* journal,char** buff_p,struct eu_journal_entry** entries_p,bool* committed)
+{
+    int fd;
+    size_t n=0;
+    size_t count=0;
+    ssize_t got;
+    char* buff;
+    char* line;
+    char* end;
+    struct stat st;
+    struct eu_journal_entry* entries;
+
+    *committed=false;
+
+    fd=open(journal,O_RDONLY|O_CLOEXEC);
+    if(fd<0||fstat(fd,&st)!=0||st.st_size>JOURNAL_MAX_SIZE)
+    {
+        if(fd>=0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    buff=malloc((size_t)st.st_size+1);
+    if(buff==NULL)
+    {
+        close(fd);
+        return -1;
+    }
+
+    while(n<(size_t)st.st_size&&((got=read(fd,buff+n,(size_t)st.st_size-n))>0||(got<0&&errno==EINTR)))
+    {
+        n+=got>0?(size_t)got:0;
+    }
+    close(fd);
+    buff[n]='\0';
+
+    for(line=buff;*line!='\0';++line)
+    {
+        count+=*line=='\n';
+    }
+
+    entries=calloc(count>0?count:1,sizeof(struct eu_journal_entry));
+    if(entries==NULL)
+    {
+        free(buff);
+        return -1;
+    }
+
+    //A journal torn by a crash is discarded like one without its commit line, only complete lines are used
+    count=0;
+    if(strncmp(buff,JOURNAL_HEADER,strlen(JOURNAL_HEADER))==0)
+    {
+        for(line=buff+strlen(JOURNAL_HEADER);(end=strchr(line,'\n'))!=NULL;line=end+1)
+        {
+            if(strncmp(line,JOURNAL_COMMIT,strlen(JOURNAL_COMMIT))==0)
+            {
+                *committed=true;
+                break;
+            }
+
+            *end='\0';
+            if(line==end)
+            {
+                break;
+            }
+            __entry_paths(ctx,&entries[count++],line);
+        }
+    }
+
+    *buff_p=buff;
+    *entries_p=entries;
+
+    return (int)count;
+}
+
+/*
+ * Recover from the journal, called with the journal lock held
+ * Return 0 for success, -1 for failure
+ */
+static int __recover(struct uci_context* ctx,const char* journal)
+{
+    int ret=0;
+    int count;
+    size_t i;
+    bool committed;
+    char* buff=NULL;
+    struct eu_journal_entry* entries=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    count=__read_journal(ctx,journal,&buff,&entries,&committed);
+    if(count<0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to read journal: '%s' with error: %s",journal,strerror(errno));
+        LogE(err_msg);
+        return -1;
+    }
+
+    qsort(entries,(size_t)count,sizeof(struct eu_journal_entry),__cmp_entry);
+    if(__lock_entries(ctx,entries,(size_t)count)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to lock the packages of journal: '%s'",journal);
+        LogE(err_msg);
+        ret=-1;
+    }
+    else if(committed)
+    {
+        ret=__roll_forward(journal,entries,(size_t)count);
+    }
+    else
+    {
+        for(i=0;i<(size_t)count;++i)
+        {
+            unlink(entries[i].temp);
+        }
+        unlink(journal);
+    }
+
+    __unlock_entries(entries,(size_t)count);
+    free(entries);
+    free(buff);
+
+    return ret;
+}
+
+int __eu_journal_recover(struct uci_context* ctx)
+{
+    int ret=0;
+    int lock;
+    char journal[PATH_MAX];
+
+    //All a session open pays when there's nothing to recover
+    snprintf(journal,sizeof(journal),"%s/%s",ctx->confdir,JOURNAL_NAME);
+    if(access(journal,F_OK)!=0)
+    {
+        return 0;
+    }
+
+    lock=__eu_lock_package(ctx,JOURNAL_LOCK);
+    if(lock<0)
+    {
+        LogE("Failed to lock the journal");
+        return -1;
+    }
+
+    //Somebody else may have recovered while this waited for the lock
+    if(access(journal,F_OK)==0)
+    {
+        ret=__recover(ctx,journal);
+    }
+
+    close(lock);
+
+    return ret;
+}
+
+int __eu_journal_recover_once(struct uci_context* ctx,unsigned long gen)
+{
+    if(__atomic_load_n(&recovered_gen,__ATOMIC_ACQUIRE)==gen)
+    {
+        return 0;
+    }
+
+    if(__eu_journal_recover(ctx)!=0)
+    {
+        return -1;
+    }
+
+    //A journal left by another process after this is recovered by the next commit, not by session opens
+    __atomic_store_n(&recovered_gen,gen,__ATOMIC_RELEASE);
+
+    return 0;
+}
+
+int __eu_journal_commit(easy_uci_session* s)
+{
+    int fd=-1;
+    int lock;
+    size_t i;
+    size_t count=0;
+    size_t written=0;
+    bool replaced=true;
+    struct eu_package* p;
+    struct eu_journal_entry* entries;
+    struct eu_stamp stamp;
+    char journal[PATH_MAX];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
+
+    STATS_START(t);
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        count+=p->dirty;
+    }
+
+    entries=calloc(count,sizeof(struct eu_journal_entry));
+    if(entries==NULL)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        LogE("Failed to alloc journal");
+        return -1;
+    }
+
+    count=0;
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(!p->dirty)
+        {
+            continue;
+        }
+
+        entries[count].p=p;
+        if(__entry_paths(s->ctx,&entries[count],p->name)!=0)
+        {
+            free(entries);
+            snprintf(err_msg,sizeof(err_msg),"Package: '%s' can't be written through the journal",p->name);
+            LogE(err_msg);
+            return -1;
+        }
+        ++count;
+    }
+    qsort(entries,count,sizeof(struct eu_journal_entry),__cmp_entry);
+
+    lock=__eu_lock_package(s->ctx,JOURNAL_LOCK);
+    if(lock<0)
+    {
+        free(entries);
+        LogE("Failed to lock the journal");
+        return -1;
+    }
+
+    //Left by a crash since the session was opened, it must be finished before its packages change again
+    snprintf(journal,sizeof(journal),"%s/%s",s->ctx->confdir,JOURNAL_NAME);
+    if(access(journal,F_OK)==0&&__recover(s->ctx,journal)!=0)
+    {
+        goto error;
+    }
+
+    if(__lock_entries(s->ctx,entries,count)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to lock package: '%s'",entries[0].name);
+        LogE(err_msg);
+        goto error;
+    }
+
+    //The whole package is written, changes made by others since it was loaded would be lost
+    for(i=0;i<count;++i)
+    {
+        p=entries[i].p;
+        memset(&stamp,0,sizeof(stamp));
+        __eu_stamp_package(s->ctx,p->name,&stamp);
+        if(p->expect?__eu_stamp_version(&stamp)!=p->expected:!__eu_stamp_equal(&stamp,&p->stamp))
+        {
+            snprintf(err_msg,sizeof(err_msg),"Package: '%s' has changed since %s",p->name,
+                p->expect?"the version expected":"it was loaded");
+            LogE(err_msg);
+            s->conflict=true;
+            goto error;
+        }
+    }
+
+    //Listed before the temp files are made, so a crash from now on leaves nothing recovery doesn't know about
+    fd=open(journal,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0600);
+    if(fd<0||__write_all(fd,JOURNAL_HEADER,strlen(JOURNAL_HEADER))!=0)
+    {
+        goto error_io;
+    }
+    for(i=0;i<count;++i)
+    {
+        if(__write_all(fd,entries[i].name,strlen(entries[i].name))!=0||__write_all(fd,"\n",1)!=0)
+        {
+            goto error_io;
+        }
+    }
+
+    for(written=0;written<count;++written)
+    {
+        if(__write_temp(s->ctx,&entries[written])!=0)
+        {
+            goto error_io;
+        }
+    }
+
+    //One sync of the journal is the commit, with the dir sync making the journal and the temp files found again
+    if(__write_all(fd,JOURNAL_COMMIT,strlen(JOURNAL_COMMIT))!=0||fsync(fd)!=0||__sync_dir(journal)!=0)
+    {
+        goto error_io;
+    }
+    close(fd);
+    fd=-1;
+
+    for(i=0;i<count;++i)
+    {
+        if(entries[i].name[0]=='/'&&__sync_dir(entries[i].temp)!=0)
+        {
+            //Past the commit line, recovery would miss a temp file that isn't durable
+            goto error_io;
+        }
+    }
+
+    //Past the commit line the transaction stands, whatever isn't replaced now is left to the next recovery
+    if(__roll_forward(journal,entries,count)!=0)
+    {
+        replaced=false;
+        __atomic_store_n(&recovered_gen,ULONG_MAX,__ATOMIC_RELEASE);
+    }
+
+    for(i=0;i<count;++i)
+    {
+        p=entries[i].p;
+        STATS_COMMIT(t,p->name,true,entries[i].size);
+        if(replaced)
+        {
+            //The snapshot is stamped with the config file just renamed, not the one the package was loaded from
+            __eu_stamp_package(s->ctx,p->name,&p->stamp);
+            __eu_snapshot_refresh(p,entries[i].config);
+        }
+        //p->pkg still has the changes as deltas, the package is loaded again from what was written on next use
+        p->dirty=false;
+        __eu_session_drop(s,p);
+    }
+
+    __unlock_entries(entries,count);
+    close(lock);
+    free(entries);
+
+    return 0;
+
+error_io:
+    snprintf(err_msg,sizeof(err_msg),"Failed to write the journal with error: %s",strerror(errno));
+    LogE(err_msg);
+    if(fd>=0)
+    {
+        close(fd);
+    }
+    //Not committed, nothing has changed
+    for(i=0;i<written;++i)
+    {
+        unlink(entries[i].temp);
+    }
+    unlink(journal);
+error:
+    s->ctx->err=UCI_ERR_IO;
+    for(i=0;i<count;++i)
+    {
+        STATS_COMMIT(t,entries[i].p->name,false,0);
+    }
+    __unlock_entries(entries,count);
+    close(lock);
+    free(entries);
+    return -1;
+}
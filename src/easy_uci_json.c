@@ -0,0 +1,1130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define JSON_BUFF_SIZE 65536
+#define JSON_MAX_DEPTH_ERROR "Nested values are not supported"
+
+/*
+ * Export
+ * The document is written through a fixed buffer, its size doesn't depend on the package
+ */
+
+struct eu_json_writer
+{
+    int fd;
+    size_t len;
+    bool failed;
+    char buff[JSON_BUFF_SIZE];
+};
+
+static void __flush(struct eu_json_writer* w)
+{
+    size_t done=0;
+    ssize_t n;
+
+    while(done<w->len&&!w->failed)
+    {
+        n=write(w->fd,w->buff+done,w->len-done);
+        if(n<0&&errno==EINTR)
+        {
+            continue;
+        }
+        if(n<=0)
+        {
+            w->failed=true;
+            break;
+        }
+        done+=(size_t)n;
+    }
+
+    w->len=0;
+}
+
+static void __put(struct eu_json_writer* w,const char* data,size_t len)
+{
+    size_t n;
+
+    while(len>0)
+    {
+        if(w->len==sizeof(w->buff))
+        {
+            __flush(w);
+        }
+
+        n=sizeof(w->buff)-w->len;
+        n=n<len?n:len;
+        memcpy(w->buff+w->len,data,n);
+        w->len+=n;
+        data+=n;
+        len-=n;
+    }
+}
+
+static void __puts(struct eu_json_writer* w,const char* str)
+{
+    __put(w,str,strlen(str));
+}
+
+static void __put_string(struct eu_json_writer* w,const char* str)
+{
+    const char* run;
+    char esc[8];
+
+    __put(w,"\"",1);
+
+    //Runs of chars needing no escape are copied at once
+    for(run=str;*str!='\0';++str)
+    {
+        if(*str!='"'&&*str!='\\'&&(unsigned char)*str>=0x20)
+        {
+            continue;
+        }
+
+        __put(w,run,str-run);
+        if(*str=='"'||*str=='\\')
+        {
+            esc[0]='\\';
+            esc[1]=*str;
+            __put(w,esc,2);
+        }
+        else if(*str=='\n')
+        {
+            __put(w,"\\n",2);
+        }
+        else if(*str=='\t')
+        {
+            __put(w,"\\t",2);
+        }
+        else
+        {
+            snprintf(esc,sizeof(esc),"\\u%04x",(unsigned char)*str);
+            __put(w,esc,6);
+        }
+        run=str+1;
+    }
+    __put(w,run,str-run);
+
+    __put(w,"\"",1);
+}
+
+int easy_uci_session_export_json(easy_uci_session* s,const char* package,int fd)
+{
+    bool first=true;
+    struct eu_package* p;
+    struct eu_json_writer* w;
+    struct uci_section* sec;
+    struct uci_option* opt;
+    struct uci_element* se;
+    struct uci_element* oe;
+    struct uci_element* e;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        uci_get_errorstr(s->ctx,&err_str,err_msg);
+        LogE(err_str);
+        free(err_str);
+        return -1;
+    }
+
+    //Too large for the stack of some threads
+    w=malloc(sizeof(struct eu_json_writer));
+    if(w==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        LogE(err_msg);
+        return -1;
+    }
+    w->fd=fd;
+    w->len=0;
+    w->failed=false;
+
+    //One section per line, options in file order
+    __put(w,"{",1);
+    uci_foreach_element(&p->pkg->sections,se)
+    {
+        sec=uci_to_section(se);
+        __puts(w,first?"\n":",\n");
+        first=false;
+
+        __put_string(w,se->name);
+        __puts(w,":{\".type\":");
+        __put_string(w,sec->type);
+        __puts(w,sec->anonymous?",\".anonymous\":true":",\".anonymous\":false");
+
+        uci_foreach_element(&sec->options,oe)
+        {
+            opt=uci_to_option(oe);
+            __put(w,",",1);
+            __put_string(w,oe->name);
+            __put(w,":",1);
+
+            if(opt->type==UCI_TYPE_STRING)
+            {
+                __put_string(w,opt->v.string);
+                continue;
+            }
+
+            __put(w,"[",1);
+            uci_foreach_element(&opt->v.list,e)
+            {
+                if(e->list.prev!=&opt->v.list)
+                {
+                    __put(w,",",1);
+                }
+                __put_string(w,e->name);
+            }
+            __put(w,"]",1);
+        }
+
+        __put(w,"}",1);
+    }
+    __puts(w,"\n}\n");
+    __flush(w);
+
+    if(w->failed)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to write package: '%s' with error: %s",package,strerror(errno));
+        LogE(err_msg);
+        free(w);
+        return -1;
+    }
+
+    free(w);
+
+    return 0;
+}
+
+int easy_uci_export_json(const char* package,int fd)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_export_json(s,package,fd);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+/*
+ * Import
+ * The document is read through a fixed buffer, only one section is held in memory at a time
+ */
+
+struct eu_json_reader
+{
+    int fd;
+    size_t pos;
+    size_t len;
+    //Bytes read before buff, to tell where the document is malformed
+    size_t offset;
+    bool eof;
+    char buff[JSON_BUFF_SIZE];
+};
+
+struct eu_json_str
+{
+    char* data;
+    size_t len;
+    size_t cap;
+};
+
+struct eu_json_option
+{
+    char* name;
+    //NULL for a null value, which deletes the option
+    char** values;
+    size_t len;
+    bool list;
+};
+
+struct eu_json_section
+{
+    char* name;
+    char* type;
+    bool anonymous;
+    struct eu_json_option* opts;
+    size_t len;
+    size_t cap;
+};
+
+/*
+ * Return the next char, -1 at the end of the document
+ */
+static int __getc(struct eu_json_reader* r)
+{
+    ssize_t n;
+
+    if(r->pos==r->len)
+    {
+        if(r->eof)
+        {
+            return -1;
+        }
+
+        r->offset+=r->len;
+        r->pos=0;
+        r->len=0;
+        do
+        {
+            n=read(r->fd,r->buff,sizeof(r->buff));
+        }
+        while(n<0&&errno==EINTR);
+
+        if(n<=0)
+        {
+            r->eof=true;
+            return -1;
+        }
+        r->len=(size_t)n;
+    }
+
+    return (unsigned char)r->buff[r->pos++];
+}
+
+/*
+ * Skip whitespace and return the next char without consuming it, -1 at the end of the document
+ */
+static int __peek(struct eu_json_reader* r)
+{
+    int c;
+
+    do
+    {
+        c=__getc(r);
+    }
+    while(c==' '||c=='\t'||c=='\n'||c=='\r');
+
+    if(c>=0)
+    {
+        --r->pos;
+    }
+
+    return c;
+}
+
+static bool __expect(struct eu_json_reader* r,int c)
+{
+    if(__peek(r)!=c)
+    {
+        return false;
+    }
+
+    ++r->pos;
+    return true;
+}
+
+static int __str_putc(struct eu_json_str* str,char c)
+{
+    char* data;
+    size_t cap;
+
+    if(str->len+1>=str->cap)
+    {
+        cap=str->cap==0?64:str->cap*2;
+        data=realloc(str->data,cap);
+        if(data==NULL)
+        {
+            return -1;
+        }
+        str->data=data;
+        str->cap=cap;
+    }
+
+    str->data[str->len++]=c;
+    str->data[str->len]='\0';
+
+    return 0;
+}
+
+static int __str_put_utf8(struct eu_json_str* str,unsigned long cp)
+{
+    if(cp<0x80)
+    {
+        return __str_putc(str,(char)cp);
+    }
+    if(cp<0x800)
+    {
+        return __str_putc(str,(char)(0xc0|(cp>>6)))|__str_putc(str,(char)(0x80|(cp&0x3f)));
+    }
+    if(cp<0x10000)
+    {
+        return __str_putc(str,(char)(0xe0|(cp>>12)))|__str_putc(str,(char)(0x80|((cp>>6)&0x3f)))|
+            __str_putc(str,(char)(0x80|(cp&0x3f)));
+    }
+
+    return __str_putc(str,(char)(0xf0|(cp>>18)))|__str_putc(str,(char)(0x80|((cp>>12)&0x3f)))|
+        __str_putc(str,(char)(0x80|((cp>>6)&0x3f)))|__str_putc(str,(char)(0x80|(cp&0x3f)));
+}
+
+static long __hex4(struct eu_json_reader* r)
+{
+    int i,c;
+    long v=0;
+
+    for(i=0;i<4;++i)
+    {
+        c=__getc(r);
+        if(c>='0'&&c<='9')
+        {
+            v=v*16+c-'0';
+        }
+        else if((c|0x20)>='a'&&(c|0x20)<='f')
+        {
+            v=v*16+(c|0x20)-'a'+10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return v;
+}
+
+/*
+ * Parse a string into a new '\0' terminated copy
+ * Return NULL if it's malformed or for failure
+ */
+static char* __parse_string(struct eu_json_reader* r)
+{
+    int c;
+    long cp,low;
+    struct eu_json_str str={NULL,0,0};
+
+    if(!__expect(r,'"')||__str_putc(&str,'\0')!=0)
+    {
+        return NULL;
+    }
+    str.len=0;
+
+    while((c=__getc(r))!='"')
+    {
+        if(c<0x20)
+        {
+            goto error;
+        }
+
+        if(c!='\\')
+        {
+            if(__str_putc(&str,(char)c)!=0)
+            {
+                goto error;
+            }
+            continue;
+        }
+
+        c=__getc(r);
+        switch(c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case 'b':
+            c='\b';
+            break;
+        case 'f':
+            c='\f';
+            break;
+        case 'n':
+            c='\n';
+            break;
+        case 'r':
+            c='\r';
+            break;
+        case 't':
+            c='\t';
+            break;
+        case 'u':
+            cp=__hex4(r);
+            if(cp>=0xd800&&cp<0xdc00)
+            {
+                if(__getc(r)!='\\'||__getc(r)!='u'||(low=__hex4(r))<0xdc00||low>0xdfff)
+                {
+                    goto error;
+                }
+                cp=0x10000+((cp-0xd800)<<10)+(low-0xdc00);
+            }
+            //Values are '\0' terminated in the package
+            if(cp<=0||(cp>=0xdc00&&cp<0xe000)||__str_put_utf8(&str,(unsigned long)cp)!=0)
+            {
+                goto error;
+            }
+            continue;
+        default:
+            goto error;
+        }
+
+        if(__str_putc(&str,(char)c)!=0)
+        {
+            goto error;
+        }
+    }
+
+    return str.data;
+
+error:
+    free(str.data);
+    return NULL;
+}
+
+/*
+ * Whether a number is -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? as JSON has it
+ */
+static bool __valid_number(const char* num)
+{
+    if(*num=='-')
+    {
+        ++num;
+    }
+
+    if(*num=='0')
+    {
+        ++num;
+    }
+    else if(*num>='1'&&*num<='9')
+    {
+        for(;*num>='0'&&*num<='9';++num);
+    }
+    else
+    {
+        return false;
+    }
+
+    if(*num=='.')
+    {
+        ++num;
+        if(*num<'0'||*num>'9')
+        {
+            return false;
+        }
+        for(;*num>='0'&&*num<='9';++num);
+    }
+
+    if(*num=='e'||*num=='E')
+    {
+        ++num;
+        if(*num=='+'||*num=='-')
+        {
+            ++num;
+        }
+        if(*num<'0'||*num>'9')
+        {
+            return false;
+        }
+        for(;*num>='0'&&*num<='9';++num);
+    }
+
+    return *num=='\0';
+}
+
+/*
+ * Parse a value that isn't an object or an array: numbers are kept as written, true and false become "1" and "0"
+ * Return 0 for success with *value_p set to NULL for null, -1 if it's malformed or for failure
+ */
+static int __parse_scalar(struct eu_json_reader* r,char** value_p)
+{
+    int c;
+    size_t i;
+    char word[8];
+    struct eu_json_str str={NULL,0,0};
+
+    c=__peek(r);
+    if(c=='"')
+    {
+        *value_p=__parse_string(r);
+        return *value_p==NULL?-1:0;
+    }
+
+    if(c=='-'||(c>='0'&&c<='9'))
+    {
+        while((c=__getc(r))=='-'||c=='+'||c=='.'||c=='e'||c=='E'||(c>='0'&&c<='9'))
+        {
+            if(__str_putc(&str,(char)c)!=0)
+            {
+                free(str.data);
+                return -1;
+            }
+        }
+        if(c>=0)
+        {
+            --r->pos;
+        }
+        if(!__valid_number(str.data))
+        {
+            free(str.data);
+            return -1;
+        }
+        *value_p=str.data;
+        return 0;
+    }
+
+    for(i=0;i<sizeof(word)-1&&(c=__getc(r))>='a'&&c<='z';++i)
+    {
+        word[i]=(char)c;
+    }
+    if(c>=0&&(c<'a'||c>'z'))
+    {
+        --r->pos;
+    }
+    word[i]='\0';
+
+    *value_p=NULL;
+    if(strcmp(word,"null")==0)
+    {
+        return 0;
+    }
+    if(strcmp(word,"true")==0||strcmp(word,"false")==0)
+    {
+        *value_p=strdup(word[0]=='t'?"1":"0");
+        return *value_p==NULL?-1:0;
+    }
+
+    return -1;
+}
+
+static void __section_clear(struct eu_json_section* js)
+{
+    size_t i,j;
+
+    for(i=0;i<js->len;++i)
+    {
+        free(js->opts[i].name);
+        for(j=0;js->opts[i].values!=NULL&&j<js->opts[i].len;++j)
+        {
+            free(js->opts[i].values[j]);
+        }
+        free(js->opts[i].values);
+    }
+    free(js->opts);
+    free(js->name);
+    free(js->type);
+    memset(js,0,sizeof(struct eu_json_section));
+}
+
+/*
+ * Parse the value of an option into a new option of js
+ * Return 0 for success, -1 if it's malformed or for failure
+ */
+static int __parse_option(struct eu_json_reader* r,struct eu_json_section* js,char* name)
+{
+    size_t cap=0;
+    char* value;
+    char** values;
+    struct eu_json_option* o;
+
+    if(js->len==js->cap)
+    {
+        o=realloc(js->opts,sizeof(struct eu_json_option)*(js->cap==0?8:js->cap*2));
+        if(o==NULL)
+        {
+            free(name);
+            return -1;
+        }
+        js->opts=o;
+        js->cap=js->cap==0?8:js->cap*2;
+    }
+
+    o=&js->opts[js->len++];
+    memset(o,0,sizeof(struct eu_json_option));
+    o->name=name;
+
+    if(!__expect(r,'['))
+    {
+        if(__parse_scalar(r,&value)!=0)
+        {
+            return -1;
+        }
+        if(value!=NULL)
+        {
+            o->values=malloc(sizeof(char*));
+            if(o->values==NULL)
+            {
+                free(value);
+                return -1;
+            }
+            o->values[0]=value;
+            o->len=1;
+        }
+        return 0;
+    }
+
+    //An empty list is an empty array, not a NULL one
+    o->list=true;
+    o->values=malloc(sizeof(char*));
+    if(o->values==NULL)
+    {
+        return -1;
+    }
+    cap=1;
+
+    if(__expect(r,']'))
+    {
+        return 0;
+    }
+
+    do
+    {
+        if(__parse_scalar(r,&value)!=0||value==NULL)
+        {
+            free(value);
+            return -1;
+        }
+
+        if(o->len==cap)
+        {
+            values=realloc(o->values,sizeof(char*)*cap*2);
+            if(values==NULL)
+            {
+                free(value);
+                return -1;
+            }
+            o->values=values;
+            cap*=2;
+        }
+        o->values[o->len++]=value;
+    }
+    while(__expect(r,','));
+
+    return __expect(r,']')?0:-1;
+}
+
+/*
+ * Parse the object of a section, keys starting with '.' other than .type and .anonymous are ignored like .name and
+ * .index of the uci ubus object
+ * Return 0 for success, -1 if it's malformed or for failure
+ */
+static int __parse_section(struct eu_json_reader* r,struct eu_json_section* js)
+{
+    char* key;
+    char* value;
+
+    if(!__expect(r,'{'))
+    {
+        return -1;
+    }
+
+    if(__expect(r,'}'))
+    {
+        return 0;
+    }
+
+    do
+    {
+        key=__parse_string(r);
+        if(key==NULL||!__expect(r,':'))
+        {
+            free(key);
+            return -1;
+        }
+
+        if(key[0]!='.')
+        {
+            if(__parse_option(r,js,key)!=0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        if(__peek(r)=='{'||__peek(r)=='['||__parse_scalar(r,&value)!=0)
+        {
+            LogE(JSON_MAX_DEPTH_ERROR);
+            free(key);
+            return -1;
+        }
+
+        if(strcmp(key,".type")==0)
+        {
+            free(js->type);
+            js->type=value;
+        }
+        else
+        {
+            if(strcmp(key,".anonymous")==0)
+            {
+                js->anonymous=value!=NULL&&strcmp(value,"1")==0;
+            }
+            free(value);
+        }
+        free(key);
+    }
+    while(__expect(r,','));
+
+    return __expect(r,'}')?0:-1;
+}
+
+static bool __same(struct uci_option* opt,const struct eu_json_option* o)
+{
+    size_t i=0;
+    struct uci_element* e;
+
+    if(!o->list)
+    {
+        return opt->type==UCI_TYPE_STRING&&strcmp(opt->v.string,o->values[0])==0;
+    }
+
+    if(opt->type!=UCI_TYPE_LIST)
+    {
+        return false;
+    }
+
+    uci_foreach_element(&opt->v.list,e)
+    {
+        if(i==o->len||strcmp(e->name,o->values[i])!=0)
+        {
+            return false;
+        }
+        ++i;
+    }
+
+    return i==o->len;
+}
+
+/*
+ * Make a section of the package what js says
+ * Return the section for success, NULL for failure
+ */
+static struct uci_section* __apply_section(easy_uci_session* s,const char* package,struct eu_json_section* js,int mode)
+{
+    size_t i,j,count=0;
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option* opt;
+    struct uci_element* e;
+    char** stale=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    easy_uci_list list;
+
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
+    {
+        return NULL;
+    }
+
+    sec=__eu_index_section(p,js->name);
+
+    //A section can't change its type in place
+    if(sec!=NULL&&js->type!=NULL&&strcmp(sec->type,js->type)!=0)
+    {
+        if(easy_uci_session_delete_section(s,package,js->name)!=0)
+        {
+            return NULL;
+        }
+        sec=NULL;
+    }
+
+    if(sec==NULL)
+    {
+        if(js->type==NULL)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Section: '%s' has no .type",js->name);
+            LogE(err_msg);
+            return NULL;
+        }
+
+        //An anonymous section gets a name of its own, it's the last one of its type
+        if(easy_uci_session_add_section(s,package,js->type,js->anonymous?NULL:js->name)!=0)
+        {
+            return NULL;
+        }
+        sec=js->anonymous?__eu_index_nth_of_type(p,js->type,-1):__eu_index_section(p,js->name);
+        if(sec==NULL)
+        {
+            return NULL;
+        }
+    }
+
+    for(i=0;i<js->len;++i)
+    {
+        opt=__eu_index_option(p,sec,js->opts[i].name);
+
+        //Values already there are left alone, which keeps a sync of an unchanged package free of writes
+        if(js->opts[i].values==NULL||(js->opts[i].list&&js->opts[i].len==0))
+        {
+            if(opt!=NULL&&easy_uci_session_delete_option(s,package,sec->e.name,js->opts[i].name)!=0)
+            {
+                return NULL;
+            }
+        }
+        else if(opt==NULL||!__same(opt,&js->opts[i]))
+        {
+            if(js->opts[i].list)
+            {
+                list.list=(const char**)js->opts[i].values;
+                list.len=js->opts[i].len;
+                if(easy_uci_session_set_option_list(s,package,sec->e.name,js->opts[i].name,&list)!=0)
+                {
+                    return NULL;
+                }
+            }
+            else if(easy_uci_session_set_option_string(s,package,sec->e.name,js->opts[i].name,js->opts[i].values[0])!=0)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    if(mode!=EASY_UCI_IMPORT_REPLACE)
+    {
+        return sec;
+    }
+
+    //Options not in the document, collected first as deleting them changes the list
+    uci_foreach_element(&sec->options,e)
+    {
+        ++count;
+    }
+    stale=malloc(sizeof(char*)*(count>0?count:1));
+    if(stale==NULL)
+    {
+        return NULL;
+    }
+
+    count=0;
+    uci_foreach_element(&sec->options,e)
+    {
+        for(j=0;j<js->len&&strcmp(js->opts[j].name,e->name)!=0;++j);
+        if(j==js->len)
+        {
+            stale[count++]=e->name;
+        }
+    }
+
+    for(i=0;i<count;++i)
+    {
+        if(easy_uci_session_delete_option(s,package,sec->e.name,stale[i])!=0)
+        {
+            free(stale);
+            return NULL;
+        }
+    }
+    free(stale);
+
+    return sec;
+}
+
+static int __cmp_ptr(const void* a,const void* b)
+{
+    uintptr_t x=(uintptr_t)*(void* const*)a;
+    uintptr_t y=(uintptr_t)*(void* const*)b;
+
+    return x<y?-1:x>y;
+}
+
+/*
+ * Delete the sections of the package not in seen, which is sorted
+ * Return 0 for success, -1 for failure
+ */
+static int __delete_unseen(easy_uci_session* s,const char* package,struct uci_section** seen,size_t count)
+{
+    int ret=0;
+    size_t i,n=0;
+    struct eu_package* p;
+    struct uci_element* e;
+    struct uci_section* sec;
+    char** stale;
+
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
+    {
+        return -1;
+    }
+
+    stale=malloc(sizeof(char*)*(p->sections.count>0?p->sections.count:1));
+    if(stale==NULL)
+    {
+        return -1;
+    }
+
+    uci_foreach_element(&p->pkg->sections,e)
+    {
+        sec=uci_to_section(e);
+        if(count==0||bsearch(&sec,seen,count,sizeof(struct uci_section*),__cmp_ptr)==NULL)
+        {
+            //Names are freed by the deletes, copy them
+            stale[n]=strdup(e->name);
+            if(stale[n]==NULL)
+            {
+                ret=-1;
+                break;
+            }
+            ++n;
+        }
+    }
+
+    for(i=0;i<n;++i)
+    {
+        if(ret==0&&easy_uci_session_delete_section(s,package,stale[i])!=0)
+        {
+            ret=-1;
+        }
+        free(stale[i]);
+    }
+    free(stale);
+
+    return ret;
+}
+
+int easy_uci_session_import_json(easy_uci_session* s,const char* package,int fd,int mode)
+{
+    int ret=-1;
+    bool own;
+    size_t count=0;
+    size_t cap=0;
+    struct eu_json_reader* r;
+    struct eu_json_section js;
+    struct uci_section* sec;
+    struct uci_section** seen=NULL;
+    struct uci_section** grown;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    memset(&js,0,sizeof(js));
+
+    r=malloc(sizeof(struct eu_json_reader));
+    if(r==NULL)
+    {
+        __eu_session_fail(s);
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        LogE(err_msg);
+        return -1;
+    }
+    r->fd=fd;
+    r->pos=0;
+    r->len=0;
+    r->offset=0;
+    r->eof=false;
+
+    //Part of the transaction already open, or one of its own committed once
+    own=!s->in_txn;
+    if(own&&easy_uci_session_begin(s)!=0)
+    {
+        free(r);
+        return -1;
+    }
+
+    if(!__expect(r,'{'))
+    {
+        goto error_json;
+    }
+
+    if(!__expect(r,'}'))
+    {
+        do
+        {
+            js.name=__parse_string(r);
+            if(js.name==NULL||!__expect(r,':')||__parse_section(r,&js)!=0)
+            {
+                goto error_json;
+            }
+
+            sec=__apply_section(s,package,&js,mode);
+            if(sec==NULL)
+            {
+                goto error;
+            }
+            __section_clear(&js);
+
+            if(count==cap)
+            {
+                cap=cap==0?64:cap*2;
+                grown=realloc(seen,sizeof(struct uci_section*)*cap);
+                if(grown==NULL)
+                {
+                    goto error;
+                }
+                seen=grown;
+            }
+            seen[count++]=sec;
+        }
+        while(__expect(r,','));
+
+        if(!__expect(r,'}'))
+        {
+            goto error_json;
+        }
+    }
+
+    if(__peek(r)!=-1)
+    {
+        goto error_json;
+    }
+
+    if(mode==EASY_UCI_IMPORT_REPLACE)
+    {
+        if(count>0)
+        {
+            qsort(seen,count,sizeof(struct uci_section*),__cmp_ptr);
+        }
+        if(__delete_unseen(s,package,seen,count)!=0)
+        {
+            goto error;
+        }
+    }
+
+    ret=own?easy_uci_session_commit(s):0;
+    if(ret!=0)
+    {
+        ret=-1;
+    }
+    free(seen);
+    free(r);
+
+    return ret;
+
+error_json:
+    snprintf(err_msg,sizeof(err_msg),"Malformed JSON for package: '%s' at byte %zu",package,r->offset+r->pos);
+    LogE(err_msg);
+error:
+    __section_clear(&js);
+    free(seen);
+    free(r);
+    __eu_session_fail(s);
+    if(own)
+    {
+        easy_uci_session_rollback(s);
+    }
+    return -1;
+}
+
+int easy_uci_import_json(const char* package,int fd,int mode)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    //The rollback of a failed import drops every dirty package, including those queued for the writer
+    if(s->deferred)
+    {
+        __eu_writer_commit();
+    }
+
+    ret=easy_uci_session_import_json(s,package,fd,mode);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
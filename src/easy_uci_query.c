@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+static bool __match_value(const easy_uci_predicate* pred,const char* value)
+{
+    if(pred->match==EASY_UCI_MATCH_PREFIX)
+    {
+        return strncmp(value,pred->value,strlen(pred->value))==0;
+    }
+
+    return strcmp(value,pred->value)==0;
+}
+
+static bool __match(struct eu_package* p,struct uci_section* sec,const easy_uci_predicate* preds,size_t count)
+{
+    size_t i;
+    struct uci_option* opt;
+    struct uci_element* e;
+
+    for(i=0;i<count;++i)
+    {
+        opt=__eu_index_option(p,sec,preds[i].option);
+        if(opt==NULL)
+        {
+            return false;
+        }
+
+        if(opt->type==UCI_TYPE_STRING)
+        {
+            if(!__match_value(&preds[i],opt->v.string))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        uci_foreach_element(&opt->v.list,e)
+        {
+            if(__match_value(&preds[i],e->name))
+            {
+                break;
+            }
+        }
+        if(&e->list==&opt->v.list)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool __indexed(easy_uci_session* s,const char* package,const char* type,const char* option)
+{
+    struct eu_index_def* d;
+
+    for(d=s->index_defs;d!=NULL;d=d->next)
+    {
+        if(strcmp(d->package,package)==0&&strcmp(d->type,type)==0&&strcmp(d->option,option)==0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Narrow the sections to scan to those of a value index, if an equality predicate has one
+ * Return true if *tl_p was set, which is NULL when no section has the value
+ */
+static bool __candidates(easy_uci_session* s,struct eu_package* p,const char* type,const easy_uci_predicate* preds,size_t count,struct eu_type_list** tl_p)
+{
+    size_t i;
+
+    for(i=0;i<count;++i)
+    {
+        //Failing to build the index falls back to a scan
+        if(preds[i].match==EASY_UCI_MATCH_EQUAL&&__indexed(s,p->name,type,preds[i].option)&&
+            __eu_index_values(p,type,preds[i].option,preds[i].value,tl_p)==0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int easy_uci_session_find_sections(easy_uci_session* s,const char* package,const char* type,const easy_uci_predicate* preds,size_t count,easy_uci_list* list_p)
+{
+    size_t i,len;
+    size_t found=0;
+    size_t bytes=0;
+    struct eu_package* p;
+    struct eu_type_list* tl=NULL;
+    struct uci_section** secs;
+    struct uci_section** matches;
+    struct uci_element* e;
+    easy_uci_list list;
+    char* buff;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    //The sections to scan: those of a value index, those of the type, or all of them
+    if(type!=NULL)
+    {
+        if(!__candidates(s,p,type,preds,count,&tl))
+        {
+            tl=__eu_index_type(p,type);
+        }
+        secs=tl==NULL?NULL:tl->secs;
+        len=tl==NULL?0:tl->len;
+    }
+    else
+    {
+        secs=NULL;
+        len=p->sections.count;
+    }
+
+    matches=malloc(sizeof(struct uci_section*)*(len>0?len:1));
+    if(matches==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        goto error_msg;
+    }
+
+    if(type!=NULL)
+    {
+        for(i=0;i<len;++i)
+        {
+            if(__match(p,secs[i],preds,count))
+            {
+                matches[found++]=secs[i];
+            }
+        }
+    }
+    else
+    {
+        uci_foreach_element(&p->pkg->sections,e)
+        {
+            if(found<len&&__match(p,uci_to_section(e),preds,count))
+            {
+                matches[found++]=uci_to_section(e);
+            }
+        }
+    }
+
+    if(found==0)
+    {
+        free(matches);
+        list_p->list=NULL;
+        list_p->len=0;
+        return 0;
+    }
+
+    for(i=0;i<found;++i)
+    {
+        bytes+=strlen(matches[i]->e.name)+1;
+    }
+
+    buff=__eu_list_alloc(&list,found,bytes);
+    if(buff==NULL)
+    {
+        free(matches);
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        goto error_msg;
+    }
+
+    for(i=0;i<found;++i)
+    {
+        len=strlen(matches[i]->e.name)+1;
+        memcpy(buff,matches[i]->e.name,len);
+        list.list[i]=buff;
+        buff+=len;
+    }
+    free(matches);
+
+    *list_p=list;
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_find_sections(const char* package,const char* type,const easy_uci_predicate* preds,size_t count,easy_uci_list* list_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_find_sections(s,package,type,preds,count,list_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_session_index_option(easy_uci_session* s,const char* package,const char* type,const char* option)
+{
+    struct eu_index_def* d;
+
+    if(__indexed(s,package,type,option))
+    {
+        return 0;
+    }
+
+    d=calloc(1,sizeof(struct eu_index_def));
+    if(d==NULL)
+    {
+        LogE("Failed to alloc index");
+        return -1;
+    }
+
+    d->package=strdup(package);
+    d->type=strdup(type);
+    d->option=strdup(option);
+    if(d->package==NULL||d->type==NULL||d->option==NULL)
+    {
+        free(d->package);
+        free(d->type);
+        free(d->option);
+        free(d);
+        LogE("Failed to alloc index");
+        return -1;
+    }
+
+    d->next=s->index_defs;
+    s->index_defs=d;
+
+    return 0;
+}
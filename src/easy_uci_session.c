@@ -0,0 +1,797 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+//Guards conf_dir and save_dir
+static pthread_mutex_t config_lock=PTHREAD_MUTEX_INITIALIZER;
+static char* conf_dir=NULL;
+static char* save_dir=NULL;
+//Bumped when the dirs change, so the new confdir is checked for a journal, guarded by config_lock
+static unsigned long config_gen=0;
+//Accessed atomically
+static bool stage_writes=false;
+
+int easy_uci_set_config_dir(const char* confdir,const char* savedir)
+{
+    char* c=NULL;
+    char* v=NULL;
+
+    if((confdir!=NULL&&(c=strdup(confdir))==NULL)||(savedir!=NULL&&(v=strdup(savedir))==NULL))
+    {
+        free(c);
+        LogE("Failed to set config dir");
+        return -1;
+    }
+
+    pthread_mutex_lock(&config_lock);
+    free(conf_dir);
+    free(save_dir);
+    conf_dir=c;
+    save_dir=v;
+    ++config_gen;
+    pthread_mutex_unlock(&config_lock);
+
+    //Cached copies of packages in the old dirs would never be read again
+    __eu_cache_drop_all();
+
+    return 0;
+}
+
+void easy_uci_stage_enable(bool enable)
+{
+    __atomic_store_n(&stage_writes,enable,__ATOMIC_RELAXED);
+}
+
+void easy_uci_session_stage_enable(easy_uci_session* s,bool enable)
+{
+    s->staged=enable;
+}
+
+easy_uci_session* easy_uci_session_open(void)
+{
+    bool ret;
+    unsigned long gen;
+    easy_uci_session* s;
+
+    s=calloc(1,sizeof(easy_uci_session));
+    if(s==NULL)
+    {
+        LogE("Failed to alloc session");
+        return NULL;
+    }
+
+    s->ctx=uci_alloc_context();
+    if(s->ctx==NULL)
+    {
+        free(s);
+        LogE("Failed to alloc uci context");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&config_lock);
+    ret=(conf_dir!=NULL&&uci_set_confdir(s->ctx,conf_dir)!=0)||(save_dir!=NULL&&uci_set_savedir(s->ctx,save_dir)!=0);
+    gen=config_gen;
+    pthread_mutex_unlock(&config_lock);
+
+    if(ret)
+    {
+        uci_free_context(s->ctx);
+        free(s);
+        LogE("Failed to set config dir of uci context");
+        return NULL;
+    }
+
+    s->staged=__atomic_load_n(&stage_writes,__ATOMIC_RELAXED);
+
+    //A failure is logged, the packages of the journal stay as they were until it's recovered
+    __eu_journal_recover_once(s->ctx,gen);
+
+    return s;
+}
+
+void easy_uci_session_close(easy_uci_session* s)
+{
+    struct eu_package* p;
+    struct eu_package* next;
+    struct eu_index_def* d;
+
+    if(s==NULL)
+    {
+        return;
+    }
+
+    //Changes of an unfinished transaction are discarded along with the packages
+    for(p=s->packages;p!=NULL;p=next)
+    {
+        next=p->next;
+        __eu_index_free(p);
+        __eu_fast_free(p->fast);
+        free(p->name);
+        free(p);
+    }
+
+    while(s->index_defs!=NULL)
+    {
+        d=s->index_defs;
+        s->index_defs=d->next;
+        free(d->package);
+        free(d->type);
+        free(d->option);
+        free(d);
+    }
+
+    //Frees every package still loaded in the context
+    uci_free_context(s->ctx);
+    free(s);
+}
+
+easy_uci_session* easy_uci_session_open_readonly(void)
+{
+    easy_uci_session* s;
+
+    s=easy_uci_session_open();
+    if(s!=NULL)
+    {
+        s->readonly=true;
+    }
+
+    return s;
+}
+
+struct eu_package* __eu_session_load_rw(easy_uci_session* s,const char* package)
+{
+    if(s->readonly)
+    {
+        LogE("The session is read-only");
+        s->ctx->err=UCI_ERR_INVAL;
+        return NULL;
+    }
+
+    return __eu_session_load(s,package);
+}
+
+int easy_uci_session_unload(easy_uci_session* s,const char* package)
+{
+    struct eu_package* p;
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(strcmp(p->name,package)==0)
+        {
+            __eu_session_drop(s,p);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+bool __eu_stamp_equal(const struct eu_stamp* a,const struct eu_stamp* b)
+{
+    return a->ino==b->ino&&a->dev==b->dev&&a->size==b->size
+        &&a->mtime.tv_sec==b->mtime.tv_sec&&a->mtime.tv_nsec==b->mtime.tv_nsec
+        &&a->delta_ino==b->delta_ino&&a->delta_size==b->delta_size
+        &&a->delta_mtime.tv_sec==b->delta_mtime.tv_sec&&a->delta_mtime.tv_nsec==b->delta_mtime.tv_nsec;
+}
+
+/*
+ * Get the path of the config file of a package
+ * Return false if libuci would refuse the name
+ */
+static bool __eu_package_path(struct uci_context* ctx,const char* package,char* path,size_t size)
+{
+    const char* c;
+
+    if(package[0]=='/')
+    {
+        snprintf(path,size,"%s",package);
+        return true;
+    }
+
+    for(c=package;*c!='\0';++c)
+    {
+        if(!isalnum((unsigned char)*c)&&*c!='_'&&*c!='-')
+        {
+            return false;
+        }
+    }
+
+    snprintf(path,size,"%s/%s",ctx->confdir,package);
+
+    return c!=package;
+}
+
+int __eu_stamp_files(const char* config,const char* delta,struct eu_stamp* stamp)
+{
+    struct stat st;
+
+    if(stat(config,&st)!=0)
+    {
+        return -1;
+    }
+
+    stamp->dev=st.st_dev;
+    stamp->ino=st.st_ino;
+    stamp->size=st.st_size;
+    stamp->mtime=st.st_mtim;
+
+    memset(&st,0,sizeof(st));
+    if(delta[0]!='\0'&&stat(delta,&st)!=0)
+    {
+        memset(&st,0,sizeof(st));
+    }
+
+    stamp->delta_ino=st.st_ino;
+    stamp->delta_size=st.st_size;
+    stamp->delta_mtime=st.st_mtim;
+
+    return 0;
+}
+
+int __eu_stamp_package(struct uci_context* ctx,const char* package,struct eu_stamp* stamp)
+{
+    char config[PATH_MAX];
+    char delta[PATH_MAX];
+
+    //libuci only keeps deltas of packages loaded from the confdir
+    if(package[0]=='/')
+    {
+        return __eu_stamp_files(package,"",stamp);
+    }
+
+    snprintf(config,sizeof(config),"%s/%s",ctx->confdir,package);
+    snprintf(delta,sizeof(delta),"%s/%s",ctx->savedir,package);
+
+    return __eu_stamp_files(config,delta,stamp);
+}
+
+void __eu_package_files(const char* package,char* config,char* delta,size_t size)
+{
+    if(package[0]=='/')
+    {
+        snprintf(config,size,"%s",package);
+        delta[0]='\0';
+        return;
+    }
+
+    pthread_mutex_lock(&config_lock);
+    snprintf(config,size,"%s/%s",conf_dir!=NULL?conf_dir:UCI_CONFDIR,package);
+    snprintf(delta,size,"%s/%s",save_dir!=NULL?save_dir:UCI_SAVEDIR,package);
+    pthread_mutex_unlock(&config_lock);
+}
+
+static struct eu_package* __eu_session_find(easy_uci_session* s,const char* package)
+{
+    struct eu_package* p;
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(strcmp(p->name,package)==0)
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+bool __eu_session_fresh(easy_uci_session* s,const char* package)
+{
+    struct eu_package* p;
+    struct eu_stamp stamp;
+
+    p=__eu_session_find(s,package);
+
+    return p!=NULL&&__eu_stamp_package(s->ctx,package,&stamp)==0&&__eu_stamp_equal(&stamp,&p->stamp);
+}
+
+/*
+ * Parse a package not loaded in the session yet and add it to the session
+ * Return NULL on failure, the uci error is left in s->ctx
+ */
+static struct eu_package* __eu_session_parse(easy_uci_session* s,const char* package)
+{
+    int ret;
+    struct eu_package* p;
+    struct uci_package* pkg=NULL;
+    struct uci_element* e=NULL;
+    char path[PATH_MAX];
+
+    //A failed commit may have left the package behind in the context
+    if(uci_lookup_next(s->ctx,&e,&s->ctx->root,package)==0)
+    {
+        uci_unload(s->ctx,uci_to_package(e));
+    }
+
+    p=calloc(1,sizeof(struct eu_package));
+    if(p==NULL)
+    {
+        s->ctx->err=UCI_ERR_MEM;
+        return NULL;
+    }
+
+    p->name=strdup(package);
+    if(p->name==NULL)
+    {
+        free(p);
+        s->ctx->err=UCI_ERR_MEM;
+        return NULL;
+    }
+
+    //Stamp before parsing, a change made while parsing will show up on the next validation
+    if(__eu_stamp_package(s->ctx,package,&p->stamp)!=0&&s->validate)
+    {
+        free(p->name);
+        free(p);
+        s->ctx->err=UCI_ERR_NOTFOUND;
+        return NULL;
+    }
+
+    //Read-only sessions parse the config file themselves, unless there're deltas to apply
+    if(s->readonly&&p->stamp.size>0&&p->stamp.delta_size==0&&__eu_package_path(s->ctx,package,path,sizeof(path)))
+    {
+        p->fast=__eu_fast_load(path,package,&p->stamp,&p->pkg);
+
+        //The parser leaves sections declared twice to libuci, an anonymous name clashing with a named one is caught here
+        if(p->fast!=NULL&&(__eu_index_build(p)!=0||p->sections.count!=(size_t)p->pkg->n_section))
+        {
+            __eu_index_free(p);
+            __eu_fast_free(p->fast);
+            p->fast=NULL;
+            p->pkg=NULL;
+        }
+
+        if(p->fast!=NULL)
+        {
+            p->next=s->packages;
+            s->packages=p;
+            return p;
+        }
+    }
+
+    ret=uci_load(s->ctx,package,&pkg);
+    if(ret!=0||pkg==NULL)
+    {
+        free(p->name);
+        free(p);
+        return NULL;
+    }
+
+    p->pkg=pkg;
+
+    if(__eu_index_build(p)!=0)
+    {
+        uci_unload(s->ctx,pkg);
+        free(p->name);
+        free(p);
+        s->ctx->err=UCI_ERR_MEM;
+        return NULL;
+    }
+
+    p->next=s->packages;
+    s->packages=p;
+
+    return p;
+}
+
+struct eu_package* __eu_session_load(easy_uci_session* s,const char* package)
+{
+    struct eu_package* p;
+    struct eu_stamp stamp;
+    STATS_DECL(t);
+
+    p=__eu_session_find(s,package);
+
+    if(p!=NULL)
+    {
+        //Queued changes would be lost by a reload, they're merged into the config file when committed
+        if(!s->validate||p->dirty)
+        {
+            return p;
+        }
+
+        if(__eu_stamp_package(s->ctx,package,&stamp)==0&&__eu_stamp_equal(&stamp,&p->stamp))
+        {
+            return p;
+        }
+
+        __eu_session_drop(s,p);
+    }
+
+    STATS_START(t);
+    p=__eu_session_parse(s,package);
+    STATS_END(t,EASY_UCI_STATS_LOAD,p!=NULL);
+    if(p!=NULL)
+    {
+        STATS_PARSED(t,(size_t)p->stamp.size+(size_t)p->stamp.delta_size);
+    }
+
+    return p;
+}
+
+void __eu_session_drop(easy_uci_session* s,struct eu_package* p)
+{
+    struct eu_package** pp;
+
+    for(pp=&s->packages;*pp!=NULL;pp=&(*pp)->next)
+    {
+        if(*pp==p)
+        {
+            *pp=p->next;
+            break;
+        }
+    }
+
+    if(p->dirty)
+    {
+        __eu_session_fail(s);
+    }
+
+    if(p->fast!=NULL)
+    {
+        __eu_fast_free(p->fast);
+    }
+    else if(p->pkg!=NULL)
+    {
+        uci_unload(s->ctx,p->pkg);
+    }
+    __eu_index_free(p);
+    free(p->name);
+    free(p);
+}
+
+void __eu_session_fail(easy_uci_session* s)
+{
+    if(s->in_txn)
+    {
+        s->txn_failed=true;
+    }
+}
+
+//The lock file lives in the savedir
+int __eu_lock_package(struct uci_context* ctx,const char* package)
+{
+    int fd;
+    const char* name;
+    char path[PATH_MAX];
+
+    name=strrchr(package,'/');
+    name=name==NULL?package:name+1;
+
+    //Section and package names can't have a '.', this can't be the delta file of another package
+    mkdir(ctx->savedir,0700);
+    snprintf(path,sizeof(path),"%s/%s.lock",ctx->savedir,name);
+
+    fd=open(path,O_RDWR|O_CREAT|O_CLOEXEC,0600);
+    if(fd<0)
+    {
+        return -1;
+    }
+
+    while(flock(fd,LOCK_EX)!=0)
+    {
+        if(errno!=EINTR)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+easy_uci_version __eu_stamp_version(const struct eu_stamp* stamp)
+{
+    size_t i,j;
+    uint64_t h=14695981039346656037ULL;
+    uint64_t fields[]={
+        (uint64_t)stamp->dev,(uint64_t)stamp->ino,(uint64_t)stamp->size,
+        (uint64_t)stamp->mtime.tv_sec,(uint64_t)stamp->mtime.tv_nsec,
+        (uint64_t)stamp->delta_ino,(uint64_t)stamp->delta_size,
+        (uint64_t)stamp->delta_mtime.tv_sec,(uint64_t)stamp->delta_mtime.tv_nsec};
+
+    //FNV-1a over every byte of the stamp
+    for(i=0;i<sizeof(fields)/sizeof(fields[0]);++i)
+    {
+        for(j=0;j<8;++j)
+        {
+            h^=(fields[i]>>(j*8))&0xff;
+            h*=1099511628211ULL;
+        }
+    }
+
+    return h;
+}
+
+int __eu_session_commit(easy_uci_session* s,struct eu_package* p)
+{
+    int ret;
+    int lock;
+    bool saved;
+    off_t delta_size;
+    off_t written;
+    struct eu_stamp stamp;
+    char path[PATH_MAX];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    STATS_DECL(t);
+
+    if(s->in_txn)
+    {
+        p->dirty=true;
+        return 0;
+    }
+
+    //A conditional write must learn about a conflict now, so it isn't left to the background writer
+    if(s->deferred&&!p->expect)
+    {
+        p->dirty=true;
+        ++p->pending;
+        return 0;
+    }
+    p->dirty=false;
+    p->pending=0;
+    STATS_START(t);
+
+    //A journaled commit left by a crash would replace the package with what it had before this write
+    if(__eu_journal_recover(s->ctx)!=0)
+    {
+        p->expect=false;
+        s->ctx->err=UCI_ERR_IO;
+        lock=-1;
+        goto error;
+    }
+
+    //Checking the version and writing are atomic to other writers using easy_uci
+    lock=__eu_lock_package(s->ctx,p->name);
+    if(lock<0)
+    {
+        //Writing unlocked would let a conditional writer check a version that's about to change
+        snprintf(err_msg,sizeof(err_msg),"Failed to lock package: '%s'",p->name);
+        LogE(err_msg);
+        p->expect=false;
+        s->ctx->err=UCI_ERR_IO;
+        goto error;
+    }
+
+    if(p->expect)
+    {
+        p->expect=false;
+
+        memset(&stamp,0,sizeof(stamp));
+        __eu_stamp_package(s->ctx,p->name,&stamp);
+        if(__eu_stamp_version(&stamp)!=p->expected)
+        {
+            snprintf(err_msg,sizeof(err_msg),"Package: '%s' has changed since the version expected",p->name);
+            LogE(err_msg);
+            s->conflict=true;
+            s->ctx->err=UCI_ERR_INVAL;
+            goto error;
+        }
+    }
+
+    saved=s->staged&&!p->flush;
+    delta_size=p->stamp.delta_size;
+    if(saved)
+    {
+        //uci_save() moves the changes to the delta file, p->pkg and its index stay valid
+        ret=uci_save(s->ctx,p->pkg);
+        if(ret!=0)
+        {
+            goto error;
+        }
+    }
+    else
+    {
+        p->flush=false;
+
+        //uci_commit() reloads the package, so p->pkg is replaced and must be indexed again
+        ret=uci_commit(s->ctx,&p->pkg,false);
+        if(ret!=0||p->pkg==NULL)
+        {
+            //p->pkg may already be freed, leave whatever is left to the context
+            p->pkg=NULL;
+            goto error;
+        }
+    }
+
+    //What's in the session is what's in the files now
+    easy_uci_cache_invalidate(p->name);
+    __eu_stamp_package(s->ctx,p->name,&p->stamp);
+    //A staged commit appends to the delta file, another one writes the whole config file
+    written=saved?p->stamp.delta_size-delta_size:p->stamp.size;
+    STATS_COMMIT(t,p->name,true,written>0?(size_t)written:0);
+
+    if(!saved&&__eu_index_build(p)!=0)
+    {
+        //Written but can't be indexed, it'll be loaded again on next use
+        __eu_session_drop(s,p);
+    }
+    else if(__eu_package_path(s->ctx,p->name,path,sizeof(path)))
+    {
+        __eu_snapshot_refresh(p,path);
+    }
+
+    close(lock);
+
+    return 0;
+
+error:
+    if(lock>=0)
+    {
+        close(lock);
+    }
+    STATS_COMMIT(t,p->name,false,0);
+    __eu_session_drop(s,p);
+    return -1;
+}
+
+int easy_uci_session_flush(easy_uci_session* s,const char* package)
+{
+    int ret;
+    struct eu_package* p;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    //uci_commit() folds the delta file into the config file and removes it
+    p->flush=true;
+    ret=__eu_session_commit(s,p);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    return 0;
+
+error_pkg:
+    __eu_session_fail(s);
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+}
+
+int easy_uci_flush(const char* package)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_flush(s,package);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_session_begin(easy_uci_session* s)
+{
+    if(s->in_txn)
+    {
+        LogE("A transaction is already open");
+        return -1;
+    }
+
+    s->in_txn=true;
+    s->txn_failed=false;
+    s->conflict=false;
+
+    return 0;
+}
+
+int easy_uci_session_commit(easy_uci_session* s)
+{
+    int ret;
+    size_t count;
+    struct eu_package* p;
+    struct eu_package* next;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    if(!s->in_txn)
+    {
+        LogE("No transaction is open");
+        return -1;
+    }
+
+    if(s->txn_failed)
+    {
+        easy_uci_session_rollback(s);
+        LogE("Transaction rolled back because one of its operations failed");
+        return -1;
+    }
+
+    s->in_txn=false;
+
+    //Changes to more than one package are written through the journal, so they are all or nothing
+    for(p=s->packages,count=0;p!=NULL;p=p->next)
+    {
+        count+=p->dirty;
+    }
+    if(count>1&&!s->staged&&!s->deferred)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit %zu packages with error",count);
+        if(__eu_journal_commit(s)!=0)
+        {
+            goto error_pkg;
+        }
+        return 0;
+    }
+
+    for(p=s->packages;p!=NULL;p=next)
+    {
+        next=p->next;
+        if(!p->dirty)
+        {
+            continue;
+        }
+
+        //p is freed if the commit fails
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",p->name);
+        p->dirty=false;
+        ret=__eu_session_commit(s,p);
+        if(ret!=0)
+        {
+            goto error_pkg;
+        }
+    }
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    //Drop the changes left in packages after the one that failed
+    s->in_txn=true;
+    easy_uci_session_rollback(s);
+    return s->conflict?EASY_UCI_CONFLICT:-1;
+}
+
+void easy_uci_session_rollback(easy_uci_session* s)
+{
+    struct eu_package* p;
+    struct eu_package* next;
+
+    if(!s->in_txn)
+    {
+        return;
+    }
+
+    //Nothing has been written yet, dropping the packages discards the queued changes
+    for(p=s->packages;p!=NULL;p=next)
+    {
+        next=p->next;
+        if(p->dirty)
+        {
+            __eu_session_drop(s,p);
+        }
+    }
+
+    s->in_txn=false;
+    s->txn_failed=false;
+}
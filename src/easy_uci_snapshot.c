@@ -0,0 +1,1197 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define SNAPSHOT_DEFAULT_DIR "/var/run/easy_uci"
+//Bumped when snapshots of the same files would be compiled differently, so older ones are compiled again
+#define SNAPSHOT_MAGIC "EUSNAP02"
+
+/*
+ * A snapshot file is the header followed by these arrays, each packed right after the one before
+ *   struct eu_snap_section sections[n_sections]      in file order
+ *   struct eu_snap_option options[n_options]         the options of a section are contiguous
+ *   uint32_t items[n_items]                          the values of list options
+ *   struct eu_snap_type types[n_types]
+ *   uint32_t type_secs[n_sections]                   the sections of each type in file order
+ *   uint32_t sec_slots[sec_cap]                      hash tables holding an index + 1, 0 for an empty slot
+ *   uint32_t opt_slots[opt_cap]
+ *   uint32_t type_slots[type_cap]
+ *   char strings[strings_size]                       '\0' terminated strings, other records point to them by offset
+ * Everything is in host byte order, snapshots are for the machine that compiled them
+ */
+struct eu_snap_header
+{
+    char magic[8];
+    //The stamp of the files the snapshot was compiled from, same fields as __eu_stamp_version()
+    uint64_t stamp[9];
+    //Hash of the content of the config file, which keeps a snapshot valid when only the mtime has changed
+    uint64_t hash;
+    uint32_t size;
+    uint32_t n_sections;
+    uint32_t n_options;
+    uint32_t n_items;
+    uint32_t n_types;
+    uint32_t sec_cap;
+    uint32_t opt_cap;
+    uint32_t type_cap;
+    uint32_t strings_size;
+    uint32_t reserved;
+};
+
+struct eu_snap_section
+{
+    uint32_t name;
+    uint32_t type;
+    uint32_t first_option;
+    uint32_t n_options;
+};
+
+struct eu_snap_option
+{
+    uint32_t name;
+    uint32_t section;
+    //The offset of the string, or the index of the first item for a list
+    uint32_t value;
+    //UINT32_MAX for a string
+    uint32_t n_items;
+};
+
+struct eu_snap_type
+{
+    uint32_t name;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct easy_uci_snapshot
+{
+    //Mapped from the snapshot file, or malloc()ed if the snapshot couldn't be saved
+    char* base;
+    size_t size;
+    bool mapped;
+    const struct eu_snap_header* hdr;
+    const struct eu_snap_section* sections;
+    const struct eu_snap_option* options;
+    const uint32_t* items;
+    const struct eu_snap_type* types;
+    const uint32_t* type_secs;
+    const uint32_t* sec_slots;
+    const uint32_t* opt_slots;
+    const uint32_t* type_slots;
+    const char* strings;
+};
+
+//Guards snapshot_dir
+static pthread_mutex_t dir_lock=PTHREAD_MUTEX_INITIALIZER;
+static char* snapshot_dir=NULL;
+
+int easy_uci_snapshot_set_dir(const char* dir)
+{
+    char* d=NULL;
+
+    if(dir!=NULL&&(d=strdup(dir))==NULL)
+    {
+        LogE("Failed to set snapshot dir");
+        return -1;
+    }
+
+    pthread_mutex_lock(&dir_lock);
+    free(snapshot_dir);
+    snapshot_dir=d;
+    pthread_mutex_unlock(&dir_lock);
+
+    return 0;
+}
+
+/*
+ * Get the path of the snapshot file of a package, dir is set to the snapshot dir if not NULL
+ */
+static void __snapshot_path(const char* package,char* path,size_t size,char* dir,size_t dir_size)
+{
+    const char* name;
+    const char* d;
+
+    //Packages given by path share the dir with the packages of the confdir, the stamp tells them apart
+    name=strrchr(package,'/');
+    name=name==NULL?package:name+1;
+
+    pthread_mutex_lock(&dir_lock);
+    d=snapshot_dir!=NULL?snapshot_dir:SNAPSHOT_DEFAULT_DIR;
+    snprintf(path,size,"%s/%s.snap",d,name);
+    if(dir!=NULL)
+    {
+        snprintf(dir,dir_size,"%s",d);
+    }
+    pthread_mutex_unlock(&dir_lock);
+}
+
+static void __stamp_store(uint64_t* fields,const struct eu_stamp* stamp)
+{
+    fields[0]=(uint64_t)stamp->dev;
+    fields[1]=(uint64_t)stamp->ino;
+    fields[2]=(uint64_t)stamp->size;
+    fields[3]=(uint64_t)stamp->mtime.tv_sec;
+    fields[4]=(uint64_t)stamp->mtime.tv_nsec;
+    fields[5]=(uint64_t)stamp->delta_ino;
+    fields[6]=(uint64_t)stamp->delta_size;
+    fields[7]=(uint64_t)stamp->delta_mtime.tv_sec;
+    fields[8]=(uint64_t)stamp->delta_mtime.tv_nsec;
+}
+
+static void __stamp_load(struct eu_stamp* stamp,const uint64_t* fields)
+{
+    stamp->dev=(dev_t)fields[0];
+    stamp->ino=(ino_t)fields[1];
+    stamp->size=(off_t)fields[2];
+    stamp->mtime.tv_sec=(time_t)fields[3];
+    stamp->mtime.tv_nsec=(long)fields[4];
+    stamp->delta_ino=(ino_t)fields[5];
+    stamp->delta_size=(off_t)fields[6];
+    stamp->delta_mtime.tv_sec=(time_t)fields[7];
+    stamp->delta_mtime.tv_nsec=(long)fields[8];
+}
+
+/*
+ * FNV-1a over the content of a file
+ * Return 0 for success, -1 for failure
+ */
+static int __hash_file(const char* path,uint64_t* hash_p)
+{
+    int fd;
+    ssize_t n;
+    ssize_t i;
+    uint64_t h=14695981039346656037ULL;
+    unsigned char buff[16384];
+
+    fd=open(path,O_RDONLY|O_CLOEXEC);
+    if(fd<0)
+    {
+        return -1;
+    }
+
+    while((n=read(fd,buff,sizeof(buff)))!=0)
+    {
+        if(n<0)
+        {
+            if(errno==EINTR)
+            {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+
+        for(i=0;i<n;++i)
+        {
+            h^=buff[i];
+            h*=1099511628211ULL;
+        }
+    }
+
+    close(fd);
+    *hash_p=h;
+
+    return 0;
+}
+
+static uint32_t __hash_str(const char* str)
+{
+    uint32_t h=2166136261u;
+
+    for(;*str!='\0';++str)
+    {
+        h^=(unsigned char)*str;
+        h*=16777619u;
+    }
+
+    return h;
+}
+
+static uint32_t __hash_option(uint32_t section,const char* name)
+{
+    return __hash_str(name)^(section*0x9e3779b1u);
+}
+
+/*
+ * A power of 2 at least twice count
+ */
+static uint32_t __slot_cap(size_t count)
+{
+    uint32_t cap=8;
+
+    while(cap<count*2)
+    {
+        cap*=2;
+    }
+
+    return cap;
+}
+
+static void __slot_put(uint32_t* slots,uint32_t cap,uint32_t hash,uint32_t index)
+{
+    uint32_t i;
+
+    for(i=hash&(cap-1);slots[i]!=0;i=(i+1)&(cap-1));
+    slots[i]=index+1;
+}
+
+/*
+ * Lay out the arrays of a snapshot from its header
+ * Return false if the sizes don't add up or the sections of a type are out of range
+ */
+static bool __attach(easy_uci_snapshot* snap)
+{
+    const struct eu_snap_header* hdr;
+    uint64_t size;
+    uint32_t i;
+    char* cur;
+
+    if(snap->size<sizeof(struct eu_snap_header))
+    {
+        return false;
+    }
+
+    hdr=(const struct eu_snap_header*)snap->base;
+    if(memcmp(hdr->magic,SNAPSHOT_MAGIC,sizeof(hdr->magic))!=0||hdr->size!=snap->size)
+    {
+        return false;
+    }
+
+    size=sizeof(struct eu_snap_header)
+        +(uint64_t)hdr->n_sections*(sizeof(struct eu_snap_section)+sizeof(uint32_t))
+        +(uint64_t)hdr->n_options*sizeof(struct eu_snap_option)
+        +(uint64_t)hdr->n_items*sizeof(uint32_t)
+        +(uint64_t)hdr->n_types*sizeof(struct eu_snap_type)
+        +((uint64_t)hdr->sec_cap+hdr->opt_cap+hdr->type_cap)*sizeof(uint32_t)
+        +hdr->strings_size;
+    if(size!=snap->size||hdr->strings_size==0||snap->base[snap->size-1]!='\0')
+    {
+        return false;
+    }
+
+    //Lookups mask hashes with cap-1
+    if((hdr->sec_cap&(hdr->sec_cap-1))!=0||(hdr->opt_cap&(hdr->opt_cap-1))!=0||(hdr->type_cap&(hdr->type_cap-1))!=0
+        ||hdr->sec_cap<=hdr->n_sections||hdr->opt_cap<=hdr->n_options||hdr->type_cap<=hdr->n_types)
+    {
+        return false;
+    }
+
+    snap->hdr=hdr;
+    cur=snap->base+sizeof(struct eu_snap_header);
+    snap->sections=(const struct eu_snap_section*)cur;
+    cur+=sizeof(struct eu_snap_section)*hdr->n_sections;
+    snap->options=(const struct eu_snap_option*)cur;
+    cur+=sizeof(struct eu_snap_option)*hdr->n_options;
+    snap->items=(const uint32_t*)cur;
+    cur+=sizeof(uint32_t)*hdr->n_items;
+    snap->types=(const struct eu_snap_type*)cur;
+    cur+=sizeof(struct eu_snap_type)*hdr->n_types;
+    snap->type_secs=(const uint32_t*)cur;
+    cur+=sizeof(uint32_t)*hdr->n_sections;
+    snap->sec_slots=(const uint32_t*)cur;
+    cur+=sizeof(uint32_t)*hdr->sec_cap;
+    snap->opt_slots=(const uint32_t*)cur;
+    cur+=sizeof(uint32_t)*hdr->opt_cap;
+    snap->type_slots=(const uint32_t*)cur;
+    cur+=sizeof(uint32_t)*hdr->type_cap;
+    snap->strings=cur;
+
+    //Lookups index the sections with these as they are
+    for(i=0;i<hdr->n_sections;++i)
+    {
+        if(snap->type_secs[i]>=hdr->n_sections)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Get a string of the snapshot, "" for an offset out of range
+ */
+static const char* __str(const easy_uci_snapshot* snap,uint32_t off)
+{
+    return off<snap->hdr->strings_size?snap->strings+off:snap->strings+snap->hdr->strings_size-1;
+}
+
+/*
+ * Compile a package loaded in a session into a snapshot
+ * Return the snapshot malloc()ed, NULL for failure
+ */
+static char* __build(struct eu_package* p,uint64_t hash,size_t* size_p)
+{
+    size_t n_sections=0;
+    size_t n_options=0;
+    size_t n_items=0;
+    size_t n_types=p->types.count;
+    size_t bytes=1;
+    uint64_t size;
+    uint32_t sec_cap,opt_cap,type_cap;
+    uint32_t i,t;
+    uint32_t off;
+    uint32_t next_type_sec=0;
+    struct uci_element* se;
+    struct uci_element* oe;
+    struct uci_element* ie;
+    struct uci_option* opt;
+    struct eu_type_list* tl;
+    struct eu_snap_header* hdr;
+    struct eu_snap_section* sections;
+    struct eu_snap_option* options;
+    struct eu_snap_section* ss;
+    struct eu_snap_option* so;
+    struct eu_snap_type* types;
+    uint32_t* items;
+    uint32_t* type_secs;
+    uint32_t* sec_slots;
+    uint32_t* opt_slots;
+    uint32_t* type_slots;
+    char* strings;
+    char* buff;
+
+    uci_foreach_element(&p->pkg->sections,se)
+    {
+        ++n_sections;
+        bytes+=strlen(se->name)+strlen(uci_to_section(se)->type)+2;
+        uci_foreach_element(&uci_to_section(se)->options,oe)
+        {
+            ++n_options;
+            bytes+=strlen(oe->name)+1;
+            opt=uci_to_option(oe);
+            if(opt->type==UCI_TYPE_STRING)
+            {
+                bytes+=strlen(opt->v.string)+1;
+                continue;
+            }
+            uci_foreach_element(&opt->v.list,ie)
+            {
+                ++n_items;
+                bytes+=strlen(ie->name)+1;
+            }
+        }
+    }
+
+    sec_cap=__slot_cap(n_sections);
+    opt_cap=__slot_cap(n_options);
+    type_cap=__slot_cap(n_types);
+
+    size=sizeof(struct eu_snap_header)
+        +n_sections*(sizeof(struct eu_snap_section)+sizeof(uint32_t))
+        +n_options*sizeof(struct eu_snap_option)
+        +n_items*sizeof(uint32_t)
+        +n_types*sizeof(struct eu_snap_type)
+        +((uint64_t)sec_cap+opt_cap+type_cap)*sizeof(uint32_t)
+        +bytes;
+    if(size>UINT32_MAX)
+    {
+        return NULL;
+    }
+
+    buff=calloc(1,size);
+    if(buff==NULL)
+    {
+        return NULL;
+    }
+
+    hdr=(struct eu_snap_header*)buff;
+    memcpy(hdr->magic,SNAPSHOT_MAGIC,sizeof(hdr->magic));
+    __stamp_store(hdr->stamp,&p->stamp);
+    hdr->hash=hash;
+    hdr->size=size;
+    hdr->n_sections=n_sections;
+    hdr->n_options=n_options;
+    hdr->n_items=n_items;
+    hdr->n_types=n_types;
+    hdr->sec_cap=sec_cap;
+    hdr->opt_cap=opt_cap;
+    hdr->type_cap=type_cap;
+    hdr->strings_size=bytes;
+
+    sections=(struct eu_snap_section*)(hdr+1);
+    options=(struct eu_snap_option*)(sections+n_sections);
+    items=(uint32_t*)(options+n_options);
+    types=(struct eu_snap_type*)(items+n_items);
+    type_secs=(uint32_t*)(types+n_types);
+    sec_slots=type_secs+n_sections;
+    opt_slots=sec_slots+sec_cap;
+    type_slots=opt_slots+opt_cap;
+    strings=(char*)(type_slots+type_cap);
+
+    //Offset 0 is "", which nothing points to
+    off=1;
+#define PUT_STRING(dst,str) do{ size_t __len=strlen(str)+1; memcpy(strings+off,(str),__len); (dst)=off; off+=__len; }while(0)
+
+    i=0;
+    n_options=0;
+    n_items=0;
+    n_types=0;
+    uci_foreach_element(&p->pkg->sections,se)
+    {
+        ss=&sections[i];
+        PUT_STRING(ss->name,se->name);
+        PUT_STRING(ss->type,uci_to_section(se)->type);
+        ss->first_option=n_options;
+        __slot_put(sec_slots,sec_cap,__hash_str(se->name),i);
+
+        //The sections of a type get a range of type_secs as long as the type list of the index
+        for(t=__hash_str(uci_to_section(se)->type)&(type_cap-1);type_slots[t]!=0;t=(t+1)&(type_cap-1))
+        {
+            if(strcmp(strings+types[type_slots[t]-1].name,uci_to_section(se)->type)==0)
+            {
+                break;
+            }
+        }
+        if(type_slots[t]==0)
+        {
+            tl=__eu_index_type(p,uci_to_section(se)->type);
+            if(tl==NULL||n_types>=hdr->n_types||next_type_sec+tl->len>n_sections)
+            {
+                free(buff);
+                return NULL;
+            }
+            types[n_types].name=ss->type;
+            types[n_types].first=next_type_sec;
+            next_type_sec+=tl->len;
+            type_slots[t]=++n_types;
+        }
+        t=type_slots[t]-1;
+        type_secs[types[t].first+types[t].count++]=i;
+
+        uci_foreach_element(&uci_to_section(se)->options,oe)
+        {
+            so=&options[n_options];
+            opt=uci_to_option(oe);
+            PUT_STRING(so->name,oe->name);
+            so->section=i;
+            __slot_put(opt_slots,opt_cap,__hash_option(i,oe->name),n_options);
+            ++n_options;
+
+            if(opt->type==UCI_TYPE_STRING)
+            {
+                PUT_STRING(so->value,opt->v.string);
+                so->n_items=UINT32_MAX;
+                continue;
+            }
+
+            so->value=n_items;
+            so->n_items=0;
+            uci_foreach_element(&opt->v.list,ie)
+            {
+                PUT_STRING(items[n_items],ie->name);
+                ++n_items;
+                ++so->n_items;
+            }
+        }
+
+        ss->n_options=n_options-ss->first_option;
+        ++i;
+    }
+
+#undef PUT_STRING
+
+    *size_p=size;
+
+    return buff;
+}
+
+/*
+ * Write a snapshot file, replacing the old one atomically
+ * Return 0 for success, -1 for failure
+ */
+static int __save(const char* path,const char* dir,const char* buff,size_t size)
+{
+    int fd;
+    ssize_t n;
+    size_t done=0;
+    char tmp[PATH_MAX];
+
+    mkdir(dir,0755);
+    snprintf(tmp,sizeof(tmp),"%s.XXXXXX",path);
+
+    fd=mkstemp(tmp);
+    if(fd<0)
+    {
+        return -1;
+    }
+
+    while(done<size)
+    {
+        n=write(fd,buff+done,size-done);
+        if(n<0)
+        {
+            if(errno==EINTR)
+            {
+                continue;
+            }
+            goto error;
+        }
+        done+=n;
+    }
+
+    //Every process reading the config may read the snapshot
+    if(fchmod(fd,0644)!=0||close(fd)!=0)
+    {
+        fd=-1;
+        goto error;
+    }
+
+    if(rename(tmp,path)!=0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+
+error:
+    if(fd>=0)
+    {
+        close(fd);
+    }
+    unlink(tmp);
+    return -1;
+}
+
+/*
+ * Map a snapshot file
+ * Return NULL if there's none or it can't be used
+ */
+static easy_uci_snapshot* __map(const char* path)
+{
+    int fd;
+    struct stat st;
+    easy_uci_snapshot* snap;
+
+    fd=open(path,O_RDONLY|O_CLOEXEC);
+    if(fd<0)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd,&st)!=0||st.st_size==0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    snap=calloc(1,sizeof(easy_uci_snapshot));
+    if(snap==NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    snap->base=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if(snap->base==MAP_FAILED)
+    {
+        free(snap);
+        return NULL;
+    }
+    snap->size=st.st_size;
+    snap->mapped=true;
+
+    if(!__attach(snap))
+    {
+        easy_uci_snapshot_close(snap);
+        return NULL;
+    }
+
+    return snap;
+}
+
+/*
+ * Whether a snapshot is still what the files of its package hold, its stamp is updated if only the mtime has changed
+ */
+static bool __valid(const easy_uci_snapshot* snap,const char* path,const char* dir,const char* config,const struct eu_stamp* stamp)
+{
+    uint64_t hash;
+    uint64_t fields[9];
+    char* buff;
+    struct eu_stamp old;
+
+    __stamp_load(&old,snap->hdr->stamp);
+    if(__eu_stamp_equal(&old,stamp))
+    {
+        return true;
+    }
+
+    //A config file written again with the same content, the deltas must be the same though
+    if(old.delta_ino!=stamp->delta_ino||old.delta_size!=stamp->delta_size
+        ||old.delta_mtime.tv_sec!=stamp->delta_mtime.tv_sec||old.delta_mtime.tv_nsec!=stamp->delta_mtime.tv_nsec
+        ||old.size!=stamp->size||__hash_file(config,&hash)!=0||hash!=snap->hdr->hash)
+    {
+        return false;
+    }
+
+    //Save the next opens hashing the file again, other processes may have the file mapped so it's replaced whole
+    buff=malloc(snap->size);
+    if(buff!=NULL)
+    {
+        memcpy(buff,snap->base,snap->size);
+        __stamp_store(fields,stamp);
+        memcpy(buff+offsetof(struct eu_snap_header,stamp),fields,sizeof(fields));
+        if(__save(path,dir,buff,snap->size)!=0)
+        {
+            LogE("Failed to update snapshot stamp");
+        }
+        free(buff);
+    }
+
+    return true;
+}
+
+/*
+ * Load a package in a session of its own and compile it into a snapshot
+ * Return the snapshot malloc()ed, NULL for failure
+ */
+static char* __compile(const char* package,const char* config,size_t* size_p)
+{
+    uint64_t hash;
+    easy_uci_session* s;
+    struct eu_package* p;
+    char* buff;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    //Hashed before it's parsed, a change in between makes the stamp stale as well
+    if(__hash_file(config,&hash)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to read package: '%s'",package);
+        LogE(err_msg);
+        return NULL;
+    }
+
+    s=easy_uci_session_open_readonly();
+    if(s==NULL)
+    {
+        return NULL;
+    }
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        uci_get_errorstr(s->ctx,&err_str,err_msg);
+        LogE(err_str);
+        free(err_str);
+        easy_uci_session_close(s);
+        return NULL;
+    }
+
+    buff=__build(p,hash,size_p);
+    easy_uci_session_close(s);
+    if(buff==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to compile package: '%s'",package);
+        LogE(err_msg);
+    }
+
+    return buff;
+}
+
+void __eu_snapshot_refresh(struct eu_package* p,const char* config)
+{
+    size_t size;
+    uint64_t hash;
+    char* buff;
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    //Only packages somebody has compiled are kept up to date
+    __snapshot_path(p->name,path,sizeof(path),dir,sizeof(dir));
+    if(access(path,F_OK)!=0)
+    {
+        return;
+    }
+
+    buff=NULL;
+    if(__hash_file(config,&hash)!=0||(buff=__build(p,hash,&size))==NULL||__save(path,dir,buff,size)!=0)
+    {
+        //Stale now, the next open compiles it again
+        unlink(path);
+        snprintf(err_msg,sizeof(err_msg),"Failed to refresh the snapshot of package: '%s'",p->name);
+        LogE(err_msg);
+    }
+
+    free(buff);
+}
+
+easy_uci_snapshot* easy_uci_snapshot_open(const char* package)
+{
+    size_t size;
+    char* buff;
+    easy_uci_snapshot* snap;
+    struct eu_stamp stamp;
+    char config[PATH_MAX];
+    char delta[PATH_MAX];
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    __eu_package_files(package,config,delta,sizeof(config));
+    __snapshot_path(package,path,sizeof(path),dir,sizeof(dir));
+
+    if(__eu_stamp_files(config,delta,&stamp)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find package: '%s'",package);
+        LogE(err_msg);
+        return NULL;
+    }
+
+    snap=__map(path);
+    if(snap!=NULL&&__valid(snap,path,dir,config,&stamp))
+    {
+        return snap;
+    }
+    easy_uci_snapshot_close(snap);
+
+    buff=__compile(package,config,&size);
+    if(buff==NULL)
+    {
+        return NULL;
+    }
+
+    //Still usable from memory when it can't be saved
+    if(__save(path,dir,buff,size)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to save the snapshot of package: '%s'",package);
+        LogE(err_msg);
+    }
+
+    snap=calloc(1,sizeof(easy_uci_snapshot));
+    if(snap==NULL)
+    {
+        free(buff);
+        return NULL;
+    }
+    snap->base=buff;
+    snap->size=size;
+    if(!__attach(snap))
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to compile package: '%s'",package);
+        LogE(err_msg);
+        easy_uci_snapshot_close(snap);
+        return NULL;
+    }
+
+    return snap;
+}
+
+int easy_uci_snapshot_compile(const char* package)
+{
+    int ret;
+    size_t size;
+    char* buff;
+    char config[PATH_MAX];
+    char delta[PATH_MAX];
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    __eu_package_files(package,config,delta,sizeof(config));
+    __snapshot_path(package,path,sizeof(path),dir,sizeof(dir));
+
+    buff=__compile(package,config,&size);
+    if(buff==NULL)
+    {
+        return -1;
+    }
+
+    ret=__save(path,dir,buff,size);
+    if(ret!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to save the snapshot of package: '%s'",package);
+        LogE(err_msg);
+    }
+    free(buff);
+
+    return ret;
+}
+
+void easy_uci_snapshot_close(easy_uci_snapshot* snap)
+{
+    if(snap==NULL)
+    {
+        return;
+    }
+
+    if(snap->mapped)
+    {
+        munmap(snap->base,snap->size);
+    }
+    else
+    {
+        free(snap->base);
+    }
+
+    free(snap);
+}
+
+/*
+ * Find a type by its first len chars
+ * Return NULL if there's no section of the type
+ */
+static const struct eu_snap_type* __type(const easy_uci_snapshot* snap,const char* type,size_t len)
+{
+    uint32_t i;
+    uint32_t h=2166136261u;
+    size_t k;
+    const char* name;
+    const struct eu_snap_type* t;
+
+    for(k=0;k<len;++k)
+    {
+        h^=(unsigned char)type[k];
+        h*=16777619u;
+    }
+
+    for(i=h&(snap->hdr->type_cap-1);snap->type_slots[i]!=0;i=(i+1)&(snap->hdr->type_cap-1))
+    {
+        if(snap->type_slots[i]>snap->hdr->n_types)
+        {
+            break;
+        }
+        t=&snap->types[snap->type_slots[i]-1];
+        name=__str(snap,t->name);
+        if(strncmp(name,type,len)==0&&name[len]=='\0')
+        {
+            //Corrupt ranges are treated as empty
+            return (uint64_t)t->first+t->count<=snap->hdr->n_sections?t:NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Get the index of the nth section of a type, a negative n counts from the last one
+ * Return UINT32_MAX if not found
+ */
+static uint32_t __nth_of_type(const easy_uci_snapshot* snap,const char* type,size_t len,long n)
+{
+    const struct eu_snap_type* t;
+
+    t=__type(snap,type,len);
+    if(t==NULL)
+    {
+        return UINT32_MAX;
+    }
+
+    if(n<0)
+    {
+        n+=t->count;
+    }
+    if(n<0||(uint64_t)n>=t->count)
+    {
+        return UINT32_MAX;
+    }
+
+    return snap->type_secs[t->first+n];
+}
+
+/*
+ * Find a section by name or as @type[n]
+ * Return UINT32_MAX if not found
+ */
+static uint32_t __section(const easy_uci_snapshot* snap,const char* name)
+{
+    uint32_t i;
+    long n;
+    char* end;
+    const char* bracket;
+    size_t len=strlen(name);
+
+    if(name[0]=='@')
+    {
+        bracket=strchr(name,'[');
+        if(bracket==NULL||bracket==name+1||name[len-1]!=']')
+        {
+            return UINT32_MAX;
+        }
+
+        n=strtol(bracket+1,&end,10);
+        if(end==bracket+1||end!=name+len-1)
+        {
+            return UINT32_MAX;
+        }
+
+        return __nth_of_type(snap,name+1,bracket-name-1,n);
+    }
+
+    for(i=__hash_str(name)&(snap->hdr->sec_cap-1);snap->sec_slots[i]!=0;i=(i+1)&(snap->hdr->sec_cap-1))
+    {
+        if(snap->sec_slots[i]>snap->hdr->n_sections)
+        {
+            break;
+        }
+        if(strcmp(__str(snap,snap->sections[snap->sec_slots[i]-1].name),name)==0)
+        {
+            return snap->sec_slots[i]-1;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+/*
+ * Find an option of a section
+ * Return NULL if not found
+ */
+static const struct eu_snap_option* __option(const easy_uci_snapshot* snap,uint32_t sec,const char* name)
+{
+    uint32_t i;
+    const struct eu_snap_option* opt;
+
+    for(i=__hash_option(sec,name)&(snap->hdr->opt_cap-1);snap->opt_slots[i]!=0;i=(i+1)&(snap->hdr->opt_cap-1))
+    {
+        if(snap->opt_slots[i]>snap->hdr->n_options)
+        {
+            break;
+        }
+        opt=&snap->options[snap->opt_slots[i]-1];
+        if(opt->section==sec&&strcmp(__str(snap,opt->name),name)==0)
+        {
+            return opt;
+        }
+    }
+
+    return NULL;
+}
+
+static void __copy_string(const char* str,char* buff,size_t size)
+{
+    size_t len;
+
+    if(size>0)
+    {
+        len=strlen(str);
+        if(len>=size)
+        {
+            len=size-1;
+        }
+        memcpy(buff,str,len);
+        buff[len]='\0';
+    }
+}
+
+int easy_uci_snapshot_get_section_type(const easy_uci_snapshot* snap,const char* section,char* buff,size_t size)
+{
+    uint32_t sec;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    sec=__section(snap,section);
+    if(sec==UINT32_MAX)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        LogE(err_msg);
+        return -1;
+    }
+
+    __copy_string(__str(snap,snap->sections[sec].type),buff,size);
+
+    return 0;
+}
+
+int easy_uci_snapshot_get_all_section_of_type(const easy_uci_snapshot* snap,const char* type,easy_uci_list* list_p)
+{
+    size_t bytes=0;
+    size_t len;
+    uint32_t i;
+    const struct eu_snap_type* t;
+    easy_uci_list list;
+    const char* name;
+    char* buff;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    t=__type(snap,type,strlen(type));
+    if(t==NULL||t->count==0)
+    {
+        list_p->list=NULL;
+        list_p->len=0;
+        return 0;
+    }
+
+    for(i=0;i<t->count;++i)
+    {
+        bytes+=strlen(__str(snap,snap->sections[snap->type_secs[t->first+i]].name))+1;
+    }
+
+    buff=__eu_list_alloc(&list,t->count,bytes);
+    if(buff==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        LogE(err_msg);
+        return -1;
+    }
+
+    for(i=0;i<t->count;++i)
+    {
+        name=__str(snap,snap->sections[snap->type_secs[t->first+i]].name);
+        len=strlen(name)+1;
+        memcpy(buff,name,len);
+        list.list[i]=buff;
+        buff+=len;
+    }
+
+    *list_p=list;
+
+    return 0;
+}
+
+int easy_uci_snapshot_get_nth_section_of_type(const easy_uci_snapshot* snap,const char* type,int n,char** name_p)
+{
+    uint32_t sec;
+    char* name;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    sec=__nth_of_type(snap,type,strlen(type),n);
+    if(sec==UINT32_MAX)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section %d of type: '%s'",n,type);
+        LogE(err_msg);
+        return -1;
+    }
+
+    name=strdup(__str(snap,snap->sections[sec].name));
+    if(name==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        LogE(err_msg);
+        return -1;
+    }
+
+    *name_p=name;
+
+    return 0;
+}
+
+int easy_uci_snapshot_get_section_count_of_type(const easy_uci_snapshot* snap,const char* type,size_t* count_p)
+{
+    const struct eu_snap_type* t;
+
+    t=__type(snap,type,strlen(type));
+    *count_p=t==NULL?0:t->count;
+
+    return 0;
+}
+
+int easy_uci_snapshot_get_option_string(const easy_uci_snapshot* snap,const char* section,const char* option,char* buff,size_t size)
+{
+    uint32_t sec;
+    const struct eu_snap_option* opt;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    sec=__section(snap,section);
+    if(sec==UINT32_MAX)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    opt=__option(snap,sec,option);
+    if(opt==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
+        goto error_msg;
+    }
+
+    if(opt->n_items!=UINT32_MAX)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a string",option);
+        goto error_msg;
+    }
+
+    __copy_string(__str(snap,opt->value),buff,size);
+
+    return 0;
+
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_snapshot_get_option_list(const easy_uci_snapshot* snap,const char* section,const char* option,easy_uci_list* list_p)
+{
+    uint32_t sec;
+    uint32_t i;
+    size_t bytes=0;
+    size_t len;
+    const struct eu_snap_option* opt;
+    easy_uci_list list;
+    const char* item;
+    char* buff;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    sec=__section(snap,section);
+    if(sec==UINT32_MAX)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    opt=__option(snap,sec,option);
+    if(opt==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
+        goto error_msg;
+    }
+
+    if(opt->n_items==UINT32_MAX||(uint64_t)opt->value+opt->n_items>snap->hdr->n_items)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a list",option);
+        goto error_msg;
+    }
+
+    if(opt->n_items==0)
+    {
+        list_p->list=NULL;
+        list_p->len=0;
+        return 0;
+    }
+
+    for(i=0;i<opt->n_items;++i)
+    {
+        bytes+=strlen(__str(snap,snap->items[opt->value+i]))+1;
+    }
+
+    buff=__eu_list_alloc(&list,opt->n_items,bytes);
+    if(buff==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed malloc at %s:%d",__FILE__,__LINE__);
+        goto error_msg;
+    }
+
+    for(i=0;i<opt->n_items;++i)
+    {
+        item=__str(snap,snap->items[opt->value+i]);
+        len=strlen(item)+1;
+        memcpy(buff,item,len);
+        list.list[i]=buff;
+        buff+=len;
+    }
+
+    *list_p=list;
+
+    return 0;
+
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#ifndef EASY_UCI_NO_STATS
+
+/*
+ * The counters of one package, kept until easy_uci_reset_stats()
+ */
+struct eu_package_stats
+{
+    char* name;
+    easy_uci_package_stats stats;
+    struct eu_package_stats* next;
+};
+
+bool __eu_stats_on=false;
+
+//Updated with relaxed atomics, a snapshot taken while calls run may be off by the calls in flight
+static easy_uci_stats stats;
+
+//Guards package_stats, which only changes on commits
+static pthread_mutex_t package_lock=PTHREAD_MUTEX_INITIALIZER;
+static struct eu_package_stats* package_stats=NULL;
+
+uint64_t __eu_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+
+    //Never 0, which tells the stats were off when the timer started
+    return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec+1;
+}
+
+void __eu_stats_record(int phase,uint64_t start,bool ok)
+{
+    int bucket;
+    uint64_t ns;
+    easy_uci_phase_stats* ps=&stats.phases[phase];
+
+    ns=__eu_stats_now()-start;
+
+    //Bucket i holds [2^i, 2^(i+1)) ns
+    bucket=63-__builtin_clzll(ns|1);
+    if(bucket>=EASY_UCI_HIST_BUCKETS)
+    {
+        bucket=EASY_UCI_HIST_BUCKETS-1;
+    }
+
+    __atomic_fetch_add(&ps->calls,1,__ATOMIC_RELAXED);
+    if(!ok)
+    {
+        __atomic_fetch_add(&ps->failures,1,__ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&ps->total_ns,ns,__ATOMIC_RELAXED);
+    __atomic_fetch_add(&ps->hist[bucket],1,__ATOMIC_RELAXED);
+}
+
+void __eu_stats_parsed(size_t bytes)
+{
+    __atomic_fetch_add(&stats.bytes_parsed,bytes,__ATOMIC_RELAXED);
+}
+
+void __eu_stats_commit(uint64_t start,const char* package,bool ok,size_t bytes)
+{
+    struct eu_package_stats* e;
+
+    __eu_stats_record(EASY_UCI_STATS_COMMIT,start,ok);
+    __atomic_fetch_add(&stats.bytes_written,bytes,__ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&package_lock);
+
+    for(e=package_stats;e!=NULL;e=e->next)
+    {
+        if(strcmp(e->name,package)==0)
+        {
+            break;
+        }
+    }
+
+    if(e==NULL)
+    {
+        //Not counted if there's no memory for it, the global counters still are
+        e=calloc(1,sizeof(struct eu_package_stats));
+        if(e==NULL||(e->name=strdup(package))==NULL)
+        {
+            free(e);
+            pthread_mutex_unlock(&package_lock);
+            return;
+        }
+        e->next=package_stats;
+        package_stats=e;
+    }
+
+    if(ok)
+    {
+        ++e->stats.commits;
+        e->stats.bytes_written+=bytes;
+    }
+    else
+    {
+        ++e->stats.failures;
+    }
+
+    pthread_mutex_unlock(&package_lock);
+}
+
+int easy_uci_stats_enable(bool enable)
+{
+    __atomic_store_n(&__eu_stats_on,enable,__ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int easy_uci_get_stats(easy_uci_stats* stats_p)
+{
+    size_t i,j;
+    easy_uci_phase_stats* ps;
+
+    for(i=0;i<EASY_UCI_STATS_PHASES;++i)
+    {
+        ps=&stats.phases[i];
+        stats_p->phases[i].calls=__atomic_load_n(&ps->calls,__ATOMIC_RELAXED);
+        stats_p->phases[i].failures=__atomic_load_n(&ps->failures,__ATOMIC_RELAXED);
+        stats_p->phases[i].total_ns=__atomic_load_n(&ps->total_ns,__ATOMIC_RELAXED);
+        for(j=0;j<EASY_UCI_HIST_BUCKETS;++j)
+        {
+            stats_p->phases[i].hist[j]=__atomic_load_n(&ps->hist[j],__ATOMIC_RELAXED);
+        }
+    }
+    stats_p->bytes_parsed=__atomic_load_n(&stats.bytes_parsed,__ATOMIC_RELAXED);
+    stats_p->bytes_written=__atomic_load_n(&stats.bytes_written,__ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int easy_uci_get_package_stats(const char* package,easy_uci_package_stats* stats_p)
+{
+    struct eu_package_stats* e;
+
+    memset(stats_p,0,sizeof(easy_uci_package_stats));
+
+    pthread_mutex_lock(&package_lock);
+
+    for(e=package_stats;e!=NULL;e=e->next)
+    {
+        if(strcmp(e->name,package)==0)
+        {
+            *stats_p=e->stats;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&package_lock);
+
+    return 0;
+}
+
+void easy_uci_reset_stats(void)
+{
+    size_t i,j;
+    easy_uci_phase_stats* ps;
+    struct eu_package_stats* e;
+    struct eu_package_stats* next;
+
+    for(i=0;i<EASY_UCI_STATS_PHASES;++i)
+    {
+        ps=&stats.phases[i];
+        __atomic_store_n(&ps->calls,0,__ATOMIC_RELAXED);
+        __atomic_store_n(&ps->failures,0,__ATOMIC_RELAXED);
+        __atomic_store_n(&ps->total_ns,0,__ATOMIC_RELAXED);
+        for(j=0;j<EASY_UCI_HIST_BUCKETS;++j)
+        {
+            __atomic_store_n(&ps->hist[j],0,__ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&stats.bytes_parsed,0,__ATOMIC_RELAXED);
+    __atomic_store_n(&stats.bytes_written,0,__ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&package_lock);
+    e=package_stats;
+    package_stats=NULL;
+    pthread_mutex_unlock(&package_lock);
+
+    for(;e!=NULL;e=next)
+    {
+        next=e->next;
+        free(e->name);
+        free(e);
+    }
+}
+
+#else
+
+int easy_uci_stats_enable(bool enable)
+{
+    (void)enable;
+
+    LogE("Built without stats");
+    return -1;
+}
+
+int easy_uci_get_stats(easy_uci_stats* stats_p)
+{
+    memset(stats_p,0,sizeof(easy_uci_stats));
+
+    return -1;
+}
+
+int easy_uci_get_package_stats(const char* package,easy_uci_package_stats* stats_p)
+{
+    (void)package;
+
+    memset(stats_p,0,sizeof(easy_uci_package_stats));
+
+    return -1;
+}
+
+void easy_uci_reset_stats(void)
+{
+}
+
+#endif /* EASY_UCI_NO_STATS */
@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+#define TRY_NAME_SIZE 64
+
+/*
+ * The last failure of a try getter in the thread, only turned into a message by easy_uci_last_error()
+ */
+struct eu_try_error
+{
+    int code;
+    //The uci error a package failed to load with
+    int uci_err;
+    //The name that wasn't found, or the package or option the failure is about
+    char name[TRY_NAME_SIZE];
+    //"a string" or "a list" for EASY_UCI_EWRONGTYPE
+    const char* what;
+};
+
+static __thread struct eu_try_error last_error;
+
+static int __fail(int code,const char* name)
+{
+    size_t len;
+
+    len=strnlen(name,TRY_NAME_SIZE-1);
+    memcpy(last_error.name,name,len);
+    last_error.name[len]='\0';
+    last_error.code=code;
+
+    return code;
+}
+
+/*
+ * Find a section, and an option of it of type if option isn't NULL
+ * Return 0 for success, the code of the failure otherwise
+ */
+static int __find(easy_uci_session* s,const char* package,const char* section,const char* option,enum uci_option_type type,struct uci_section** sec_p,struct uci_option** opt_p)
+{
+    struct eu_package* p;
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        last_error.uci_err=s->ctx->err;
+        return __fail(s->ctx->err==UCI_ERR_NOTFOUND?EASY_UCI_ENOPACKAGE:EASY_UCI_ELOAD,package);
+    }
+
+    *sec_p=__eu_index_section(p,section);
+    if(*sec_p==NULL)
+    {
+        return __fail(EASY_UCI_ENOSECTION,section);
+    }
+
+    if(option==NULL)
+    {
+        return 0;
+    }
+
+    *opt_p=__eu_index_option(p,*sec_p,option);
+    if(*opt_p==NULL)
+    {
+        return __fail(EASY_UCI_ENOOPTION,option);
+    }
+
+    if((*opt_p)->type!=type)
+    {
+        last_error.what=type==UCI_TYPE_STRING?"a string":"a list";
+        return __fail(EASY_UCI_EWRONGTYPE,option);
+    }
+
+    return 0;
+}
+
+/*
+ * Copy str to buff like the getters, which cuts it to size-1 chars
+ * Return 0 for success, EASY_UCI_ETRUNC if str was cut
+ */
+static int __copy(const char* str,const char* name,char* buff,size_t size)
+{
+    size_t len;
+
+    len=strlen(str);
+    if(len<size)
+    {
+        memcpy(buff,str,len+1);
+        return 0;
+    }
+
+    if(size>0)
+    {
+        memcpy(buff,str,size-1);
+        buff[size-1]='\0';
+    }
+
+    return __fail(EASY_UCI_ETRUNC,name);
+}
+
+int easy_uci_last_error(char* buff,size_t size)
+{
+    const char* name=last_error.name;
+
+    if(buff==NULL||size==0)
+    {
+        return last_error.code;
+    }
+
+    switch(last_error.code)
+    {
+    case 0:
+        snprintf(buff,size,"No error");
+        break;
+    case EASY_UCI_ENOPACKAGE:
+        snprintf(buff,size,"Package: '%s' doesn't exist",name);
+        break;
+    case EASY_UCI_ELOAD:
+        snprintf(buff,size,"Failed to load package: '%s' with uci error %d",name,last_error.uci_err);
+        break;
+    case EASY_UCI_ENOSECTION:
+        snprintf(buff,size,"Failed to find section: '%s'",name);
+        break;
+    case EASY_UCI_ENOOPTION:
+        snprintf(buff,size,"Failed to find option: '%s'",name);
+        break;
+    case EASY_UCI_EWRONGTYPE:
+        snprintf(buff,size,"Option: '%s' is not %s",name,last_error.what);
+        break;
+    case EASY_UCI_ETRUNC:
+        snprintf(buff,size,"The value of: '%s' doesn't fit in the buffer",name);
+        break;
+    default:
+        snprintf(buff,size,"Out of memory");
+        break;
+    }
+
+    return last_error.code;
+}
+
+int easy_uci_session_try_get_section_type(easy_uci_session* s,const char* package,const char* section,char* buff,size_t size)
+{
+    int ret;
+    struct uci_section* sec;
+
+    ret=__find(s,package,section,NULL,UCI_TYPE_STRING,&sec,NULL);
+    if(ret!=0)
+    {
+        return ret;
+    }
+
+    return __copy(sec->type,section,buff,size);
+}
+
+int easy_uci_session_try_get_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,char* buff,size_t size)
+{
+    int ret;
+    struct uci_section* sec;
+    struct uci_option* opt;
+
+    ret=__find(s,package,section,option,UCI_TYPE_STRING,&sec,&opt);
+    if(ret!=0)
+    {
+        return ret;
+    }
+
+    return __copy(opt->v.string,option,buff,size);
+}
+
+int easy_uci_session_try_get_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p)
+{
+    int ret;
+    size_t count=0;
+    size_t bytes=0;
+    size_t len;
+    struct uci_section* sec;
+    struct uci_option* opt;
+    struct uci_element* e;
+    easy_uci_list list;
+    char* buff;
+
+    ret=__find(s,package,section,option,UCI_TYPE_LIST,&sec,&opt);
+    if(ret!=0)
+    {
+        return ret;
+    }
+
+    uci_foreach_element(&opt->v.list,e)
+    {
+        ++count;
+        bytes+=strlen(e->name)+1;
+    }
+
+    if(count==0)
+    {
+        list_p->list=NULL;
+        list_p->len=0;
+        return 0;
+    }
+
+    buff=__eu_list_alloc(&list,count,bytes);
+    if(buff==NULL)
+    {
+        return __fail(EASY_UCI_ENOMEM,option);
+    }
+
+    count=0;
+    uci_foreach_element(&opt->v.list,e)
+    {
+        len=strlen(e->name)+1;
+        memcpy(buff,e->name,len);
+        list.list[count++]=buff;
+        buff+=len;
+    }
+
+    *list_p=list;
+
+    return 0;
+}
+
+int easy_uci_session_try_view_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* view_p)
+{
+    int ret;
+    struct uci_section* sec;
+    struct uci_option* opt;
+
+    ret=__find(s,package,section,option,UCI_TYPE_STRING,&sec,&opt);
+    if(ret!=0)
+    {
+        return ret;
+    }
+
+    view_p->str=opt->v.string;
+    view_p->len=strlen(opt->v.string);
+
+    return 0;
+}
+
+int easy_uci_try_get_section_type(const char* package,const char* section,char* buff,size_t size)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return __fail(EASY_UCI_ENOMEM,package);
+    }
+
+    ret=easy_uci_session_try_get_section_type(s,package,section,buff,size);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_try_get_option_string(const char* package,const char* section,const char* option,char* buff,size_t size)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return __fail(EASY_UCI_ENOMEM,package);
+    }
+
+    ret=easy_uci_session_try_get_option_string(s,package,section,option,buff,size);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_try_get_option_list(const char* package,const char* section,const char* option,easy_uci_list* list_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return __fail(EASY_UCI_ENOMEM,package);
+    }
+
+    ret=easy_uci_session_try_get_option_list(s,package,section,option,list_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
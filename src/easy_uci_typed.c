@@ -0,0 +1,374 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+/*
+ * Find the value of a string option
+ * Return EASY_UCI_OK, EASY_UCI_DEFAULT if either the section or the option doesn't exist,
+ * EASY_UCI_MALFORMED if the option is a list or EASY_UCI_ERROR if the package can't be loaded
+ */
+static int __lookup(easy_uci_session* s,const char* package,const char* section,const char* option,const char** value_p)
+{
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        uci_get_errorstr(s->ctx,&err_str,err_msg);
+        LogE(err_str);
+        free(err_str);
+        return EASY_UCI_ERROR;
+    }
+
+    sec=__eu_index_section(p,section);
+    opt=sec==NULL?NULL:__eu_index_option(p,sec,option);
+    if(opt==NULL)
+    {
+        return EASY_UCI_DEFAULT;
+    }
+
+    if(opt->type!=UCI_TYPE_STRING)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a string",option);
+        LogE(err_msg);
+        return EASY_UCI_MALFORMED;
+    }
+
+    *value_p=opt->v.string;
+
+    return EASY_UCI_OK;
+}
+
+static int __malformed(const char* option,const char* value,const char* what)
+{
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    snprintf(err_msg,sizeof(err_msg),"Option: '%s' with value: '%s' is not %s",option,value,what);
+    LogE(err_msg);
+
+    return EASY_UCI_MALFORMED;
+}
+
+int easy_uci_session_get_option_int(easy_uci_session* s,const char* package,const char* section,const char* option,long def,long* value_p)
+{
+    int ret;
+    long v;
+    char* end;
+    const char* value;
+
+    ret=__lookup(s,package,section,option,&value);
+    if(ret==EASY_UCI_DEFAULT)
+    {
+        *value_p=def;
+    }
+    if(ret!=EASY_UCI_OK)
+    {
+        return ret;
+    }
+
+    errno=0;
+    v=strtol(value,&end,0);
+    if(end==value||*end!='\0'||errno!=0)
+    {
+        return __malformed(option,value,"an integer");
+    }
+
+    *value_p=v;
+
+    return EASY_UCI_OK;
+}
+
+int easy_uci_session_get_option_uint(easy_uci_session* s,const char* package,const char* section,const char* option,unsigned long def,unsigned long* value_p)
+{
+    int ret;
+    unsigned long v;
+    char* end;
+    const char* value;
+
+    ret=__lookup(s,package,section,option,&value);
+    if(ret==EASY_UCI_DEFAULT)
+    {
+        *value_p=def;
+    }
+    if(ret!=EASY_UCI_OK)
+    {
+        return ret;
+    }
+
+    //strtoul() takes "-1" as ULONG_MAX
+    errno=0;
+    v=strtoul(value,&end,0);
+    if(end==value||*end!='\0'||errno!=0||strchr(value,'-')!=NULL)
+    {
+        return __malformed(option,value,"an unsigned integer");
+    }
+
+    *value_p=v;
+
+    return EASY_UCI_OK;
+}
+
+int easy_uci_session_get_option_bool(easy_uci_session* s,const char* package,const char* section,const char* option,bool def,bool* value_p)
+{
+    int ret;
+    size_t i;
+    const char* value;
+    static const char* const trues[]={"1","yes","on","true","enabled"};
+    static const char* const falses[]={"0","no","off","false","disabled"};
+
+    ret=__lookup(s,package,section,option,&value);
+    if(ret==EASY_UCI_DEFAULT)
+    {
+        *value_p=def;
+    }
+    if(ret!=EASY_UCI_OK)
+    {
+        return ret;
+    }
+
+    //The same words as config_get_bool of the uci shell functions
+    for(i=0;i<sizeof(trues)/sizeof(trues[0]);++i)
+    {
+        if(strcasecmp(value,trues[i])==0)
+        {
+            *value_p=true;
+            return EASY_UCI_OK;
+        }
+        if(strcasecmp(value,falses[i])==0)
+        {
+            *value_p=false;
+            return EASY_UCI_OK;
+        }
+    }
+
+    return __malformed(option,value,"a boolean");
+}
+
+int easy_uci_session_get_option_double(easy_uci_session* s,const char* package,const char* section,const char* option,double def,double* value_p)
+{
+    int ret;
+    double v;
+    char* end;
+    const char* value;
+
+    ret=__lookup(s,package,section,option,&value);
+    if(ret==EASY_UCI_DEFAULT)
+    {
+        *value_p=def;
+    }
+    if(ret!=EASY_UCI_OK)
+    {
+        return ret;
+    }
+
+    errno=0;
+    v=strtod(value,&end);
+    if(end==value||*end!='\0'||errno!=0)
+    {
+        return __malformed(option,value,"a number");
+    }
+
+    *value_p=v;
+
+    return EASY_UCI_OK;
+}
+
+/*
+ * Parse a prefix length, either a number or an IPv4 netmask
+ * Return the prefix length or -1 if malformed
+ */
+static int __parse_prefix(const char* str,int family)
+{
+    int i;
+    long v;
+    char* end;
+    unsigned long mask;
+    struct in_addr addr;
+
+    if(family==AF_INET&&strchr(str,'.')!=NULL)
+    {
+        if(inet_pton(AF_INET,str,&addr)!=1)
+        {
+            return -1;
+        }
+
+        //The mask must be contiguous ones followed by zeros
+        mask=ntohl(addr.s_addr);
+        for(i=0;i<32&&(mask&0x80000000UL);++i)
+        {
+            mask=(mask<<1)&0xffffffffUL;
+        }
+
+        return mask==0?i:-1;
+    }
+
+    errno=0;
+    v=strtol(str,&end,10);
+    if(end==str||*end!='\0'||errno!=0||v<0||v>(family==AF_INET?32:128))
+    {
+        return -1;
+    }
+
+    return (int)v;
+}
+
+int easy_uci_session_get_option_ipaddr(easy_uci_session* s,const char* package,const char* section,const char* option,const easy_uci_ipaddr* def,easy_uci_ipaddr* value_p)
+{
+    int ret;
+    size_t len;
+    const char* value;
+    const char* slash;
+    //inet_pton() needs the address '\0' terminated, without the prefix
+    char addr[INET6_ADDRSTRLEN];
+    easy_uci_ipaddr v;
+
+    ret=__lookup(s,package,section,option,&value);
+    if(ret==EASY_UCI_DEFAULT&&def!=NULL)
+    {
+        *value_p=*def;
+    }
+    if(ret!=EASY_UCI_OK)
+    {
+        return ret;
+    }
+
+    memset(&v,0,sizeof(v));
+    v.prefix=-1;
+
+    slash=strchr(value,'/');
+    len=slash==NULL?strlen(value):(size_t)(slash-value);
+    if(len>=sizeof(addr))
+    {
+        return __malformed(option,value,"an IP address");
+    }
+    memcpy(addr,value,len);
+    addr[len]='\0';
+
+    if(inet_pton(AF_INET,addr,v.addr)==1)
+    {
+        v.family=AF_INET;
+    }
+    else if(inet_pton(AF_INET6,addr,v.addr)==1)
+    {
+        v.family=AF_INET6;
+    }
+    else
+    {
+        return __malformed(option,value,"an IP address");
+    }
+
+    if(slash!=NULL)
+    {
+        v.prefix=__parse_prefix(slash+1,v.family);
+        if(v.prefix<0)
+        {
+            return __malformed(option,value,"an IP address");
+        }
+    }
+
+    *value_p=v;
+
+    return EASY_UCI_OK;
+}
+
+int easy_uci_get_option_int(const char* package,const char* section,const char* option,long def,long* value_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return EASY_UCI_ERROR;
+    }
+
+    ret=easy_uci_session_get_option_int(s,package,section,option,def,value_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_uint(const char* package,const char* section,const char* option,unsigned long def,unsigned long* value_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return EASY_UCI_ERROR;
+    }
+
+    ret=easy_uci_session_get_option_uint(s,package,section,option,def,value_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_bool(const char* package,const char* section,const char* option,bool def,bool* value_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return EASY_UCI_ERROR;
+    }
+
+    ret=easy_uci_session_get_option_bool(s,package,section,option,def,value_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_double(const char* package,const char* section,const char* option,double def,double* value_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return EASY_UCI_ERROR;
+    }
+
+    ret=easy_uci_session_get_option_double(s,package,section,option,def,value_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_get_option_ipaddr(const char* package,const char* section,const char* option,const easy_uci_ipaddr* def,easy_uci_ipaddr* value_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return EASY_UCI_ERROR;
+    }
+
+    ret=easy_uci_session_get_option_ipaddr(s,package,section,option,def,value_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+int easy_uci_session_get_version(easy_uci_session* s,const char* package,easy_uci_version* version_p)
+{
+    struct eu_package* p;
+    struct eu_stamp stamp;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(strcmp(p->name,package)==0)
+        {
+            *version_p=__eu_stamp_version(&p->stamp);
+            return 0;
+        }
+    }
+
+    if(__eu_stamp_package(s->ctx,package,&stamp)!=0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to stat package: '%s'",package);
+        LogE(err_msg);
+        return -1;
+    }
+
+    *version_p=__eu_stamp_version(&stamp);
+
+    return 0;
+}
+
+/*
+ * Have the next commit of a package check its version
+ * Return 0 for success, -1 if the package can't be loaded
+ */
+static int __expect(easy_uci_session* s,const char* package,easy_uci_version version)
+{
+    struct eu_package* p;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    //A conflict drops the package from the session, with the changes other calls queued for the background writer
+    if(s->deferred&&!s->in_txn)
+    {
+        __eu_writer_commit();
+    }
+
+    p=__eu_session_load_rw(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        uci_get_errorstr(s->ctx,&err_str,err_msg);
+        LogE(err_str);
+        free(err_str);
+        __eu_session_fail(s);
+        return -1;
+    }
+
+    p->expect=true;
+    p->expected=version;
+    s->conflict=false;
+
+    return 0;
+}
+
+/*
+ * Finish a conditional write that returned ret
+ * Return the return code of the conditional setter
+ */
+static int __expect_done(easy_uci_session* s,const char* package,int ret,easy_uci_version* version_p)
+{
+    struct eu_package* p;
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(strcmp(p->name,package)==0)
+        {
+            break;
+        }
+    }
+
+    //Checked when the transaction is committed
+    if(s->in_txn)
+    {
+        return ret;
+    }
+
+    //The setter failed before committing
+    if(p!=NULL)
+    {
+        p->expect=false;
+    }
+
+    if(ret!=0&&!s->conflict)
+    {
+        return ret;
+    }
+
+    easy_uci_session_get_version(s,package,version_p);
+
+    return s->conflict?EASY_UCI_CONFLICT:0;
+}
+
+int easy_uci_session_add_section_if_version(easy_uci_session* s,const char* package,const char* type,const char* name,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_add_section(s,package,type,name);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+int easy_uci_session_delete_section_if_version(easy_uci_session* s,const char* package,const char* section,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_section(s,package,section);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+int easy_uci_session_set_option_string_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_string(s,package,section,option,value);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+int easy_uci_session_set_option_list_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_list* list_p,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_list(s,package,section,option,list_p);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+int easy_uci_session_append_to_option_list_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_append_to_option_list(s,package,section,option,value);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+int easy_uci_session_delete_option_if_version(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_version* version_p)
+{
+    int ret;
+
+    if(__expect(s,package,*version_p)!=0)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_option(s,package,section,option);
+
+    return __expect_done(s,package,ret,version_p);
+}
+
+/*
+ * The functions below each run in a session of their own
+ */
+
+int easy_uci_get_version(const char* package,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_read_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_get_version(s,package,version_p);
+
+    __eu_read_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_add_section_if_version(const char* package,const char* type,const char* name,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_add_section_if_version(s,package,type,name,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_delete_section_if_version(const char* package,const char* section,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_section_if_version(s,package,section,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_set_option_string_if_version(const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_string_if_version(s,package,section,option,value,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_set_option_list_if_version(const char* package,const char* section,const char* option,easy_uci_list* list_p,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_set_option_list_if_version(s,package,section,option,list_p,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_append_to_option_list_if_version(const char* package,const char* section,const char* option,const char* value,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_append_to_option_list_if_version(s,package,section,option,value,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
+
+int easy_uci_delete_option_if_version(const char* package,const char* section,const char* option,easy_uci_version* version_p)
+{
+    int ret;
+    easy_uci_session* s;
+
+    s=__eu_write_session_open(package);
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    ret=easy_uci_session_delete_option_if_version(s,package,section,option,version_p);
+
+    __eu_write_session_close(s);
+
+    return ret;
+}
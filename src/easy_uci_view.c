@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+int easy_uci_session_view_section_type(easy_uci_session* s,const char* package,const char* section,easy_uci_view* view_p)
+{
+    struct eu_package* p;
+    struct uci_section* sec;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    sec=__eu_index_section(p,section);
+    if(sec==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    view_p->str=sec->type;
+    view_p->len=strlen(sec->type);
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_session_view_nth_section_of_type(easy_uci_session* s,const char* package,const char* type,int n,easy_uci_view* view_p)
+{
+    struct eu_package* p;
+    struct uci_section* sec;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    sec=__eu_index_nth_of_type(p,type,n);
+    if(sec==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Can't find section of type '%s' at index %d",type,n);
+        goto error_msg;
+    }
+
+    view_p->str=sec->e.name;
+    view_p->len=strlen(sec->e.name);
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_session_view_all_section_of_type(easy_uci_session* s,const char* package,const char* type,easy_uci_view* views,size_t max,size_t* count_p)
+{
+    size_t i;
+    struct eu_package* p;
+    struct eu_type_list* tl;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    tl=__eu_index_type(p,type);
+    if(tl==NULL)
+    {
+        *count_p=0;
+        return 0;
+    }
+
+    for(i=0;i<tl->len&&i<max;++i)
+    {
+        views[i].str=tl->secs[i]->e.name;
+        views[i].len=strlen(tl->secs[i]->e.name);
+    }
+    *count_p=tl->len;
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+}
+
+int easy_uci_session_view_option_string(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* view_p)
+{
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    sec=__eu_index_section(p,section);
+    if(sec==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    opt=__eu_index_option(p,sec,option);
+    if(opt==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
+        goto error_msg;
+    }
+
+    if(opt->type!=UCI_TYPE_STRING)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a string",option);
+        goto error_msg;
+    }
+
+    view_p->str=opt->v.string;
+    view_p->len=strlen(opt->v.string);
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
+
+int easy_uci_session_view_option_list(easy_uci_session* s,const char* package,const char* section,const char* option,easy_uci_view* views,size_t max,size_t* count_p)
+{
+    size_t count=0;
+    struct eu_package* p;
+    struct uci_section* sec;
+    struct uci_option*  opt;
+    struct uci_element* e;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    p=__eu_session_load(s,package);
+    if(p==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to load package: '%s' with error",package);
+        goto error_pkg;
+    }
+
+    sec=__eu_index_section(p,section);
+    if(sec==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find section: '%s'",section);
+        goto error_msg;
+    }
+
+    opt=__eu_index_option(p,sec,option);
+    if(opt==NULL)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to find option: '%s'",option);
+        goto error_msg;
+    }
+
+    if(opt->type!=UCI_TYPE_LIST)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Option: '%s' is not a list",option);
+        goto error_msg;
+    }
+
+    uci_foreach_element(&opt->v.list,e)
+    {
+        if(count<max)
+        {
+            views[count].str=e->name;
+            views[count].len=strlen(e->name);
+        }
+        ++count;
+    }
+    *count_p=count;
+
+    return 0;
+
+error_pkg:
+    uci_get_errorstr(s->ctx,&err_str,err_msg);
+    LogE(err_str);
+    free(err_str);
+    return -1;
+error_msg:
+    LogE(err_msg);
+    return -1;
+}
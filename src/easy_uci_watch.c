@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+//Room for at least one event with the longest name
+#define WATCH_BUFF_SIZE (4096+sizeof(struct inotify_event)+NAME_MAX+1)
+//How many changed packages are collected before the callback is called, the array of them grows by as many
+#define WATCH_BATCH 32
+
+#define WATCH_MASK (IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE)
+
+struct easy_uci_watch
+{
+    int fd;
+    int conf_wd;
+    int save_wd;
+    easy_uci_watch_cb cb;
+    void* arg;
+};
+
+easy_uci_watch* easy_uci_watch_open(easy_uci_watch_cb cb,void* arg)
+{
+    easy_uci_watch* w;
+    easy_uci_session* s;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    w=calloc(1,sizeof(easy_uci_watch));
+    if(w==NULL)
+    {
+        LogE("Failed to alloc watch");
+        return NULL;
+    }
+    w->cb=cb;
+    w->arg=arg;
+    w->save_wd=-1;
+
+    //Only for the directories it's set up with
+    s=easy_uci_session_open();
+    if(s==NULL)
+    {
+        free(w);
+        return NULL;
+    }
+
+    w->fd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if(w->fd<0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to init inotify: %s",strerror(errno));
+        goto error;
+    }
+
+    w->conf_wd=inotify_add_watch(w->fd,s->ctx->confdir,WATCH_MASK);
+    if(w->conf_wd<0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to watch: '%s' with error: %s",s->ctx->confdir,strerror(errno));
+        goto error;
+    }
+
+    //The savedir is only created by the first staged write, create it to watch it from the start
+    mkdir(s->ctx->savedir,0700);
+    w->save_wd=inotify_add_watch(w->fd,s->ctx->savedir,WATCH_MASK);
+    if(w->save_wd<0)
+    {
+        snprintf(err_msg,sizeof(err_msg),"Failed to watch: '%s' with error: %s",s->ctx->savedir,strerror(errno));
+        goto error;
+    }
+
+    easy_uci_session_close(s);
+
+    return w;
+
+error:
+    LogE(err_msg);
+    if(w->fd>=0)
+    {
+        close(w->fd);
+    }
+    easy_uci_session_close(s);
+    free(w);
+    return NULL;
+}
+
+void easy_uci_watch_close(easy_uci_watch* w)
+{
+    if(w==NULL)
+    {
+        return;
+    }
+
+    close(w->fd);
+    free(w);
+}
+
+int easy_uci_watch_fd(easy_uci_watch* w)
+{
+    return w->fd;
+}
+
+/*
+ * The packages changed in one call of easy_uci_watch_dispatch(), the first reported of them have been reported
+ */
+struct eu_watch_names
+{
+    char** names;
+    size_t count;
+    size_t cap;
+    size_t reported;
+};
+
+/*
+ * Report the changed packages collected
+ */
+static void __flush(easy_uci_watch* w,struct eu_watch_names* n)
+{
+    for(;n->reported<n->count;++n->reported)
+    {
+        easy_uci_cache_invalidate(n->names[n->reported]);
+        if(w->cb!=NULL)
+        {
+            w->cb(n->names[n->reported],w->arg);
+        }
+    }
+}
+
+/*
+ * Collect a changed package, the batch collected is reported first when it's full
+ * Return 0 for success, 1 if the package was already collected, -1 for failure
+ */
+static int __collect(easy_uci_watch* w,struct eu_watch_names* n,const char* name)
+{
+    size_t i;
+    char** names;
+
+    //A commit writes both the config file and the delta file, report the package once
+    for(i=0;i<n->count;++i)
+    {
+        if(strcmp(n->names[i],name)==0)
+        {
+            return 1;
+        }
+    }
+
+    if(n->count-n->reported==WATCH_BATCH)
+    {
+        __flush(w,n);
+    }
+
+    if(n->count==n->cap)
+    {
+        names=realloc(n->names,(n->cap+WATCH_BATCH)*sizeof(char*));
+        if(names==NULL)
+        {
+            return -1;
+        }
+        n->names=names;
+        n->cap+=WATCH_BATCH;
+    }
+
+    n->names[n->count]=strdup(name);
+    if(n->names[n->count]==NULL)
+    {
+        return -1;
+    }
+    ++n->count;
+
+    return 0;
+}
+
+int easy_uci_watch_dispatch(easy_uci_watch* w)
+{
+    int ret=0;
+    int collected;
+    ssize_t len;
+    size_t i;
+    const struct inotify_event* ev;
+    char* pos;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+    char buff[WATCH_BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct eu_watch_names names;
+
+    memset(&names,0,sizeof(names));
+
+    while(true)
+    {
+        len=read(w->fd,buff,sizeof(buff));
+        if(len<0)
+        {
+            if(errno==EINTR)
+            {
+                continue;
+            }
+            if(errno==EAGAIN||errno==EWOULDBLOCK)
+            {
+                break;
+            }
+            snprintf(err_msg,sizeof(err_msg),"Failed to read inotify events: %s",strerror(errno));
+            LogE(err_msg);
+            ret=-1;
+            break;
+        }
+
+        for(pos=buff;pos<buff+len;pos+=sizeof(struct inotify_event)+ev->len)
+        {
+            ev=(const struct inotify_event*)pos;
+
+            //Events were dropped, any package may have changed
+            if(ev->mask&IN_Q_OVERFLOW)
+            {
+                __flush(w,&names);
+                easy_uci_cache_invalidate(NULL);
+                if(w->cb!=NULL)
+                {
+                    w->cb(NULL,w->arg);
+                }
+                ++ret;
+                continue;
+            }
+
+            //Package names have no '.', which skips temp files of libuci and lock files of easy_uci
+            if(ev->len==0||ev->name[0]=='\0'||strchr(ev->name,'.')!=NULL)
+            {
+                continue;
+            }
+
+            collected=__collect(w,&names,ev->name);
+            if(collected<0)
+            {
+                //Reported right away, it may be reported again in this call
+                LogE("Failed to alloc changed package");
+                __flush(w,&names);
+                easy_uci_cache_invalidate(ev->name);
+                if(w->cb!=NULL)
+                {
+                    w->cb(ev->name,w->arg);
+                }
+            }
+            if(collected<=0)
+            {
+                ++ret;
+            }
+        }
+    }
+
+    __flush(w,&names);
+
+    for(i=0;i<names.count;++i)
+    {
+        free(names.names[i]);
+    }
+    free(names.names);
+
+    return ret;
+}
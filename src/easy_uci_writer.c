@@ -0,0 +1,429 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <uci.h>
+
+#include "easy_uci_internal.h"
+
+/*
+ * All the state below is guarded by writer_lock, so is writer_session while it's not NULL
+ * The thread commits with the lock released: it swaps in a new session for the calls made meanwhile and lists the
+ * packages it commits in writer_busy, a call on one of those waits for the commit to finish
+ */
+static pthread_mutex_t writer_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake;
+static pthread_cond_t writer_synced;
+//Broadcast when a commit made with the lock released is done, never destroyed as callers may still be waking up
+static pthread_cond_t writer_idle=PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static easy_uci_session* writer_session=NULL;
+static char** writer_busy=NULL;
+static size_t writer_busy_len=0;
+static unsigned int writer_debounce_ms;
+static bool writer_stop=false;
+//Set when the first change after a commit is queued, the thread commits at writer_deadline
+static bool writer_pending=false;
+static struct timespec writer_deadline;
+//A sync is requested by bumping writer_sync_gen and done when writer_synced_gen has caught up
+static unsigned long writer_sync_gen=0;
+static unsigned long writer_synced_gen=0;
+static easy_uci_writer_stats writer_stats;
+
+static easy_uci_session* __writer_session_open(void)
+{
+    easy_uci_session* s;
+
+    s=easy_uci_session_open();
+    if(s==NULL)
+    {
+        return NULL;
+    }
+    //Packages with queued changes are kept, others are reloaded when changed outside
+    s->validate=true;
+    s->deferred=true;
+
+    return s;
+}
+
+/*
+ * Commit the changed packages of s and count them in stats
+ */
+static void __commit_session(easy_uci_session* s,easy_uci_writer_stats* stats)
+{
+    unsigned long pending;
+    struct eu_package* p;
+    struct eu_package* next;
+    char* err_str=NULL;
+    char err_msg[ERR_MSG_BUFF_SIZE];
+
+    s->deferred=false;
+
+    for(p=s->packages;p!=NULL;p=next)
+    {
+        next=p->next;
+        if(!p->dirty)
+        {
+            continue;
+        }
+
+        pending=p->pending;
+        p->dirty=false;
+        p->pending=0;
+
+        //p is freed if the commit fails
+        snprintf(err_msg,sizeof(err_msg),"Failed to commit package: '%s' with error",p->name);
+        if(__eu_session_commit(s,p)!=0)
+        {
+            uci_get_errorstr(s->ctx,&err_str,err_msg);
+            LogE(err_str);
+            free(err_str);
+            err_str=NULL;
+            ++stats->failures;
+        }
+        else
+        {
+            ++stats->commits;
+            stats->coalesced+=pending>0?pending-1:0;
+        }
+        stats->writes+=pending;
+    }
+
+    s->deferred=true;
+}
+
+/*
+ * Commit the changes queued with writer_lock held
+ */
+static void __commit_all(void)
+{
+    __commit_session(writer_session,&writer_stats);
+    writer_pending=false;
+}
+
+static void __busy_free(char** busy,size_t len)
+{
+    size_t i;
+
+    for(i=0;i<len;++i)
+    {
+        free(busy[i]);
+    }
+    free(busy);
+}
+
+static bool __busy(const char* package)
+{
+    size_t i;
+
+    for(i=0;i<writer_busy_len;++i)
+    {
+        if(package==NULL||strcmp(writer_busy[i],package)==0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Commit the changes queued, called by the thread with writer_lock held, which is released for the commit
+ * Calls on other packages go on meanwhile, in a new session
+ */
+static void __commit_unlocked(void)
+{
+    size_t n=0;
+    struct eu_package* p;
+    easy_uci_session* s=writer_session;
+    easy_uci_session* next_s=NULL;
+    char** busy=NULL;
+    easy_uci_writer_stats stats;
+
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        n+=p->dirty?1:0;
+    }
+    if(n==0)
+    {
+        writer_pending=false;
+        return;
+    }
+
+    busy=calloc(n,sizeof(char*));
+    if(busy==NULL)
+    {
+        goto error;
+    }
+    n=0;
+    for(p=s->packages;p!=NULL;p=p->next)
+    {
+        if(p->dirty)
+        {
+            busy[n]=strdup(p->name);
+            if(busy[n++]==NULL)
+            {
+                goto error;
+            }
+        }
+    }
+
+    next_s=__writer_session_open();
+    if(next_s==NULL)
+    {
+        goto error;
+    }
+
+    writer_session=next_s;
+    writer_busy=busy;
+    writer_busy_len=n;
+    writer_pending=false;
+
+    pthread_mutex_unlock(&writer_lock);
+
+    memset(&stats,0,sizeof(stats));
+    __commit_session(s,&stats);
+    easy_uci_session_close(s);
+
+    pthread_mutex_lock(&writer_lock);
+
+    writer_stats.writes+=stats.writes;
+    writer_stats.commits+=stats.commits;
+    writer_stats.coalesced+=stats.coalesced;
+    writer_stats.failures+=stats.failures;
+    __busy_free(writer_busy,writer_busy_len);
+    writer_busy=NULL;
+    writer_busy_len=0;
+    pthread_cond_broadcast(&writer_idle);
+
+    return;
+
+error:
+    //Out of memory, the other calls wait for the commit then
+    __busy_free(busy,busy==NULL?0:n);
+    __commit_all();
+}
+
+static void* __writer_main(void* arg)
+{
+    unsigned long gen;
+    easy_uci_session* s;
+
+    (void)arg;
+
+    pthread_mutex_lock(&writer_lock);
+
+    while(true)
+    {
+        //Changes queued while the lock is released would be lost when stopping, so the last commit holds it
+        if(writer_stop)
+        {
+            __commit_all();
+            writer_synced_gen=writer_sync_gen;
+            break;
+        }
+
+        if(writer_synced_gen!=writer_sync_gen)
+        {
+            gen=writer_sync_gen;
+            __commit_unlocked();
+            writer_synced_gen=gen;
+            pthread_cond_broadcast(&writer_synced);
+            continue;
+        }
+
+        if(!writer_pending)
+        {
+            pthread_cond_wait(&writer_wake,&writer_lock);
+            continue;
+        }
+
+        if(pthread_cond_timedwait(&writer_wake,&writer_lock,&writer_deadline)==ETIMEDOUT)
+        {
+            __commit_unlocked();
+        }
+    }
+
+    //Setters from now on run in sessions of their own
+    s=writer_session;
+    writer_session=NULL;
+    pthread_cond_broadcast(&writer_synced);
+
+    pthread_mutex_unlock(&writer_lock);
+
+    easy_uci_session_close(s);
+
+    return NULL;
+}
+
+int easy_uci_writer_start(unsigned int debounce_ms)
+{
+    easy_uci_session* s;
+    pthread_condattr_t attr;
+
+    pthread_mutex_lock(&writer_lock);
+
+    if(writer_session!=NULL||writer_stop)
+    {
+        pthread_mutex_unlock(&writer_lock);
+        LogE("The background writer is already running");
+        return -1;
+    }
+
+    s=__writer_session_open();
+    if(s==NULL)
+    {
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr,CLOCK_MONOTONIC);
+    pthread_cond_init(&writer_wake,&attr);
+    pthread_cond_init(&writer_synced,NULL);
+    pthread_condattr_destroy(&attr);
+
+    writer_debounce_ms=debounce_ms;
+    writer_pending=false;
+    writer_sync_gen=0;
+    writer_synced_gen=0;
+    memset(&writer_stats,0,sizeof(writer_stats));
+
+    if(pthread_create(&writer_thread,NULL,__writer_main,NULL)!=0)
+    {
+        pthread_cond_destroy(&writer_wake);
+        pthread_cond_destroy(&writer_synced);
+        easy_uci_session_close(s);
+        pthread_mutex_unlock(&writer_lock);
+        LogE("Failed to create the background writer thread");
+        return -1;
+    }
+
+    writer_session=s;
+
+    pthread_mutex_unlock(&writer_lock);
+
+    return 0;
+}
+
+void easy_uci_writer_stop(void)
+{
+    pthread_mutex_lock(&writer_lock);
+
+    if(writer_session==NULL||writer_stop)
+    {
+        pthread_mutex_unlock(&writer_lock);
+        return;
+    }
+
+    writer_stop=true;
+    pthread_cond_signal(&writer_wake);
+
+    pthread_mutex_unlock(&writer_lock);
+
+    //The thread commits what's left and closes its session before it exits
+    pthread_join(writer_thread,NULL);
+
+    pthread_cond_destroy(&writer_wake);
+    pthread_cond_destroy(&writer_synced);
+
+    pthread_mutex_lock(&writer_lock);
+    writer_stop=false;
+    pthread_mutex_unlock(&writer_lock);
+}
+
+int easy_uci_writer_sync(void)
+{
+    unsigned long gen;
+    unsigned long failures;
+
+    pthread_mutex_lock(&writer_lock);
+
+    if(writer_session==NULL)
+    {
+        pthread_mutex_unlock(&writer_lock);
+        return 0;
+    }
+
+    failures=writer_stats.failures;
+    gen=++writer_sync_gen;
+    pthread_cond_signal(&writer_wake);
+
+    while(writer_synced_gen<gen&&writer_session!=NULL)
+    {
+        pthread_cond_wait(&writer_synced,&writer_lock);
+    }
+
+    failures=writer_stats.failures-failures;
+
+    pthread_mutex_unlock(&writer_lock);
+
+    return failures==0?0:-1;
+}
+
+void easy_uci_writer_get_stats(easy_uci_writer_stats* stats)
+{
+    pthread_mutex_lock(&writer_lock);
+    *stats=writer_stats;
+    pthread_mutex_unlock(&writer_lock);
+}
+
+easy_uci_session* __eu_writer_acquire(const char* package)
+{
+    pthread_mutex_lock(&writer_lock);
+
+    //A package being committed is loaded again once it's written
+    while(writer_session!=NULL&&__busy(package))
+    {
+        pthread_cond_wait(&writer_idle,&writer_lock);
+    }
+
+    if(writer_session==NULL)
+    {
+        pthread_mutex_unlock(&writer_lock);
+        return NULL;
+    }
+
+    return writer_session;
+}
+
+void __eu_writer_commit(void)
+{
+    __commit_all();
+}
+
+void __eu_writer_release(easy_uci_session* s)
+{
+    struct eu_package* p;
+
+    if(!writer_pending)
+    {
+        for(p=s->packages;p!=NULL;p=p->next)
+        {
+            if(p->dirty)
+            {
+                break;
+            }
+        }
+
+        //Start the debounce window with the first change queued
+        if(p!=NULL)
+        {
+            clock_gettime(CLOCK_MONOTONIC,&writer_deadline);
+            writer_deadline.tv_sec+=writer_debounce_ms/1000;
+            writer_deadline.tv_nsec+=(long)(writer_debounce_ms%1000)*1000000;
+            if(writer_deadline.tv_nsec>=1000000000)
+            {
+                ++writer_deadline.tv_sec;
+                writer_deadline.tv_nsec-=1000000000;
+            }
+            writer_pending=true;
+            pthread_cond_signal(&writer_wake);
+        }
+    }
+
+    pthread_mutex_unlock(&writer_lock);
+}
@@ -0,0 +1,412 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "easy_uci.h"
+
+/*
+ * Crash test of commits changing many packages
+ * A child commits a transaction over all the packages and is killed right before its nth write, fsync, rename or
+ * unlink, for every n the commit makes. Recovery is then killed the same way until it gets through, and the
+ * packages must all hold either the old or the new transaction, with the journal and its temp files gone
+ */
+
+#define JOURNAL_PACKAGES 3
+#define JOURNAL_BUFF_SIZE 64
+#define JOURNAL_FILE ".easy_uci.journal"
+#define JOURNAL_TEMP_SUFFIX ".easy_uci-new"
+
+static char base_dir[256];
+static char conf_dir[300];
+static char save_dir[300];
+
+static const char* packages[JOURNAL_PACKAGES]={"network","firewall","dhcp"};
+
+/*
+ * Kill hooks
+ * The calls making a commit durable are interposed by defining them here, the library resolves them to the
+ * executable first. Once armed, the process kills itself right before call number kill_at
+ */
+
+static bool armed=false;
+static long steps=0;
+static long kill_at=0;
+
+static ssize_t (*real_write)(int,const void*,size_t)=NULL;
+static int (*real_fsync)(int)=NULL;
+static int (*real_fdatasync)(int)=NULL;
+static int (*real_rename)(const char*,const char*)=NULL;
+static int (*real_unlink)(const char*)=NULL;
+
+static void __step(void)
+{
+    if(armed&&++steps==kill_at)
+    {
+        raise(SIGKILL);
+    }
+}
+
+ssize_t write(int fd,const void* buff,size_t count)
+{
+    if(real_write==NULL)
+    {
+        real_write=dlsym(RTLD_NEXT,"write");
+    }
+
+    __step();
+    return real_write(fd,buff,count);
+}
+
+int fsync(int fd)
+{
+    if(real_fsync==NULL)
+    {
+        real_fsync=dlsym(RTLD_NEXT,"fsync");
+    }
+
+    __step();
+    return real_fsync(fd);
+}
+
+int fdatasync(int fd)
+{
+    if(real_fdatasync==NULL)
+    {
+        real_fdatasync=dlsym(RTLD_NEXT,"fdatasync");
+    }
+
+    __step();
+    return real_fdatasync(fd);
+}
+
+int rename(const char* old_path,const char* new_path)
+{
+    if(real_rename==NULL)
+    {
+        real_rename=dlsym(RTLD_NEXT,"rename");
+    }
+
+    __step();
+    return real_rename(old_path,new_path);
+}
+
+int unlink(const char* path)
+{
+    if(real_unlink==NULL)
+    {
+        real_unlink=dlsym(RTLD_NEXT,"unlink");
+    }
+
+    __step();
+    return real_unlink(path);
+}
+
+static void __quiet_logger(const char* msg)
+{
+    (void)msg;
+}
+
+static bool __exists(const char* dir,const char* prefix,const char* name,const char* suffix)
+{
+    char path[512];
+
+    snprintf(path,sizeof(path),"%s/%s%s%s",dir,prefix,name,suffix);
+
+    return access(path,F_OK)==0;
+}
+
+static long __gen(const char* package)
+{
+    char buff[JOURNAL_BUFF_SIZE];
+
+    if(easy_uci_get_option_string(package,"main","gen",buff,sizeof(buff))!=0)
+    {
+        return -1;
+    }
+
+    return strtol(buff,NULL,10);
+}
+
+/*
+ * Stage a change to the first package, which the next commit folds into its config file
+ */
+static int __stage(long k)
+{
+    int ret;
+    char buff[JOURNAL_BUFF_SIZE];
+    easy_uci_session* s;
+
+    s=easy_uci_session_open();
+    if(s==NULL)
+    {
+        return -1;
+    }
+
+    snprintf(buff,sizeof(buff),"%ld",k);
+    easy_uci_session_stage_enable(s,true);
+    ret=easy_uci_session_set_option_string(s,packages[0],"main","staged",buff);
+    easy_uci_session_close(s);
+
+    return ret;
+}
+
+/*
+ * Commit gen to all packages in one transaction, with the kill hooks armed for the commit
+ */
+static int __commit(long gen)
+{
+    int ret=0;
+    size_t i;
+    char buff[JOURNAL_BUFF_SIZE];
+    easy_uci_session* s;
+
+    s=easy_uci_session_open();
+    if(s==NULL||easy_uci_session_begin(s)!=0)
+    {
+        easy_uci_session_close(s);
+        return -1;
+    }
+
+    snprintf(buff,sizeof(buff),"%ld",gen);
+    for(i=0;i<JOURNAL_PACKAGES;++i)
+    {
+        ret|=easy_uci_session_set_option_string(s,packages[i],"main","gen",buff);
+    }
+
+    armed=true;
+    ret|=easy_uci_session_commit(s);
+    armed=false;
+    easy_uci_session_close(s);
+
+    return ret;
+}
+
+/*
+ * Run fn in a child killed at step k
+ * Return 1 if it was killed, 0 if it got through, -1 for failure
+ */
+static int __run_killed(int (*fn)(long),long arg,long k)
+{
+    int status;
+    pid_t pid;
+
+    pid=fork();
+    if(pid<0)
+    {
+        perror("fork");
+        return -1;
+    }
+
+    if(pid==0)
+    {
+        steps=0;
+        kill_at=k;
+        _exit(fn(arg)==0?0:1);
+    }
+
+    if(waitpid(pid,&status,0)!=pid)
+    {
+        perror("waitpid");
+        return -1;
+    }
+    if(WIFSIGNALED(status)&&WTERMSIG(status)==SIGKILL)
+    {
+        return 1;
+    }
+
+    return WIFEXITED(status)&&WEXITSTATUS(status)==0?0:-1;
+}
+
+static int __recover(long arg)
+{
+    (void)arg;
+
+    //Recovery runs on the first session open after the config dir is set
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    armed=true;
+    easy_uci_session_close(easy_uci_session_open());
+    armed=false;
+
+    return 0;
+}
+
+static int __rm(const char* path,const struct stat* st,int flag,struct FTW* ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+static int __gen_packages(void)
+{
+    size_t i;
+    FILE* fp;
+    char path[400];
+
+    for(i=0;i<JOURNAL_PACKAGES;++i)
+    {
+        snprintf(path,sizeof(path),"%s/%s",conf_dir,packages[i]);
+        fp=fopen(path,"w");
+        if(fp==NULL)
+        {
+            perror("fopen");
+            return -1;
+        }
+        fprintf(fp,"config main 'main'\n\toption gen '0'\n");
+        fclose(fp);
+    }
+
+    return 0;
+}
+
+/*
+ * Check the packages after a commit of gen+1 over gen was killed and recovered
+ * Return 1 if the commit was rolled forward, 0 if it was discarded, -1 if the packages are inconsistent
+ */
+static int __check(long gen,long k)
+{
+    int ret;
+    size_t i;
+    long g;
+    char staged[JOURNAL_BUFF_SIZE];
+    char expected[JOURNAL_BUFF_SIZE];
+
+    if(__exists(conf_dir,"",JOURNAL_FILE,""))
+    {
+        fprintf(stderr,"step %ld: journal left\n",k);
+        return -1;
+    }
+
+    g=__gen(packages[0]);
+    if(g!=gen&&g!=gen+1)
+    {
+        fprintf(stderr,"step %ld: gen %ld after a commit of %ld over %ld\n",k,g,gen+1,gen);
+        return -1;
+    }
+    ret=g==gen+1;
+
+    for(i=0;i<JOURNAL_PACKAGES;++i)
+    {
+        if(__exists(conf_dir,".",packages[i],JOURNAL_TEMP_SUFFIX))
+        {
+            fprintf(stderr,"step %ld: temp file of %s left\n",k,packages[i]);
+            return -1;
+        }
+        if(__gen(packages[i])!=g)
+        {
+            fprintf(stderr,"step %ld: %s has gen %ld, %s has %ld\n",k,packages[i],__gen(packages[i]),packages[0],g);
+            return -1;
+        }
+    }
+
+    //The staged change is in the config file if the commit went through, still in the delta file otherwise
+    snprintf(expected,sizeof(expected),"%ld",k);
+    if(easy_uci_get_option_string(packages[0],"main","staged",staged,sizeof(staged))!=0||strcmp(staged,expected)!=0)
+    {
+        fprintf(stderr,"step %ld: staged change lost\n",k);
+        return -1;
+    }
+    if(ret&&__exists(save_dir,"",packages[0],""))
+    {
+        fprintf(stderr,"step %ld: delta file left after it was folded\n",k);
+        return -1;
+    }
+
+    return ret;
+}
+
+int main(int argc,char** argv)
+{
+    int ret;
+    long k;
+    long j;
+    long gen=0;
+    long total;
+    long forward=0;
+    long discarded=0;
+    long recoveries=0;
+    const char* tmp=argc>1?argv[1]:"/tmp";
+
+    snprintf(base_dir,sizeof(base_dir),"%s/easy_uci_journal.XXXXXX",tmp);
+    if(mkdtemp(base_dir)==NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    snprintf(conf_dir,sizeof(conf_dir),"%s/config",base_dir);
+    snprintf(save_dir,sizeof(save_dir),"%s/save",base_dir);
+    if(mkdir(conf_dir,0700)!=0||mkdir(save_dir,0700)!=0||__gen_packages()!=0)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    easy_uci_register_error_logger(__quiet_logger);
+
+    //A commit that isn't killed tells how many steps there are to kill it at
+    if(__stage(0)!=0||__commit(++gen)!=0||__check(gen-1,0)!=1)
+    {
+        fprintf(stderr,"Failed to commit\n");
+        return 1;
+    }
+    total=steps;
+
+    for(ret=0,k=1;k<=total&&ret==0;++k)
+    {
+        if(__stage(k)!=0||__run_killed(__commit,gen+1,k)!=1)
+        {
+            fprintf(stderr,"step %ld: the commit wasn't killed\n",k);
+            ret=-1;
+            break;
+        }
+
+        //Recovery is idempotent, each run killed at a later step finds what the one before left
+        for(j=1;(ret=__run_killed(__recover,0,j))==1;++j)
+        {
+            ++recoveries;
+        }
+        if(ret<0)
+        {
+            fprintf(stderr,"step %ld: recovery failed\n",k);
+            break;
+        }
+
+        easy_uci_set_config_dir(conf_dir,save_dir);
+        easy_uci_session_close(easy_uci_session_open());
+
+        ret=__check(gen,k);
+        if(ret>0)
+        {
+            ++forward;
+            ++gen;
+        }
+        else if(ret==0)
+        {
+            ++discarded;
+        }
+        ret=ret<0?-1:0;
+    }
+
+    nftw(base_dir,__rm,16,FTW_DEPTH|FTW_PHYS);
+
+    if(ret!=0)
+    {
+        return 1;
+    }
+    printf("journal: killed at %ld steps, %ld rolled forward, %ld discarded, %ld recoveries killed OK\n",
+        total,forward,discarded,recoveries);
+
+    return 0;
+}
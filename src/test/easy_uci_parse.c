@@ -0,0 +1,640 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include <uci.h>
+
+#include "easy_uci.h"
+
+/*
+ * Differential test of the fast parser of read-only sessions against libuci
+ * Each file of the corpus is read by a read-only session and by a normal one, which parses it with uci_load(),
+ * and every getter must give the same result in both, anonymous section names included
+ */
+
+#define PARSE_PACKAGE "parse"
+#define PARSE_MAX_TYPES 4
+#define PARSE_MAX_VIEWS 64
+#define PARSE_BUFF_SIZE 256
+
+struct parse_case
+{
+    const char* name;
+    const char* text;
+    //The types to query, the corpus doesn't need to use them all
+    const char* types[PARSE_MAX_TYPES];
+    //Whether the fast parser takes the file or leaves it to libuci
+    bool fast;
+};
+
+static const struct parse_case cases[]={
+    {
+        "anonymous",
+        "config defaults\n"
+        "\toption input 'ACCEPT'\n"
+        "\toption output 'ACCEPT'\n"
+        "\n"
+        "config zone\n"
+        "\toption name 'lan'\n"
+        "\tlist network 'lan'\n"
+        "\n"
+        "config zone\n"
+        "\toption name 'wan'\n"
+        "\tlist network 'wan'\n"
+        "\tlist network 'wan6'\n"
+        "\n"
+        "config forwarding\n"
+        "\toption src 'lan'\n"
+        "\toption dest 'wan'\n",
+        {"defaults","zone","forwarding","rule"},
+        true,
+    },
+    {
+        "mixed",
+        "# leading comment\n"
+        "config interface 'loopback'\n"
+        "\toption device 'lo'\n"
+        "\toption proto static # trailing comment\n"
+        "\n"
+        "config device\n"
+        "\toption name \"br-lan\"\n"
+        "\tlist ports 'lan1'\n"
+        "\tlist ports \"lan2\"\n"
+        "\n"
+        "config interface \"wan\"\n"
+        "\toption proto 'dhcp'\n"
+        "\toption empty ''\n"
+        "\toption spaced 'a b  c'\n"
+        "\toption joined abc'd e'\"f\"\n"
+        "\toption hash 'a#b'\n"
+        "\n"
+        "config device\n"
+        "\toption name 'eth0'\n",
+        {"interface","device",NULL,NULL},
+        true,
+    },
+    {
+        "statements",
+        "c interface lan; o proto 'static'; l dns '1.1.1.1'; l dns 8.8.8.8\n"
+        "config rule; option src 'a;b'\n"
+        "    config     rule\n"
+        "\t\toption   src   wan   \n"
+        "config interface 'guest'\n",
+        {"interface","rule",NULL,NULL},
+        true,
+    },
+    {
+        "escapes",
+        "config rule\n"
+        "\toption name \"say \\\"hi\\\"\"\n"
+        "\toption path 'C:\\dir'\n"
+        "\tlist item a\\ b\n"
+        "config rule 'named'\n"
+        "\toption name 'x'\n",
+        {"rule",NULL,NULL,NULL},
+        false,
+    },
+    {
+        "multiline",
+        "config rule\n"
+        "\toption text 'first\n"
+        "second'\n"
+        "config rule\n",
+        {"rule",NULL,NULL,NULL},
+        false,
+    },
+    {
+        "redefined",
+        "config rule\n"
+        "\toption name 'a'\n"
+        "\toption name 'b'\n"
+        "\tlist items '1'\n"
+        "config rule 'same'\n"
+        "\toption x '1'\n"
+        "config rule 'same'\n"
+        "\toption y '2'\n",
+        {"rule",NULL,NULL,NULL},
+        false,
+    },
+    {
+        "redeclared",
+        "config rule 'same'\n"
+        "\toption x '1'\n"
+        "config zone\n"
+        "\toption name 'lan'\n"
+        "config redirect 'same'\n"
+        "\toption y '2'\n",
+        {"rule","zone","redirect",NULL},
+        false,
+    },
+};
+
+static char base_dir[256];
+static char conf_dir[300];
+static char save_dir[300];
+
+static const struct parse_case* cur_case;
+static unsigned long failures=0;
+
+/*
+ * uci_load() is interposed to tell whether the fast parser took a file
+ */
+static int (*real_uci_load)(struct uci_context*,const char*,struct uci_package**)=NULL;
+static unsigned long uci_loads=0;
+
+int uci_load(struct uci_context* ctx,const char* name,struct uci_package** package)
+{
+    if(real_uci_load==NULL)
+    {
+        real_uci_load=dlsym(RTLD_NEXT,"uci_load");
+    }
+
+    ++uci_loads;
+    return real_uci_load(ctx,name,package);
+}
+
+static void __fail(const char* what,const char* arg)
+{
+    fprintf(stderr,"%s: %s: %s\n",cur_case->name,what,arg);
+    ++failures;
+}
+
+static void __quiet_logger(const char* msg)
+{
+    (void)msg;
+}
+
+static bool __str_equal(const char* a,const char* b)
+{
+    return (a==NULL&&b==NULL)||(a!=NULL&&b!=NULL&&strcmp(a,b)==0);
+}
+
+static bool __list_equal(const easy_uci_list* a,const easy_uci_list* b)
+{
+    size_t i;
+
+    if(a->len!=b->len)
+    {
+        return false;
+    }
+    for(i=0;i<a->len;++i)
+    {
+        if(strcmp(a->list[i],b->list[i])!=0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool __view_equal(const easy_uci_view* a,const easy_uci_view* b)
+{
+    return a->len==b->len&&memcmp(a->str,b->str,a->len)==0&&a->str[a->len]=='\0'&&b->str[b->len]=='\0';
+}
+
+static bool __option_equal(const easy_uci_option* a,const easy_uci_option* b)
+{
+    size_t i;
+
+    if(!__str_equal(a->name,b->name)||!__str_equal(a->value,b->value)||a->list_len!=b->list_len||(a->list==NULL)!=(b->list==NULL))
+    {
+        return false;
+    }
+    for(i=0;i<a->list_len;++i)
+    {
+        if(strcmp(a->list[i],b->list[i])!=0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Read the JSON export of the package, which covers all of it in file order
+ */
+static char* __export(easy_uci_session* s)
+{
+    FILE* fp;
+    long size;
+    char* buff;
+
+    fp=tmpfile();
+    if(fp==NULL)
+    {
+        return NULL;
+    }
+
+    if(easy_uci_session_export_json(s,PARSE_PACKAGE,fileno(fp))!=0||(size=lseek(fileno(fp),0,SEEK_END))<0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    buff=calloc(1,size+1);
+    if(buff!=NULL&&pread(fileno(fp),buff,size,0)!=size)
+    {
+        free(buff);
+        buff=NULL;
+    }
+    fclose(fp);
+
+    return buff;
+}
+
+static void __compare_option(easy_uci_session* ro,easy_uci_session* rw,const char* section,const char* option)
+{
+    int ret_ro,ret_rw;
+    size_t i;
+    size_t count_ro,count_rw;
+    char buff_ro[PARSE_BUFF_SIZE],buff_rw[PARSE_BUFF_SIZE];
+    easy_uci_list list_ro,list_rw;
+    easy_uci_view view_ro,view_rw;
+    easy_uci_view views_ro[PARSE_MAX_VIEWS],views_rw[PARSE_MAX_VIEWS];
+    easy_uci_predicate pred;
+
+    ret_ro=easy_uci_session_get_option_string(ro,PARSE_PACKAGE,section,option,buff_ro,sizeof(buff_ro));
+    ret_rw=easy_uci_session_get_option_string(rw,PARSE_PACKAGE,section,option,buff_rw,sizeof(buff_rw));
+    if(ret_ro!=ret_rw||(ret_ro==0&&strcmp(buff_ro,buff_rw)!=0))
+    {
+        __fail("get_option_string",option);
+    }
+
+    ret_ro=easy_uci_session_try_get_option_string(ro,PARSE_PACKAGE,section,option,buff_ro,sizeof(buff_ro));
+    ret_rw=easy_uci_session_try_get_option_string(rw,PARSE_PACKAGE,section,option,buff_rw,sizeof(buff_rw));
+    if(ret_ro!=ret_rw||(ret_ro==0&&strcmp(buff_ro,buff_rw)!=0))
+    {
+        __fail("try_get_option_string",option);
+    }
+
+    ret_ro=easy_uci_session_view_option_string(ro,PARSE_PACKAGE,section,option,&view_ro);
+    ret_rw=easy_uci_session_view_option_string(rw,PARSE_PACKAGE,section,option,&view_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&!__view_equal(&view_ro,&view_rw)))
+    {
+        __fail("view_option_string",option);
+    }
+
+    ret_ro=easy_uci_session_get_option_list(ro,PARSE_PACKAGE,section,option,&list_ro);
+    ret_rw=easy_uci_session_get_option_list(rw,PARSE_PACKAGE,section,option,&list_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&!__list_equal(&list_ro,&list_rw)))
+    {
+        __fail("get_option_list",option);
+    }
+    if(ret_ro==0)
+    {
+        easy_uci_free_list(&list_ro);
+    }
+    if(ret_rw==0)
+    {
+        easy_uci_free_list(&list_rw);
+    }
+
+    ret_ro=easy_uci_session_try_get_option_list(ro,PARSE_PACKAGE,section,option,&list_ro);
+    ret_rw=easy_uci_session_try_get_option_list(rw,PARSE_PACKAGE,section,option,&list_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&!__list_equal(&list_ro,&list_rw)))
+    {
+        __fail("try_get_option_list",option);
+    }
+    if(ret_ro==0)
+    {
+        easy_uci_free_list(&list_ro);
+    }
+    if(ret_rw==0)
+    {
+        easy_uci_free_list(&list_rw);
+    }
+
+    ret_ro=easy_uci_session_view_option_list(ro,PARSE_PACKAGE,section,option,views_ro,PARSE_MAX_VIEWS,&count_ro);
+    ret_rw=easy_uci_session_view_option_list(rw,PARSE_PACKAGE,section,option,views_rw,PARSE_MAX_VIEWS,&count_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&count_ro!=count_rw))
+    {
+        __fail("view_option_list",option);
+    }
+    for(i=0;ret_ro==0&&ret_rw==0&&i<count_ro&&i<count_rw&&i<PARSE_MAX_VIEWS;++i)
+    {
+        if(!__view_equal(&views_ro[i],&views_rw[i]))
+        {
+            __fail("view_option_list",option);
+        }
+    }
+
+    //Finding the sections with the same value of the option must give the same names
+    if(easy_uci_session_get_option_string(rw,PARSE_PACKAGE,section,option,buff_rw,sizeof(buff_rw))==0)
+    {
+        pred.option=option;
+        pred.match=EASY_UCI_MATCH_EQUAL;
+        pred.value=buff_rw;
+        ret_ro=easy_uci_session_find_sections(ro,PARSE_PACKAGE,NULL,&pred,1,&list_ro);
+        ret_rw=easy_uci_session_find_sections(rw,PARSE_PACKAGE,NULL,&pred,1,&list_rw);
+        if(ret_ro!=ret_rw||(ret_ro==0&&!__list_equal(&list_ro,&list_rw)))
+        {
+            __fail("find_sections",option);
+        }
+        if(ret_ro==0)
+        {
+            easy_uci_free_list(&list_ro);
+        }
+        if(ret_rw==0)
+        {
+            easy_uci_free_list(&list_rw);
+        }
+    }
+}
+
+static void __compare_section(easy_uci_session* ro,easy_uci_session* rw,const char* section)
+{
+    int ret_ro,ret_rw;
+    size_t i;
+    char buff_ro[PARSE_BUFF_SIZE],buff_rw[PARSE_BUFF_SIZE];
+    char path[PARSE_BUFF_SIZE];
+    const char* paths[1];
+    easy_uci_view view_ro,view_rw;
+    easy_uci_section* sec_ro=NULL;
+    easy_uci_section* sec_rw=NULL;
+    easy_uci_result* res_ro;
+    easy_uci_result* res_rw;
+
+    ret_ro=easy_uci_session_get_section_type(ro,PARSE_PACKAGE,section,buff_ro,sizeof(buff_ro));
+    ret_rw=easy_uci_session_get_section_type(rw,PARSE_PACKAGE,section,buff_rw,sizeof(buff_rw));
+    if(ret_ro!=ret_rw||(ret_ro==0&&strcmp(buff_ro,buff_rw)!=0))
+    {
+        __fail("get_section_type",section);
+    }
+
+    ret_ro=easy_uci_session_try_get_section_type(ro,PARSE_PACKAGE,section,buff_ro,sizeof(buff_ro));
+    ret_rw=easy_uci_session_try_get_section_type(rw,PARSE_PACKAGE,section,buff_rw,sizeof(buff_rw));
+    if(ret_ro!=ret_rw||(ret_ro==0&&strcmp(buff_ro,buff_rw)!=0))
+    {
+        __fail("try_get_section_type",section);
+    }
+
+    ret_ro=easy_uci_session_view_section_type(ro,PARSE_PACKAGE,section,&view_ro);
+    ret_rw=easy_uci_session_view_section_type(rw,PARSE_PACKAGE,section,&view_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&!__view_equal(&view_ro,&view_rw)))
+    {
+        __fail("view_section_type",section);
+    }
+
+    ret_ro=easy_uci_session_get_section(ro,PARSE_PACKAGE,section,&sec_ro);
+    ret_rw=easy_uci_session_get_section(rw,PARSE_PACKAGE,section,&sec_rw);
+    if(ret_ro!=ret_rw)
+    {
+        __fail("get_section",section);
+    }
+    else if(ret_ro==0)
+    {
+        if(!__str_equal(sec_ro->name,sec_rw->name)||!__str_equal(sec_ro->type,sec_rw->type)||sec_ro->len!=sec_rw->len)
+        {
+            __fail("get_section",section);
+        }
+        for(i=0;i<sec_ro->len&&i<sec_rw->len;++i)
+        {
+            if(!__option_equal(&sec_ro->options[i],&sec_rw->options[i]))
+            {
+                __fail("get_section",sec_rw->options[i].name);
+            }
+        }
+    }
+
+    //Each option of the section through every getter, and through a batch
+    for(i=0;sec_rw!=NULL&&i<sec_rw->len;++i)
+    {
+        __compare_option(ro,rw,section,sec_rw->options[i].name);
+
+        snprintf(path,sizeof(path),"%s.%s.%s",PARSE_PACKAGE,section,sec_rw->options[i].name);
+        paths[0]=path;
+        ret_ro=easy_uci_session_get_batch(ro,paths,1,&res_ro);
+        ret_rw=easy_uci_session_get_batch(rw,paths,1,&res_rw);
+        if(ret_ro!=ret_rw||(ret_ro==0&&(res_ro[0].status!=res_rw[0].status||!__option_equal(&res_ro[0].option,&res_rw[0].option))))
+        {
+            __fail("get_batch",path);
+        }
+        if(ret_ro==0)
+        {
+            easy_uci_free_results(res_ro);
+        }
+        if(ret_rw==0)
+        {
+            easy_uci_free_results(res_rw);
+        }
+    }
+    __compare_option(ro,rw,section,"missing");
+
+    easy_uci_free_section(sec_ro);
+    easy_uci_free_section(sec_rw);
+}
+
+static void __compare_type(easy_uci_session* ro,easy_uci_session* rw,const char* type)
+{
+    int ret_ro,ret_rw;
+    int n;
+    size_t i;
+    size_t count_ro=0,count_rw=0;
+    char* name_ro;
+    char* name_rw;
+    char name[PARSE_BUFF_SIZE];
+    easy_uci_list list_ro,list_rw;
+    easy_uci_view view_ro,view_rw;
+    easy_uci_view views_ro[PARSE_MAX_VIEWS],views_rw[PARSE_MAX_VIEWS];
+
+    ret_ro=easy_uci_session_get_section_count_of_type(ro,PARSE_PACKAGE,type,&count_ro);
+    ret_rw=easy_uci_session_get_section_count_of_type(rw,PARSE_PACKAGE,type,&count_rw);
+    if(ret_ro!=ret_rw||count_ro!=count_rw)
+    {
+        __fail("get_section_count_of_type",type);
+    }
+
+    ret_ro=easy_uci_session_get_all_section_of_type(ro,PARSE_PACKAGE,type,&list_ro);
+    ret_rw=easy_uci_session_get_all_section_of_type(rw,PARSE_PACKAGE,type,&list_rw);
+    if(ret_ro!=ret_rw||(ret_ro==0&&!__list_equal(&list_ro,&list_rw)))
+    {
+        __fail("get_all_section_of_type",type);
+    }
+    if(ret_ro==0)
+    {
+        easy_uci_free_list(&list_ro);
+    }
+    if(ret_rw!=0)
+    {
+        list_rw.list=NULL;
+        list_rw.len=0;
+    }
+
+    //The getters not taking a session read like a read-only session, their names must work in a normal one
+    if(ret_rw==0)
+    {
+        if(easy_uci_get_all_section_of_type(PARSE_PACKAGE,type,&list_ro)!=0||!__list_equal(&list_ro,&list_rw))
+        {
+            __fail("easy_uci_get_all_section_of_type",type);
+        }
+        else
+        {
+            easy_uci_free_list(&list_ro);
+        }
+    }
+
+    ret_ro=easy_uci_session_view_all_section_of_type(ro,PARSE_PACKAGE,type,views_ro,PARSE_MAX_VIEWS,&count_ro);
+    ret_rw=easy_uci_session_view_all_section_of_type(rw,PARSE_PACKAGE,type,views_rw,PARSE_MAX_VIEWS,&count_rw);
+    if(ret_ro!=ret_rw||count_ro!=count_rw)
+    {
+        __fail("view_all_section_of_type",type);
+    }
+    for(i=0;ret_ro==0&&ret_rw==0&&i<count_ro&&i<count_rw&&i<PARSE_MAX_VIEWS;++i)
+    {
+        if(!__view_equal(&views_ro[i],&views_rw[i]))
+        {
+            __fail("view_all_section_of_type",type);
+        }
+    }
+
+    //One past each end as well
+    for(n=-(int)count_rw-1;n<=(int)count_rw;++n)
+    {
+        name_ro=NULL;
+        name_rw=NULL;
+        ret_ro=easy_uci_session_get_nth_section_of_type(ro,PARSE_PACKAGE,type,n,&name_ro);
+        ret_rw=easy_uci_session_get_nth_section_of_type(rw,PARSE_PACKAGE,type,n,&name_rw);
+        if(ret_ro!=ret_rw||!__str_equal(name_ro,name_rw))
+        {
+            __fail("get_nth_section_of_type",type);
+        }
+        free(name_ro);
+        free(name_rw);
+
+        ret_ro=easy_uci_session_view_nth_section_of_type(ro,PARSE_PACKAGE,type,n,&view_ro);
+        ret_rw=easy_uci_session_view_nth_section_of_type(rw,PARSE_PACKAGE,type,n,&view_rw);
+        if(ret_ro!=ret_rw||(ret_ro==0&&!__view_equal(&view_ro,&view_rw)))
+        {
+            __fail("view_nth_section_of_type",type);
+        }
+
+        snprintf(name,sizeof(name),"@%s[%d]",type,n);
+        __compare_section(ro,rw,name);
+    }
+
+    for(i=0;i<list_rw.len;++i)
+    {
+        __compare_section(ro,rw,list_rw.list[i]);
+    }
+    easy_uci_free_list(&list_rw);
+}
+
+static int __run_case(const struct parse_case* c)
+{
+    size_t i;
+    FILE* fp;
+    char path[400];
+    char* json_ro;
+    char* json_rw;
+    easy_uci_session* ro;
+    easy_uci_session* rw;
+
+    cur_case=c;
+
+    snprintf(path,sizeof(path),"%s/%s",conf_dir,PARSE_PACKAGE);
+    fp=fopen(path,"w");
+    if(fp==NULL)
+    {
+        perror("fopen");
+        return -1;
+    }
+    fputs(c->text,fp);
+    fclose(fp);
+
+    ro=easy_uci_session_open_readonly();
+    rw=easy_uci_session_open();
+    if(ro==NULL||rw==NULL)
+    {
+        fprintf(stderr,"Failed to open sessions\n");
+        return -1;
+    }
+
+    //Loads the package into the read-only session
+    uci_loads=0;
+    json_ro=__export(ro);
+    if((uci_loads==0)!=c->fast)
+    {
+        __fail("parsed by",c->fast?"libuci instead of the fast parser":"the fast parser instead of libuci");
+    }
+
+    json_rw=__export(rw);
+    //A file libuci can't load must fail the same way in both
+    if((json_ro==NULL)!=(json_rw==NULL)||(json_ro!=NULL&&strcmp(json_ro,json_rw)!=0))
+    {
+        __fail("export_json","differs");
+    }
+    free(json_ro);
+    free(json_rw);
+
+    for(i=0;i<PARSE_MAX_TYPES&&c->types[i]!=NULL;++i)
+    {
+        __compare_type(ro,rw,c->types[i]);
+    }
+    __compare_section(ro,rw,"missing");
+
+    easy_uci_session_close(ro);
+    easy_uci_session_close(rw);
+
+    return 0;
+}
+
+static int __rm(const char* path,const struct stat* st,int flag,struct FTW* ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+int main(int argc,char** argv)
+{
+    size_t i;
+    const char* tmp=argc>1?argv[1]:"/tmp";
+
+    snprintf(base_dir,sizeof(base_dir),"%s/easy_uci_parse.XXXXXX",tmp);
+    if(mkdtemp(base_dir)==NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    snprintf(conf_dir,sizeof(conf_dir),"%s/config",base_dir);
+    snprintf(save_dir,sizeof(save_dir),"%s/save",base_dir);
+    if(mkdir(conf_dir,0700)!=0||mkdir(save_dir,0700)!=0)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    //Misses are probed on purpose
+    easy_uci_register_error_logger(__quiet_logger);
+
+    for(i=0;i<sizeof(cases)/sizeof(cases[0]);++i)
+    {
+        if(__run_case(&cases[i])!=0)
+        {
+            ++failures;
+        }
+    }
+
+    nftw(base_dir,__rm,16,FTW_DEPTH|FTW_PHYS);
+
+    if(failures>0)
+    {
+        fprintf(stderr,"%lu failures\n",failures);
+        return 1;
+    }
+    printf("parse: %zu files OK\n",sizeof(cases)/sizeof(cases[0]));
+
+    return 0;
+}
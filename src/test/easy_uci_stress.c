@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "easy_uci.h"
+
+/*
+ * Readers and writers hammer the same packages through the functions not taking a session
+ * Each write sets a list whose items all hold the same round number, a reader seeing mixed items saw a torn write
+ * They run once committing each write, then once with the background writer committing them
+ * Build with -fsanitize=thread to have the races found as well
+ */
+
+#define STRESS_PACKAGES 3
+#define STRESS_DEFAULT_READERS 8
+#define STRESS_DEFAULT_ROUNDS 200
+#define STRESS_LIST_LEN 8
+#define STRESS_BUFF_SIZE 64
+#define STRESS_WRITER_DEBOUNCE_MS 2
+
+static char base_dir[256];
+static char conf_dir[300];
+static char save_dir[300];
+
+static const char* packages[STRESS_PACKAGES]={"stress0","stress1","stress2"};
+static size_t rounds=STRESS_DEFAULT_ROUNDS;
+//Accessed atomically
+static bool stop=false;
+static unsigned long failures=0;
+
+static void __fail(const char* package,const char* what)
+{
+    fprintf(stderr,"%s: %s\n",package,what);
+    __atomic_add_fetch(&failures,1,__ATOMIC_RELAXED);
+}
+
+static void __quiet_logger(const char* msg)
+{
+    (void)msg;
+}
+
+static int __gen_package(const char* package)
+{
+    size_t i;
+    FILE* fp;
+    char path[400];
+
+    snprintf(path,sizeof(path),"%s/%s",conf_dir,package);
+    fp=fopen(path,"w");
+    if(fp==NULL)
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    fprintf(fp,"config stress 'main'\n\toption round '0'\n");
+    for(i=0;i<STRESS_LIST_LEN;++i)
+    {
+        fprintf(fp,"\tlist items '0'\n");
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+/*
+ * Reads seen by a reader of one package, which may never go back
+ */
+struct stress_seen
+{
+    long round;
+    size_t count;
+};
+
+static void __check(const char* package,struct stress_seen* seen)
+{
+    long round;
+    size_t i;
+    size_t count;
+    char buff[STRESS_BUFF_SIZE];
+    char* end;
+    easy_uci_list list;
+
+    //The round option is written after the list, so the list read next is at least as new
+    if(easy_uci_get_option_string(package,"main","round",buff,sizeof(buff))!=0)
+    {
+        __fail(package,"failed to get the round");
+        return;
+    }
+    round=strtol(buff,&end,10);
+    if(round<seen->round)
+    {
+        __fail(package,"round went back");
+    }
+    seen->round=round;
+
+    if(easy_uci_get_option_list(package,"main","items",&list)!=0)
+    {
+        __fail(package,"failed to get the list");
+        return;
+    }
+
+    if(list.len!=STRESS_LIST_LEN)
+    {
+        __fail(package,"list of the wrong length");
+    }
+    for(i=1;i<list.len;++i)
+    {
+        if(strcmp(list.list[i],list.list[0])!=0)
+        {
+            __fail(package,"torn list");
+            break;
+        }
+    }
+    if(list.len>0&&strtol(list.list[0],&end,10)<round)
+    {
+        __fail(package,"list behind the round option");
+    }
+    easy_uci_free_list(&list);
+
+    //Sections are only added, one per round
+    if(easy_uci_get_section_count_of_type(package,"extra",&count)!=0)
+    {
+        __fail(package,"failed to count sections");
+        return;
+    }
+    if(count<seen->count)
+    {
+        __fail(package,"section count went back");
+    }
+    seen->count=count;
+}
+
+static void* __reader(void* arg)
+{
+    size_t i;
+    size_t n=(size_t)arg;
+    struct stress_seen seen[STRESS_PACKAGES];
+
+    memset(seen,0,sizeof(seen));
+
+    for(i=n;!__atomic_load_n(&stop,__ATOMIC_ACQUIRE);++i)
+    {
+        __check(packages[i%STRESS_PACKAGES],&seen[i%STRESS_PACKAGES]);
+
+        //Readers flip the process-wide state the others depend on now and then
+        if(i%997==0)
+        {
+            easy_uci_cache_invalidate(NULL);
+        }
+        if(i%1511==0)
+        {
+            easy_uci_register_error_logger(n%2==0?__quiet_logger:NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static void* __writer(void* arg)
+{
+    size_t i;
+    size_t r;
+    const char* package=arg;
+    const char* items[STRESS_LIST_LEN];
+    char round[STRESS_BUFF_SIZE];
+    char name[STRESS_BUFF_SIZE];
+    easy_uci_list list;
+
+    for(r=1;r<=rounds;++r)
+    {
+        snprintf(round,sizeof(round),"%zu",r);
+        for(i=0;i<STRESS_LIST_LEN;++i)
+        {
+            items[i]=round;
+        }
+        list.list=items;
+        list.len=STRESS_LIST_LEN;
+
+        //The list goes first, readers check it's never behind the round option
+        if(easy_uci_set_option_list(package,"main","items",&list)!=0||easy_uci_set_option_string(package,"main","round",round)!=0)
+        {
+            __fail(package,"failed to write");
+        }
+
+        snprintf(name,sizeof(name),"extra%zu",r);
+        if(easy_uci_add_section(package,"extra",name)!=0)
+        {
+            __fail(package,"failed to add a section");
+        }
+
+        //Half of the rounds read the package cold
+        if(r%2==0)
+        {
+            easy_uci_cache_enable(r%4==0);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Start all packages over and run the readers and the writers until the writers are done
+ */
+static void __run(pthread_t* threads,size_t readers)
+{
+    size_t i;
+    size_t count;
+    char buff[STRESS_BUFF_SIZE];
+    char round[STRESS_BUFF_SIZE];
+
+    for(i=0;i<STRESS_PACKAGES;++i)
+    {
+        if(__gen_package(packages[i])!=0)
+        {
+            __fail(packages[i],"failed to generate");
+            return;
+        }
+    }
+    easy_uci_cache_invalidate(NULL);
+    __atomic_store_n(&stop,false,__ATOMIC_RELEASE);
+
+    for(i=0;i<readers;++i)
+    {
+        pthread_create(&threads[i],NULL,__reader,(void*)i);
+    }
+    for(i=0;i<STRESS_PACKAGES;++i)
+    {
+        pthread_create(&threads[readers+i],NULL,__writer,(void*)packages[i]);
+    }
+
+    for(i=0;i<STRESS_PACKAGES;++i)
+    {
+        pthread_join(threads[readers+i],NULL);
+    }
+    __atomic_store_n(&stop,true,__ATOMIC_RELEASE);
+    for(i=0;i<readers;++i)
+    {
+        pthread_join(threads[i],NULL);
+    }
+
+    //Every write made it
+    easy_uci_writer_sync();
+    snprintf(buff,sizeof(buff),"%zu",rounds);
+    for(i=0;i<STRESS_PACKAGES;++i)
+    {
+        if(easy_uci_get_option_string(packages[i],"main","round",round,sizeof(round))!=0||strcmp(round,buff)!=0)
+        {
+            __fail(packages[i],"last write lost");
+        }
+        if(easy_uci_get_section_count_of_type(packages[i],"extra",&count)!=0||count!=rounds)
+        {
+            __fail(packages[i],"added section lost");
+        }
+    }
+}
+
+static int __rm(const char* path,const struct stat* st,int flag,struct FTW* ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+static void __usage(const char* name)
+{
+    fprintf(stderr,"Usage: %s [-d tmpdir] [-r readers] [-n rounds]\n"
+        "  -d  where the temporary confdir is made, /tmp by default\n"
+        "  -r  the number of reader threads, %d by default\n"
+        "  -n  the writes made to each package, %d by default\n",
+        name,STRESS_DEFAULT_READERS,STRESS_DEFAULT_ROUNDS);
+}
+
+int main(int argc,char** argv)
+{
+    int opt;
+    size_t i;
+    size_t readers=STRESS_DEFAULT_READERS;
+    const char* tmp="/tmp";
+    pthread_t* threads;
+
+    while((opt=getopt(argc,argv,"d:r:n:h"))!=-1)
+    {
+        switch(opt)
+        {
+        case 'd':
+            tmp=optarg;
+            break;
+        case 'r':
+            readers=strtoul(optarg,NULL,10);
+            break;
+        case 'n':
+            rounds=strtoul(optarg,NULL,10);
+            break;
+        default:
+            __usage(argv[0]);
+            return 1;
+        }
+    }
+
+    threads=calloc(readers+STRESS_PACKAGES,sizeof(pthread_t));
+    if(threads==NULL)
+    {
+        perror("calloc");
+        return 1;
+    }
+
+    snprintf(base_dir,sizeof(base_dir),"%s/easy_uci_stress.XXXXXX",tmp);
+    if(mkdtemp(base_dir)==NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    snprintf(conf_dir,sizeof(conf_dir),"%s/config",base_dir);
+    snprintf(save_dir,sizeof(save_dir),"%s/save",base_dir);
+    if(mkdir(conf_dir,0700)!=0||mkdir(save_dir,0700)!=0)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    easy_uci_cache_enable(true);
+
+    //Once committing each write, then with the background writer committing them
+    for(i=0;i<2&&failures==0;++i)
+    {
+        if(i==1&&easy_uci_writer_start(STRESS_WRITER_DEBOUNCE_MS)!=0)
+        {
+            __fail("writer","failed to start");
+            break;
+        }
+        __run(threads,readers);
+        easy_uci_writer_stop();
+    }
+
+    easy_uci_cache_enable(false);
+    nftw(base_dir,__rm,16,FTW_DEPTH|FTW_PHYS);
+    free(threads);
+
+    if(failures>0)
+    {
+        fprintf(stderr,"%lu failures\n",failures);
+        return 1;
+    }
+    printf("stress: %zu readers, %zu rounds on %d packages, with and without the writer OK\n",readers,rounds,STRESS_PACKAGES);
+
+    return 0;
+}
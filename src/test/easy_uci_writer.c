@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "easy_uci.h"
+
+/*
+ * Changes queued for the background writer must survive the calls committing around it
+ * A conditional write conflicting on a package with queued changes mustn't drop them
+ */
+
+#define WRITER_BUFF_SIZE 64
+//Long enough that nothing is committed by the thread before the test syncs
+#define WRITER_DEBOUNCE_MS 60000
+
+static char base_dir[256];
+static char conf_dir[300];
+static char save_dir[300];
+
+static unsigned long failures=0;
+
+static void __fail(const char* what)
+{
+    fprintf(stderr,"%s\n",what);
+    ++failures;
+}
+
+static void __quiet_logger(const char* msg)
+{
+    (void)msg;
+}
+
+static int __rm(const char* path,const struct stat* st,int flag,struct FTW* ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+static void __expect_option(const char* option,const char* expected)
+{
+    char buff[WRITER_BUFF_SIZE];
+    char what[WRITER_BUFF_SIZE*2];
+
+    snprintf(what,sizeof(what),"option %s lost",option);
+    if(easy_uci_get_option_string("writer","main",option,buff,sizeof(buff))!=0||strcmp(buff,expected)!=0)
+    {
+        __fail(what);
+    }
+}
+
+/*
+ * A write queued before a conditional write on the same package
+ */
+static void __test_conflict(void)
+{
+    int ret;
+    easy_uci_version version;
+    easy_uci_writer_stats stats;
+    easy_uci_session* s;
+
+    if(easy_uci_get_version("writer",&version)!=0)
+    {
+        __fail("failed to get the version");
+        return;
+    }
+
+    if(easy_uci_writer_start(WRITER_DEBOUNCE_MS)!=0)
+    {
+        __fail("failed to start the writer");
+        return;
+    }
+
+    if(easy_uci_set_option_string("writer","main","queued","1")!=0)
+    {
+        __fail("failed to queue a write");
+    }
+
+    //The queued write changed the package since the version was read
+    ret=easy_uci_set_option_string_if_version("writer","main","conditional","1",&version);
+    if(ret!=EASY_UCI_CONFLICT)
+    {
+        __fail("conditional write over a queued write didn't conflict");
+    }
+    __expect_option("queued","1");
+
+    //Retried at the version returned, it goes through
+    ret=easy_uci_set_option_string_if_version("writer","main","conditional","2",&version);
+    if(ret!=0)
+    {
+        __fail("conditional write at the current version failed");
+    }
+
+    //Queued again, then the package changes outside the writer's session
+    if(easy_uci_set_option_string("writer","main","queued","2")!=0)
+    {
+        __fail("failed to queue a write");
+    }
+    s=easy_uci_session_open();
+    if(s==NULL||easy_uci_session_set_option_string(s,"writer","main","outside","1")!=0)
+    {
+        __fail("failed to write outside the writer");
+    }
+    easy_uci_session_close(s);
+
+    //The conflict mustn't take the queued write with it
+    ret=easy_uci_set_option_string_if_version("writer","main","conditional","3",&version);
+    if(ret!=EASY_UCI_CONFLICT)
+    {
+        __fail("conditional write over an outside write didn't conflict");
+    }
+
+    if(easy_uci_writer_sync()!=0)
+    {
+        __fail("failed to sync the writer");
+    }
+    easy_uci_writer_get_stats(&stats);
+    easy_uci_writer_stop();
+
+    //Read from the files now the writer is stopped
+    __expect_option("queued","2");
+    __expect_option("conditional","2");
+    __expect_option("outside","1");
+
+    if(stats.writes!=2||stats.commits!=2||stats.failures!=0)
+    {
+        fprintf(stderr,"writes %lu commits %lu failures %lu\n",stats.writes,stats.commits,stats.failures);
+        __fail("queued writes miscounted");
+    }
+}
+
+int main(int argc,char** argv)
+{
+    FILE* fp;
+    char path[400];
+    const char* tmp=argc>1?argv[1]:"/tmp";
+
+    snprintf(base_dir,sizeof(base_dir),"%s/easy_uci_writer.XXXXXX",tmp);
+    if(mkdtemp(base_dir)==NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    snprintf(conf_dir,sizeof(conf_dir),"%s/config",base_dir);
+    snprintf(save_dir,sizeof(save_dir),"%s/save",base_dir);
+    if(mkdir(conf_dir,0700)!=0||mkdir(save_dir,0700)!=0)
+    {
+        perror("mkdir");
+        return 1;
+    }
+
+    snprintf(path,sizeof(path),"%s/writer",conf_dir);
+    fp=fopen(path,"w");
+    if(fp==NULL)
+    {
+        perror("fopen");
+        return 1;
+    }
+    fprintf(fp,"config main 'main'\n\toption queued '0'\n");
+    fclose(fp);
+
+    easy_uci_set_config_dir(conf_dir,save_dir);
+    easy_uci_register_error_logger(__quiet_logger);
+
+    __test_conflict();
+
+    nftw(base_dir,__rm,16,FTW_DEPTH|FTW_PHYS);
+
+    if(failures>0)
+    {
+        fprintf(stderr,"%lu failures\n",failures);
+        return 1;
+    }
+    printf("writer: queued and conditional writes OK\n");
+
+    return 0;
+}